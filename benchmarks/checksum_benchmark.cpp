@@ -0,0 +1,134 @@
+// Checks every CRC and start marker search variant against the generated mavlink headers and times them.
+// Exits with an error if any variant disagrees with crc_accumulate().
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <mavlink.h>
+
+#include <Checksum.hpp>
+#include <helpers.hpp>
+
+using Crc16 = uint16_t(*)(const uint8_t*, size_t, uint16_t);
+using FindStartMarker = const uint8_t * (*)(const uint8_t*, size_t);
+
+static uint16_t reference_crc(const uint8_t* data, size_t length)
+{
+	uint16_t crc;
+	crc_init(&crc);
+
+	while (length--) {
+		crc_accumulate(*data++, &crc);
+	}
+
+	return crc;
+}
+
+static double time_ns_per_byte(const std::vector<uint8_t>& data, size_t block, Crc16 function)
+{
+	volatile uint16_t sink = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t offset = 0; offset + block <= data.size(); offset += block) {
+		sink = sink + function(&data[offset], block, 0xFFFF);
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return seconds * 1e9 / double(data.size() / block * block);
+}
+
+int main(int argc, const char** argv)
+{
+	std::mt19937 random(1);
+	std::vector<uint8_t> data(argc > 1 ? std::stoul(argv[1]) : 16 * 1024 * 1024);
+
+	for (auto& byte : data) {
+		byte = uint8_t(random());
+	}
+
+	struct {
+		const char* name;
+		Crc16 function;
+	} crcs[] = {
+		{ "bytewise", mavlink::crc16_bytewise },
+		{ "table", mavlink::crc16_table },
+		{ "slicing4", mavlink::crc16_slicing4 },
+		{ "slicing8", mavlink::crc16_slicing8 },
+	};
+
+	bool match = true;
+
+	// Every length up to a full frame, at every alignment
+	for (size_t length = 0; length <= MAVLINK_MAX_PACKET_LEN; length++) {
+		for (size_t offset = 0; offset < 8; offset++) {
+			uint16_t expected = reference_crc(&data[offset], length);
+
+			for (auto& crc : crcs) {
+				if (crc.function(&data[offset], length, 0xFFFF) != expected) {
+					LOG(RED_TEXT "crc16 %s mismatch at length %zu" NORMAL_TEXT, crc.name, length);
+					match = false;
+				}
+			}
+		}
+	}
+
+	std::vector<std::pair<const char*, FindStartMarker>> searches = { { "scalar", mavlink::find_start_marker_scalar } };
+#if defined(__x86_64__) || defined(__i386__)
+	searches.push_back({ "sse2", mavlink::find_start_marker_sse2 });
+
+	if (__builtin_cpu_supports("avx2")) {
+		searches.push_back({ "avx2", mavlink::find_start_marker_avx2 });
+	}
+
+#endif
+
+	// Marker free haystack with a single marker planted at every position
+	std::vector<uint8_t> haystack(4096);
+
+	for (auto& byte : haystack) {
+		byte = uint8_t(random() % 0xFD);
+	}
+
+	for (size_t position = 0; position <= 300; position++) {
+		std::vector<uint8_t> copy = haystack;
+
+		if (position < 300) {
+			copy[position] = position % 2 ? MAVLINK_STX : MAVLINK_STX_MAVLINK1;
+		}
+
+		for (auto& search : searches) {
+			if (search.second(copy.data(), 300) != copy.data() + position) {
+				LOG(RED_TEXT "find_start_marker %s mismatch at position %zu" NORMAL_TEXT, search.first, position);
+				match = false;
+			}
+		}
+	}
+
+	LOG("All variants %s the generated headers", match ? "match" : "DO NOT match");
+	LOG("Start marker search in use: %s", mavlink::start_marker_search_name());
+
+	LOG("%-10s %12s %12s", "crc16", "ns/byte @40", "ns/byte @280");
+
+	for (auto& crc : crcs) {
+		LOG("%-10s %12.3f %12.3f", crc.name, time_ns_per_byte(data, 40, crc.function), time_ns_per_byte(data, 280, crc.function));
+	}
+
+	LOG("%-10s %12s", "search", "GB/s");
+
+	for (auto& search : searches) {
+		volatile const uint8_t* sink = nullptr;
+		auto start = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < 4096; i++) {
+			sink = search.second(haystack.data(), haystack.size());
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		LOG("%-10s %12.2f", search.first, 4096.0 * haystack.size() / seconds / 1e9);
+		(void)sink;
+	}
+
+	return match ? 0 : 1;
+}
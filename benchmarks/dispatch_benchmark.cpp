@@ -0,0 +1,60 @@
+// Dispatches HIGHRES_IMU messages to several subscribers, once with raw subscribers that each decode the message
+// themselves and once with typed subscribers that share a single decode.
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include <mavlink.h>
+
+#include <MessageDispatcher.hpp>
+
+static double time_ns_per_message(mavlink::MessageDispatcher& dispatcher, const mavlink_message_t& message, size_t count)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < count; i++) {
+		dispatcher.dispatch(message);
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return seconds * 1e9 / double(count);
+}
+
+int main(int argc, const char** argv)
+{
+	const size_t count = argc > 1 ? std::stoul(argv[1]) : 2000000;
+
+	mavlink_highres_imu_t imu = {};
+	imu.time_usec = 1234;
+	imu.xacc = 9.81f;
+
+	mavlink_message_t message;
+	mavlink_msg_highres_imu_encode(1, 1, &message, &imu);
+
+	printf("%-12s %-8s %12s\n", "subscribers", "mode", "ns/message");
+
+	for (int subscribers : { 1, 4, 8 }) {
+		volatile float sink = 0;
+
+		mavlink::MessageDispatcher raw;
+		mavlink::MessageDispatcher typed;
+
+		for (int i = 0; i < subscribers; i++) {
+			raw.subscribe(MAVLINK_MSG_ID_HIGHRES_IMU, [&sink](const mavlink_message_t& msg) {
+				mavlink_highres_imu_t decoded;
+				mavlink_msg_highres_imu_decode(&msg, &decoded);
+				sink = sink + decoded.xacc;
+			});
+
+			auto callback = [&sink](const mavlink_highres_imu_t & decoded) { sink = sink + decoded.xacc; };
+			using Callback = decltype(callback);
+			typed.subscribe(mavlink::MessageTraits<mavlink_highres_imu_t>::id, &mavlink::decode_as<mavlink_highres_imu_t>,
+					&mavlink::invoke_as<mavlink_highres_imu_t, Callback>, std::make_shared<Callback>(callback));
+		}
+
+		printf("%-12d %-8s %12.1f\n", subscribers, "raw", time_ns_per_message(raw, message, count));
+		printf("%-12d %-8s %12.1f\n", subscribers, "typed", time_ns_per_message(typed, message, count));
+	}
+
+	return 0;
+}
@@ -0,0 +1,171 @@
+// Loopback benchmark comparing thread-per-connection with the epoll EventLoop.
+// Runs 1, 16 and 128 UDP links, sends HIGHRES_IMU datagrams to all of them round robin and reports throughput,
+// CPU time and context switches per message along with the number of threads of the process.
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <EventLoop.hpp>
+#include <Mavlink.hpp>
+
+static constexpr int RECEIVER_BASE_PORT = 14700;
+
+struct Result {
+	uint64_t received {};
+	double seconds {};
+	double cpu_seconds {};
+	uint64_t context_switches {};
+	int threads {};
+};
+
+static int thread_count()
+{
+	std::ifstream status("/proc/self/status");
+	std::string line;
+
+	while (std::getline(status, line)) {
+		if (line.rfind("Threads:", 0) == 0) {
+			return std::stoi(line.substr(8));
+		}
+	}
+
+	return 0;
+}
+
+static double cpu_seconds(const rusage& usage)
+{
+	return double(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + double(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static Result run(size_t links, bool event_loop, size_t message_count)
+{
+	std::shared_ptr<mavlink::EventLoop> loop;
+
+	if (event_loop) {
+		loop = std::make_shared<mavlink::EventLoop>(1);
+		loop->start();
+	}
+
+	std::atomic<uint64_t> received {};
+	std::vector<std::unique_ptr<mavlink::Mavlink>> instances;
+
+	for (size_t i = 0; i < links; i++) {
+		mavlink::ConfigurationSettings settings = {
+			.connection_url = "udp://127.0.0.1:" + std::to_string(RECEIVER_BASE_PORT + i),
+			.sysid = 255,
+			.compid = 1,
+			.udp_receive_batch_size = 32,
+			.event_loop = loop
+		};
+
+		auto mavlink = std::make_unique<mavlink::Mavlink>(settings);
+
+		mavlink->subscribe_to_message(MAVLINK_MSG_ID_HIGHRES_IMU, [&received](const mavlink_message_t&) {
+			received++;
+		});
+
+		if (mavlink->start() != mavlink::ConnectionResult::Success) {
+			LOG(RED_TEXT "Failed to start connection" NORMAL_TEXT);
+			return {};
+		}
+
+		instances.push_back(std::move(mavlink));
+	}
+
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	std::vector<sockaddr_in> addrs(links);
+
+	for (size_t i = 0; i < links; i++) {
+		addrs[i].sin_family = AF_INET;
+		addrs[i].sin_port = htons(RECEIVER_BASE_PORT + i);
+		inet_pton(AF_INET, "127.0.0.1", &addrs[i].sin_addr);
+	}
+
+	mavlink_highres_imu_t imu = {};
+	mavlink_message_t message;
+	uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+
+	rusage usage_start;
+	getrusage(RUSAGE_SELF, &usage_start);
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < message_count; i++) {
+		imu.time_usec = i;
+		mavlink_msg_highres_imu_encode(1, 1, &message, &imu);
+		uint16_t length = mavlink_msg_to_send_buffer(buffer, &message);
+		const sockaddr_in& addr = addrs[i % links];
+		sendto(fd, buffer, length, 0, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+
+		// Keep the socket buffers from overflowing
+		while (i + 1 - received > 256 * links) {
+			std::this_thread::yield();
+		}
+	}
+
+	// Wait until the receivers have drained the sockets
+	uint64_t last = 0;
+
+	do {
+		last = received;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	} while (received != last);
+
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	rusage usage_end;
+	getrusage(RUSAGE_SELF, &usage_end);
+
+	Result result = {
+		.received = received,
+		.seconds = std::chrono::duration<double>(elapsed).count() - 0.1,
+		.cpu_seconds = cpu_seconds(usage_end) - cpu_seconds(usage_start),
+		.context_switches = uint64_t(usage_end.ru_nvcsw + usage_end.ru_nivcsw - usage_start.ru_nvcsw - usage_start.ru_nivcsw),
+		.threads = thread_count()
+	};
+
+	close(fd);
+
+	for (auto& mavlink : instances) {
+		mavlink->stop();
+	}
+
+	return result;
+}
+
+int main(int argc, const char** argv)
+{
+	size_t message_count = argc > 1 ? std::stoul(argv[1]) : 200000;
+
+	std::vector<std::string> rows;
+
+	for (size_t links : {1, 16, 128}) {
+		for (bool event_loop : {false, true}) {
+			Result result = run(links, event_loop, message_count);
+			double messages = double(std::max<uint64_t>(result.received, 1));
+
+			char row[256];
+			snprintf(row, sizeof(row), "%6zu %-10s %8d %10lu %12.0f %12.2f %12.3f", links, event_loop ? "event_loop" : "threads",
+				 result.threads, result.received, double(result.received) / result.seconds, result.cpu_seconds * 1e6 / messages,
+				 double(result.context_switches) / messages);
+			rows.push_back(row);
+		}
+	}
+
+	// Printed at the end, the connections log while starting and stopping
+	LOG("\nSending %zu messages per run over loopback", message_count);
+	LOG("%6s %-10s %8s %10s %12s %12s %12s", "links", "mode", "threads", "received", "msgs/s", "cpu us/msg", "ctxsw/msg");
+
+	for (auto& row : rows) {
+		LOG("%s", row.c_str());
+	}
+
+	return 0;
+}
@@ -0,0 +1,184 @@
+// Loopback benchmark comparing the threaded UDP connection with the io_uring one.
+// Throughput: blasts HIGHRES_IMU datagrams at the connection and reports messages per second and CPU time per message.
+// Latency: the connection echoes every HIGHRES_IMU back through its outbox, one at a time, and the round trip is timed.
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Mavlink.hpp>
+
+static constexpr int RECEIVER_PORT = 14800;
+
+struct Result {
+	uint64_t received {};
+	double messages_per_second {};
+	double cpu_us_per_message {};
+	double latency_p50_us {};
+	double latency_p99_us {};
+	double latency_max_us {};
+};
+
+static double cpu_seconds()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return double(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + double(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static uint16_t encode_imu(uint8_t* buffer, uint64_t time_usec)
+{
+	mavlink_highres_imu_t imu = { .time_usec = time_usec };
+	mavlink_message_t message;
+	mavlink_msg_highres_imu_encode(1, 1, &message, &imu);
+	return mavlink_msg_to_send_buffer(buffer, &message);
+}
+
+static Result run(bool io_uring, size_t message_count, size_t round_trips)
+{
+	mavlink::ConfigurationSettings settings = {
+		.connection_url = "udp://127.0.0.1:" + std::to_string(RECEIVER_PORT),
+		.sysid = 255,
+		.compid = 1,
+		.io_uring = io_uring
+	};
+
+	mavlink::Mavlink mavlink(settings);
+	std::atomic<uint64_t> received {};
+	std::atomic<bool> echo {};
+
+	mavlink.subscribe_to_message(MAVLINK_MSG_ID_HIGHRES_IMU, [&](const mavlink_message_t& message) {
+		received++;
+
+		if (echo) {
+			mavlink.send_message(message);
+		}
+	});
+
+	if (mavlink.start() != mavlink::ConnectionResult::Success) {
+		LOG(RED_TEXT "Failed to start connection" NORMAL_TEXT);
+		return {};
+	}
+
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(RECEIVER_PORT);
+	inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+	uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+	uint16_t length = 0;
+
+	// The connection only sends while it gets heartbeats
+	std::atomic<bool> running {true};
+	std::thread heartbeats([&]() {
+		uint8_t heartbeat_buffer[MAVLINK_MAX_PACKET_LEN];
+		mavlink_message_t heartbeat_message;
+		mavlink_heartbeat_t heartbeat = { .type = MAV_TYPE_GCS, .mavlink_version = 3 };
+		mavlink_msg_heartbeat_encode(1, 1, &heartbeat_message, &heartbeat);
+		uint16_t heartbeat_length = mavlink_msg_to_send_buffer(heartbeat_buffer, &heartbeat_message);
+
+		while (running) {
+			sendto(fd, heartbeat_buffer, heartbeat_length, 0, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+			std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		}
+	});
+
+	while (!mavlink.connected()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	Result result;
+
+	// Throughput
+	const double cpu_start = cpu_seconds();
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < message_count; i++) {
+		length = encode_imu(buffer, i);
+		sendto(fd, buffer, length, 0, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+
+		// Keep the socket buffer from overflowing
+		while (i + 1 - received > 128) {
+			std::this_thread::yield();
+		}
+	}
+
+	while (received < message_count && std::chrono::steady_clock::now() - start < std::chrono::seconds(10)) {
+		std::this_thread::yield();
+	}
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.received = received;
+	result.messages_per_second = double(received) / seconds;
+	result.cpu_us_per_message = (cpu_seconds() - cpu_start) * 1e6 / double(std::max<uint64_t>(received, 1));
+
+	// Latency, one message in flight at a time
+	echo = true;
+	std::vector<double> latencies;
+
+	for (size_t i = 0; i < round_trips; i++) {
+		length = encode_imu(buffer, i);
+		auto sent = std::chrono::steady_clock::now();
+		sendto(fd, buffer, length, 0, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+
+		struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+
+		if (poll(&pfd, 1, 1000) <= 0) {
+			LOG(RED_TEXT "Echo timed out" NORMAL_TEXT);
+			break;
+		}
+
+		recv(fd, buffer, sizeof(buffer), 0);
+		latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sent).count());
+	}
+
+	if (!latencies.empty()) {
+		std::sort(latencies.begin(), latencies.end());
+		result.latency_p50_us = latencies[latencies.size() / 2];
+		result.latency_p99_us = latencies[latencies.size() * 99 / 100];
+		result.latency_max_us = latencies.back();
+	}
+
+	running = false;
+	heartbeats.join();
+	close(fd);
+	mavlink.stop();
+
+	return result;
+}
+
+int main(int argc, const char** argv)
+{
+	size_t message_count = argc > 1 ? std::stoul(argv[1]) : 500000;
+	size_t round_trips = argc > 2 ? std::stoul(argv[2]) : 10000;
+
+	std::vector<std::string> rows;
+
+	for (bool io_uring : {false, true}) {
+		Result result = run(io_uring, message_count, round_trips);
+
+		char row[256];
+		snprintf(row, sizeof(row), "%-10s %10lu %12.0f %12.2f %10.1f %10.1f %10.1f", io_uring ? "io_uring" : "threads", result.received,
+			 result.messages_per_second, result.cpu_us_per_message, result.latency_p50_us, result.latency_p99_us, result.latency_max_us);
+		rows.push_back(row);
+	}
+
+	// Printed at the end, the connections log while starting and stopping
+	LOG("\n%zu messages for throughput, %zu echoed round trips for latency", message_count, round_trips);
+	LOG("%-10s %10s %12s %12s %10s %10s %10s", "mode", "received", "msgs/s", "cpu us/msg", "rtt p50us", "rtt p99us", "rtt max us");
+
+	for (auto& row : rows) {
+		LOG("%s", row.c_str());
+	}
+
+	return 0;
+}
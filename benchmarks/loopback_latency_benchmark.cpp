@@ -0,0 +1,408 @@
+// Round trip benchmark between two Mavlink instances, over loopback UDP and over a pair of pseudo terminals.
+// The client stamps PING messages with the send time and the server echoes them back. One ping in flight measures the
+// idle round trip, fixed send rates measure it under load. The highest rate at which the pings keep coming back is
+// reported as the sustainable rate of the link. Both instances log their latency histograms when they stop.
+#include <poll.h>
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Mavlink.hpp>
+#include <helpers.hpp>
+
+static constexpr uint8_t SERVER_SYSID = 1;
+static constexpr uint8_t CLIENT_SYSID = 2;
+static constexpr size_t PING_PONG_COUNT = 2000;
+static constexpr uint64_t RATE_DURATION_US = 1000000;
+static constexpr size_t MAX_PINGS = 200000; // Per run, preallocated so the echo callback never sees the vector resize
+static constexpr uint64_t DRAIN_TIMEOUT_US = 500000; // Wait for late echoes after the last ping
+static constexpr double SUSTAINED_DELIVERY = 0.999;  // Share of pings that must come back at a sustainable rate
+static constexpr double SUSTAINED_SEND_RATE = 0.95;  // Share of the target rate the client must keep up with
+
+// Copies bytes between the master sides of two pseudo terminals, like a null modem cable between their slave devices
+class PtyBridge
+{
+public:
+	bool open()
+	{
+		for (int i = 0; i < 2; i++) {
+			int slave;
+			char name[64];
+
+			if (openpty(&_master[i], &slave, name, nullptr, nullptr) != 0) {
+				return false;
+			}
+
+			struct termios tc;
+			tcgetattr(_master[i], &tc);
+			cfmakeraw(&tc);
+			tcsetattr(_master[i], TCSANOW, &tc);
+
+			// Kept open so the master does not see a hangup before the connection opened the slave
+			_slave[i] = slave;
+			_name[i] = name;
+		}
+
+		_thread = std::thread(&PtyBridge::thread_main, this);
+		return true;
+	}
+
+	~PtyBridge()
+	{
+		_running = false;
+
+		if (_thread.joinable()) {
+			_thread.join();
+		}
+
+		for (int i = 0; i < 2; i++) {
+			close(_master[i]);
+			close(_slave[i]);
+		}
+	}
+
+	const std::string& name(int i) const { return _name[i]; };
+
+	// A serial connection only sends once it heard a heartbeat, this plays the other side's first one
+	void inject(int i, const mavlink_message_t& message)
+	{
+		uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+		const uint16_t length = mavlink_msg_to_send_buffer(buffer, &message);
+		[[maybe_unused]] ssize_t ret = write(_master[i], buffer, length);
+	}
+
+private:
+	void thread_main()
+	{
+		struct pollfd fds[2] = {
+			{ .fd = _master[0], .events = POLLIN, .revents = 0 },
+			{ .fd = _master[1], .events = POLLIN, .revents = 0 },
+		};
+
+		uint8_t buffer[4096];
+
+		while (_running) {
+			if (poll(fds, 2, 100) <= 0) {
+				continue;
+			}
+
+			for (int i = 0; i < 2; i++) {
+				if (fds[i].revents & POLLIN) {
+					const ssize_t length = read(_master[i], buffer, sizeof(buffer));
+
+					for (ssize_t written = 0; length > 0 && written < length;) {
+						const ssize_t ret = write(_master[1 - i], buffer + written, length - written);
+
+						if (ret <= 0) {
+							break;
+						}
+
+						written += ret;
+					}
+				}
+			}
+		}
+	}
+
+	int _master[2] {-1, -1};
+	int _slave[2] {-1, -1};
+	std::string _name[2] {};
+	std::atomic<bool> _running {true};
+	std::thread _thread {};
+};
+
+struct Transport {
+	const char* name;
+	std::string server_url;
+	std::string client_url;
+	bool io_uring;
+	bool serial;
+};
+
+struct Result {
+	double rate;            // Target pings per second, 0 for one ping in flight
+	size_t sent {};
+	size_t received {};
+	double send_rate {};    // Pings per second the client actually sent
+	std::vector<double> rtt_us {};
+};
+
+class Loopback
+{
+public:
+	Loopback(const Transport& transport)
+		: _server(settings(transport, transport.server_url, SERVER_SYSID, CLIENT_SYSID))
+		, _client(settings(transport, transport.client_url, CLIENT_SYSID, SERVER_SYSID))
+		, _rtt_us(MAX_PINGS, -1)
+	{
+		// The server echoes every ping back to the client
+		_server.subscribe_to_message(MAVLINK_MSG_ID_PING, [this](const mavlink_message_t& message) {
+			mavlink_ping_t ping;
+			mavlink_msg_ping_decode(&message, &ping);
+			ping.target_system = message.sysid;
+			ping.target_component = message.compid;
+
+			mavlink_message_t echo;
+			mavlink_msg_ping_encode(SERVER_SYSID, 1, &echo, &ping);
+			_server.send_message(echo);
+		});
+
+		_client.subscribe_to_message(MAVLINK_MSG_ID_PING, [this](const mavlink_message_t& message) {
+			mavlink_ping_t ping;
+			mavlink_msg_ping_decode(&message, &ping);
+
+			if (ping.seq < _count) {
+				_rtt_us[ping.seq] = double(micros() - ping.time_usec);
+			}
+
+			_received.fetch_add(1, std::memory_order_release);
+		});
+	}
+
+	bool start(PtyBridge* bridge)
+	{
+		if (_server.start() != mavlink::ConnectionResult::Success || _client.start() != mavlink::ConnectionResult::Success) {
+			return false;
+		}
+
+		// udpout:// announces the client with its heartbeat, the server answers with its own
+		const uint64_t deadline = micros() + 5000000;
+
+		for (int i = 0; !(_server.connected() && _client.connected()); i++) {
+			if (micros() > deadline) {
+				return false;
+			}
+
+			// Until the serial connections heard each other
+			if (bridge && i % 100 == 0) {
+				mavlink_message_t message;
+				mavlink_heartbeat_t heartbeat = { .type = MAV_TYPE_GCS, .mavlink_version = 3 };
+				mavlink_msg_heartbeat_encode(SERVER_SYSID, 1, &message, &heartbeat);
+				bridge->inject(1, message);
+				mavlink_msg_heartbeat_encode(CLIENT_SYSID, 1, &message, &heartbeat);
+				bridge->inject(0, message);
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		// The injected heartbeats are numbered apart from the server's own frames, counting starts after one echo
+		ping_pong(1);
+		_start_statistics = _client.statistics();
+		return true;
+	}
+
+	Result ping_pong(size_t count)
+	{
+		Result result { .rate = 0 };
+		reset(count);
+		const uint64_t start = micros();
+
+		for (size_t i = 0; i < count; i++) {
+			send_ping(i);
+			result.sent++;
+
+			const uint64_t timeout = micros() + DRAIN_TIMEOUT_US;
+
+			while (_received.load(std::memory_order_acquire) < result.sent && micros() < timeout) {
+				std::this_thread::yield();
+			}
+		}
+
+		result.send_rate = double(count) * 1e6 / double(micros() - start);
+		collect(&result);
+		return result;
+	}
+
+	Result at_rate(double rate)
+	{
+		Result result { .rate = rate };
+		const size_t count = size_t(rate * double(RATE_DURATION_US) / 1e6);
+		reset(count);
+		const uint64_t start = micros();
+
+		for (size_t i = 0; i < count; i++) {
+			// Sends right away when behind, so a slow link shows up as a lower send rate
+			const uint64_t due = start + uint64_t(double(i) * 1e6 / rate);
+			const uint64_t now = micros();
+
+			// No spinning, the echo threads may share the core
+			if (due > now) {
+				std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+			}
+
+			send_ping(i);
+			result.sent++;
+		}
+
+		const uint64_t end = micros();
+		result.send_rate = double(count) * 1e6 / double(std::max<uint64_t>(end - start, 1));
+
+		while (_received.load(std::memory_order_acquire) < count && micros() < end + DRAIN_TIMEOUT_US) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		collect(&result);
+		return result;
+	}
+
+	// Since the connection was up
+	mavlink::LinkStatistics client_statistics() const
+	{
+		mavlink::LinkStatistics statistics = _client.statistics();
+		statistics.frames_sent -= _start_statistics.frames_sent;
+		statistics.frames_received -= _start_statistics.frames_received;
+		statistics.lost -= _start_statistics.lost;
+		statistics.crc_errors -= _start_statistics.crc_errors;
+		return statistics;
+	};
+
+	void stop()
+	{
+		_client.stop();
+		_server.stop();
+	}
+
+private:
+	static mavlink::ConfigurationSettings settings(const Transport& transport, const std::string& url, uint8_t sysid,
+			uint8_t target_sysid)
+	{
+		return {
+			.connection_url = url,
+			.sysid = sysid,
+			.compid = 1,
+			.target_sysid = target_sysid,
+			.target_compid = 1,
+			.emit_heartbeat = true,
+			.udp_receive_batch_size = 64,
+			.udp_send_batch_size = 64,
+			.outbox_size_bytes = 1 << 20,
+			.io_uring = transport.io_uring,
+			.serial_low_latency = transport.serial,
+			.latency_histograms = true
+		};
+	}
+
+	void reset(size_t count)
+	{
+		// Echoes of an earlier run that arrive late are not counted
+		_count = 0;
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		std::fill(_rtt_us.begin(), _rtt_us.end(), -1);
+		_received = 0;
+		_count = count;
+	}
+
+	void send_ping(size_t seq)
+	{
+		mavlink_message_t message;
+		mavlink_ping_t ping = { .time_usec = micros(), .seq = uint32_t(seq), .target_system = SERVER_SYSID, .target_component = 1 };
+		mavlink_msg_ping_encode(CLIENT_SYSID, 1, &message, &ping);
+		_client.send_message(message);
+	}
+
+	void collect(Result* result)
+	{
+		for (size_t i = 0; i < _count; i++) {
+			if (_rtt_us[i] >= 0) {
+				result->rtt_us.push_back(_rtt_us[i]);
+			}
+		}
+
+		result->received = result->rtt_us.size();
+		std::sort(result->rtt_us.begin(), result->rtt_us.end());
+	}
+
+	mavlink::Mavlink _server;
+	mavlink::Mavlink _client;
+
+	mavlink::LinkStatistics _start_statistics {};
+	std::vector<double> _rtt_us;
+	std::atomic<size_t> _count {};
+	std::atomic<size_t> _received {};
+};
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+	return sorted.empty() ? 0.0 : sorted[std::min(sorted.size() - 1, size_t(p * double(sorted.size())))];
+}
+
+static void print(const Result& result)
+{
+	char rate[32];
+	snprintf(rate, sizeof(rate), result.rate > 0 ? "%.0f/s" : "1 in flight", result.rate);
+
+	LOG("%-14s %10zu %10zu %10.0f %10.1f %10.1f %10.1f %10.1f", rate, result.sent, result.received, result.send_rate,
+	    percentile(result.rtt_us, 0.5), percentile(result.rtt_us, 0.99), percentile(result.rtt_us, 0.999),
+	    result.rtt_us.empty() ? 0.0 : result.rtt_us.back());
+}
+
+int main()
+{
+	PtyBridge bridge;
+
+	if (!bridge.open()) {
+		LOG(RED_TEXT "openpty failed" NORMAL_TEXT);
+		return 1;
+	}
+
+	const Transport transports[] = {
+		{ "udp, threads", "udp://127.0.0.1:14850", "udpout://127.0.0.1:14850", false, false },
+		{ "udp, io_uring", "udp://127.0.0.1:14851", "udpout://127.0.0.1:14851", true, false },
+		{ "serial, pty", "serial:" + bridge.name(0) + ":921600", "serial:" + bridge.name(1) + ":921600", false, true },
+	};
+
+	const double rates[] = { 100, 1000, 10000, 20000, 50000, 100000, MAX_PINGS * 1e6 / RATE_DURATION_US };
+
+	bool success = true;
+
+	for (const Transport& transport : transports) {
+		Loopback loopback(transport);
+
+		if (!loopback.start(transport.serial ? &bridge : nullptr)) {
+			LOG(RED_TEXT "%s: failed to connect" NORMAL_TEXT, transport.name);
+			success = false;
+			continue;
+		}
+
+		LOG("\n%s", transport.name);
+		LOG("%-14s %10s %10s %10s %10s %10s %10s %10s", "rate", "sent", "received", "sent/s", "p50 us", "p99 us", "p99.9 us",
+		    "max us");
+
+		const Result idle = loopback.ping_pong(PING_PONG_COUNT);
+		print(idle);
+		success &= idle.received == idle.sent;
+
+		double sustainable = 0;
+
+		for (double rate : rates) {
+			const Result result = loopback.at_rate(rate);
+			print(result);
+
+			if (double(result.received) < SUSTAINED_DELIVERY * double(result.sent) ||
+			    result.send_rate < SUSTAINED_SEND_RATE * rate) {
+				break;
+			}
+
+			sustainable = rate;
+		}
+
+		LOG("sustainable: %.0f msgs/s", sustainable);
+
+		// Echoes lost on the way back show up as sequence gaps
+		const mavlink::LinkStatistics statistics = loopback.client_statistics();
+		LOG("client: %lu frames sent, %lu received, %lu lost, %lu CRC errors", statistics.frames_sent,
+		    statistics.frames_received, statistics.lost, statistics.crc_errors);
+		loopback.stop();
+	}
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+// Benchmark for the latest-value message cache.
+// One thread feeds ATTITUDE from four systems through Mavlink::handle_message() while reader threads poll the newest
+// ATTITUDE of each system. Compares the seqlock cache against what a consumer does without it: a callback copying the
+// message into a map under a mutex that the readers lock as well. Every message carries its index in all fields, a read
+// that mixes two updates is counted as torn. Times are CPU time of the thread, so that they hold with fewer cores than threads.
+#include <time.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <Mavlink.hpp>
+
+static constexpr size_t UPDATES = 2000000;
+static constexpr uint8_t SYSTEMS = 4;
+
+struct Result {
+	double update_ns {};
+	double read_ns {};
+	uint64_t reads {};
+	uint64_t torn {};
+};
+
+static uint64_t thread_cpu_ns()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return uint64_t(now.tv_sec) * 1000000000 + uint64_t(now.tv_nsec);
+}
+
+static mavlink_message_t make_attitude(size_t i)
+{
+	const float value = float(i);
+	mavlink_attitude_t attitude = { .time_boot_ms = uint32_t(i), .roll = value, .pitch = value, .yaw = value,
+					.rollspeed = value, .pitchspeed = value, .yawspeed = value };
+	mavlink_message_t message;
+	mavlink_msg_attitude_encode(uint8_t(1 + i % SYSTEMS), 1, &message, &attitude);
+	return message;
+}
+
+static bool consistent(const mavlink_attitude_t& attitude)
+{
+	const float value = float(attitude.time_boot_ms);
+	return attitude.roll == value && attitude.pitch == value && attitude.yaw == value && attitude.rollspeed == value &&
+	       attitude.pitchspeed == value && attitude.yawspeed == value;
+}
+
+// 'read' returns false if nothing arrived yet for the system
+template<typename Read>
+static Result run(mavlink::Mavlink& mavlink, size_t readers, Read&& read)
+{
+	std::vector<mavlink_message_t> messages(1024);
+
+	for (size_t i = 0; i < messages.size(); i++) {
+		messages[i] = make_attitude(i);
+	}
+
+	std::atomic<bool> done {};
+	std::atomic<uint64_t> reads {};
+	std::atomic<uint64_t> torn {};
+	std::atomic<uint64_t> read_time_ns {};
+	std::vector<std::thread> threads;
+
+	for (size_t r = 0; r < readers; r++) {
+		threads.emplace_back([&, r]() {
+			uint64_t count = 0;
+			uint64_t bad = 0;
+			const uint64_t start_ns = thread_cpu_ns();
+
+			for (size_t i = r; !done.load(std::memory_order_relaxed); i++) {
+				mavlink_attitude_t attitude;
+
+				if (read(uint8_t(1 + i % SYSTEMS), &attitude)) {
+					bad += !consistent(attitude);
+					count++;
+				}
+			}
+
+			read_time_ns += thread_cpu_ns() - start_ns;
+			reads += count;
+			torn += bad;
+		});
+	}
+
+	const uint64_t start_ns = thread_cpu_ns();
+
+	for (size_t i = 0; i < UPDATES; i++) {
+		mavlink.handle_message(messages[i % messages.size()]);
+	}
+
+	const double update_ns = double(thread_cpu_ns() - start_ns);
+	done = true;
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	return {
+		.update_ns = update_ns / double(UPDATES),
+		.read_ns = reads ? double(read_time_ns) / double(reads) : 0.0,
+		.reads = reads,
+		.torn = torn
+	};
+}
+
+static void report(const std::string& name, const Result& result)
+{
+	LOG("%-28s %12.1f %12.1f %12lu %8lu", name.c_str(), result.update_ns, result.read_ns, result.reads, result.torn);
+}
+
+int main()
+{
+	LOG("%zu ATTITUDE updates from %u systems", UPDATES, SYSTEMS);
+	LOG("%-28s %12s %12s %12s %8s", "case", "update ns", "read ns", "reads", "torn");
+
+	for (size_t readers : { 0, 1, 2, 4 }) {
+		const std::string count = std::to_string(readers) + " reader" + (readers == 1 ? "" : "s");
+
+		{
+			mavlink::ConfigurationSettings settings = {
+				.sysid = 255,
+				.compid = 190,
+				.cached_messages = { MAVLINK_MSG_ID_ATTITUDE, MAVLINK_MSG_ID_GLOBAL_POSITION_INT }
+			};
+
+			mavlink::Mavlink mavlink(settings);
+
+			report("seqlock cache, " + count, run(mavlink, readers, [&](uint8_t sysid, mavlink_attitude_t* attitude) {
+				return mavlink.latest(sysid, 1, attitude);
+			}));
+		}
+
+		{
+			mavlink::ConfigurationSettings settings = { .sysid = 255, .compid = 190 };
+			mavlink::Mavlink mavlink(settings);
+
+			std::mutex mutex;
+			std::unordered_map<uint8_t, mavlink_message_t> latest;
+
+			mavlink.subscribe_to_message(MAVLINK_MSG_ID_ATTITUDE, [&](const mavlink_message_t& message) {
+				std::scoped_lock<std::mutex> lock(mutex);
+				latest[message.sysid] = message;
+			});
+
+			report("mutex and map, " + count, run(mavlink, readers, [&](uint8_t sysid, mavlink_attitude_t* attitude) {
+				std::scoped_lock<std::mutex> lock(mutex);
+				auto it = latest.find(sysid);
+
+				if (it == latest.end()) {
+					return false;
+				}
+
+				mavlink_msg_attitude_decode(&it->second, attitude);
+				return true;
+			}));
+		}
+	}
+
+	return 0;
+}
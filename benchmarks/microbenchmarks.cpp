@@ -0,0 +1,505 @@
+// Microbenchmarks of the hot paths: MessageParser::parse, queue push/pop under contention, Mavlink::handle_message
+// dispatch, frame encoding, the link statistics and the latency histograms. Every case runs once to warm up and then REPETITIONS times on the same fixed input, the
+// median is reported as ns/op and ops/s together with the heap allocations per op.
+// Pass a group name (parse, encode, queue, dispatch, statistics, latency) to run only that group.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <FrameEncoder.hpp>
+#include <LatencyHistogram.hpp>
+#include <LinkCounters.hpp>
+#include <LockFreeQueue.hpp>
+#include <Mavlink.hpp>
+#include <MessageParser.hpp>
+#include <ThreadSafeQueue.hpp>
+
+static constexpr size_t REPETITIONS = 7;
+
+//-----------------------------------------------------------------------------
+// Allocation counting, every operator new of this program goes through here.
+// GCC cannot tell that the replaced operators pair malloc with free.
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+static std::atomic<uint64_t> allocations {};
+
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+
+	if (void* p = malloc(size ? size : 1)) {
+		return p;
+	}
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+//-----------------------------------------------------------------------------
+// Harness
+static volatile uint64_t sink;
+
+struct Measurement {
+	double ns_per_op {};
+	double allocations_per_op {};
+};
+
+// 'body' performs 'ops' operations per call
+template<class F>
+static Measurement measure(size_t ops, F&& body)
+{
+	body();
+
+	std::vector<double> ns(REPETITIONS);
+	const uint64_t allocations_start = allocations.load();
+
+	for (size_t i = 0; i < REPETITIONS; i++) {
+		auto start = std::chrono::steady_clock::now();
+		body();
+		ns[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::sort(ns.begin(), ns.end());
+
+	return {
+		.ns_per_op = ns[REPETITIONS / 2] / double(ops),
+		.allocations_per_op = double(allocations.load() - allocations_start) / double(REPETITIONS * ops)
+	};
+}
+
+static void report(const std::string& name, const Measurement& m)
+{
+	printf("%-44s %10.1f %14.0f %12.3f\n", name.c_str(), m.ns_per_op, 1e9 / m.ns_per_op, m.allocations_per_op);
+}
+
+//-----------------------------------------------------------------------------
+// Messages
+static mavlink_message_t make_message(size_t i)
+{
+	mavlink_message_t message;
+
+	switch (i % 4) {
+	case 0: {
+			mavlink_heartbeat_t hb = { .custom_mode = uint32_t(i), .type = MAV_TYPE_QUADROTOR, .mavlink_version = 3 };
+			mavlink_msg_heartbeat_encode(1, 1, &message, &hb);
+			break;
+		}
+
+	case 1: {
+			mavlink_attitude_t att = { .time_boot_ms = uint32_t(i), .roll = 0.1f, .pitch = 0.2f, .yaw = float(i) };
+			mavlink_msg_attitude_encode(1, 1, &message, &att);
+			break;
+		}
+
+	case 2: {
+			mavlink_highres_imu_t imu = { .time_usec = i, .xacc = 1.f, .yacc = 2.f, .zacc = -9.81f, .temperature = 40.f };
+			mavlink_msg_highres_imu_encode(1, 1, &message, &imu);
+			break;
+		}
+
+	default: {
+			mavlink_statustext_t text = { .severity = MAV_SEVERITY_INFO };
+			snprintf(text.text, sizeof(text.text), "status message number %zu", i);
+			mavlink_msg_statustext_encode(1, 1, &message, &text);
+			break;
+		}
+	}
+
+	return message;
+}
+
+//-----------------------------------------------------------------------------
+// Groups
+static void parse_group()
+{
+	constexpr size_t MESSAGES = 20000;
+	std::vector<char> stream;
+	uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+
+	for (size_t i = 0; i < MESSAGES; i++) {
+		const mavlink_message_t message = make_message(i);
+		const uint16_t length = mavlink_msg_to_send_buffer(buffer, &message);
+		stream.insert(stream.end(), buffer, buffer + length);
+	}
+
+	// Serial reads, UDP datagrams and a whole file
+	for (size_t chunk : { size_t(64), size_t(1472), stream.size() }) {
+		report("parse, " + std::to_string(chunk) + " byte chunks", measure(MESSAGES, [&]() {
+			MessageParser parser;
+			mavlink_message_t message;
+
+			for (size_t offset = 0; offset < stream.size(); offset += chunk) {
+				parser.set_input(&stream[offset], std::min(chunk, stream.size() - offset));
+
+				while (parser.parse(&message)) {
+					sink = sink + message.msgid;
+				}
+			}
+		}));
+	}
+}
+
+static void encode_group()
+{
+	constexpr size_t OPS = 200000;
+	uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+
+	mavlink_heartbeat_t hb = { .type = MAV_TYPE_QUADROTOR, .system_status = MAV_STATE_ACTIVE, .mavlink_version = 3 };
+	mavlink_attitude_t att = { .time_boot_ms = 1000, .roll = 0.1f, .pitch = 0.2f, .yaw = 1.5f, .rollspeed = 0.01f };
+	mavlink_highres_imu_t imu = { .time_usec = 1000000, .xacc = 1.f, .yacc = 2.f, .zacc = -9.81f, .temperature = 40.f };
+	mavlink_global_position_int_t pos = { .time_boot_ms = 1000, .lat = 473977420, .lon = 85455940, .alt = 488000 };
+
+	// The generated pack path and the one the built in senders use
+	report("encode heartbeat, to_send_buffer", measure(OPS, [&]() {
+		mavlink_message_t message;
+
+		for (size_t i = 0; i < OPS; i++) {
+			hb.custom_mode = uint32_t(i);
+			mavlink_msg_heartbeat_encode(1, 1, &message, &hb);
+			sink = sink + mavlink_msg_to_send_buffer(buffer, &message);
+		}
+	}));
+
+	report("encode heartbeat, encode_frame", measure(OPS, [&]() {
+		for (size_t i = 0; i < OPS; i++) {
+			hb.custom_mode = uint32_t(i);
+			sink = sink + mavlink::encode_frame(buffer, 1, 1, uint8_t(i), MAVLINK_MSG_ID_HEARTBEAT, &hb,
+							      MAVLINK_MSG_ID_HEARTBEAT_LEN, MAVLINK_MSG_ID_HEARTBEAT_CRC);
+		}
+	}));
+
+	report("encode attitude, to_send_buffer", measure(OPS, [&]() {
+		mavlink_message_t message;
+
+		for (size_t i = 0; i < OPS; i++) {
+			att.time_boot_ms = uint32_t(i);
+			mavlink_msg_attitude_encode(1, 1, &message, &att);
+			sink = sink + mavlink_msg_to_send_buffer(buffer, &message);
+		}
+	}));
+
+	report("encode attitude, encode_frame", measure(OPS, [&]() {
+		for (size_t i = 0; i < OPS; i++) {
+			att.time_boot_ms = uint32_t(i);
+			sink = sink + mavlink::encode_frame(buffer, 1, 1, uint8_t(i), MAVLINK_MSG_ID_ATTITUDE, &att,
+							      MAVLINK_MSG_ID_ATTITUDE_LEN, MAVLINK_MSG_ID_ATTITUDE_CRC);
+		}
+	}));
+
+	report("encode highres_imu, to_send_buffer", measure(OPS, [&]() {
+		mavlink_message_t message;
+
+		for (size_t i = 0; i < OPS; i++) {
+			imu.time_usec = i;
+			mavlink_msg_highres_imu_encode(1, 1, &message, &imu);
+			sink = sink + mavlink_msg_to_send_buffer(buffer, &message);
+		}
+	}));
+
+	report("encode highres_imu, encode_frame", measure(OPS, [&]() {
+		for (size_t i = 0; i < OPS; i++) {
+			imu.time_usec = i;
+			sink = sink + mavlink::encode_frame(buffer, 1, 1, uint8_t(i), MAVLINK_MSG_ID_HIGHRES_IMU, &imu,
+							      MAVLINK_MSG_ID_HIGHRES_IMU_LEN, MAVLINK_MSG_ID_HIGHRES_IMU_CRC);
+		}
+	}));
+
+	report("encode global_position_int, to_send_buffer", measure(OPS, [&]() {
+		mavlink_message_t message;
+
+		for (size_t i = 0; i < OPS; i++) {
+			pos.time_boot_ms = uint32_t(i);
+			mavlink_msg_global_position_int_encode(1, 1, &message, &pos);
+			sink = sink + mavlink_msg_to_send_buffer(buffer, &message);
+		}
+	}));
+
+	report("encode global_position_int, encode_frame", measure(OPS, [&]() {
+		for (size_t i = 0; i < OPS; i++) {
+			pos.time_boot_ms = uint32_t(i);
+			sink = sink + mavlink::encode_frame(buffer, 1, 1, uint8_t(i), MAVLINK_MSG_ID_GLOBAL_POSITION_INT, &pos,
+							      MAVLINK_MSG_ID_GLOBAL_POSITION_INT_LEN, MAVLINK_MSG_ID_GLOBAL_POSITION_INT_CRC);
+		}
+	}));
+}
+
+// 'producers' threads push OPS messages in total, the calling thread pops them. A blocking pop can wake up without a
+// message, spuriously or on a stale signal, so an empty result is retried.
+template<class Push, class Pop>
+static void run_queue(size_t producers, size_t ops, Push&& push, Pop&& pop)
+{
+	const mavlink_message_t message = make_message(2);
+	std::vector<std::thread> threads;
+
+	for (size_t p = 0; p < producers; p++) {
+		threads.emplace_back([&, p]() {
+			for (size_t i = p; i < ops; i += producers) {
+				while (!push(message)) {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	for (size_t received = 0; received < ops;) {
+		if (auto message = pop()) {
+			sink = sink + message->msgid;
+			received++;
+		}
+	}
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+static void queue_group()
+{
+	constexpr size_t OPS = 200000;
+	constexpr size_t CAPACITY = 1024;
+
+	for (size_t producers : { 1, 4 }) {
+		const std::string threads = std::to_string(producers) + " producer" + (producers > 1 ? "s" : "");
+
+		report("ThreadSafeQueue push/pop, " + threads, measure(OPS, [&]() {
+			ThreadSafeQueue<mavlink_message_t> queue(CAPACITY);
+			run_queue(producers, OPS, [&](const mavlink_message_t& m) { return queue.push_back(m); },
+			[&]() { return queue.pop_front(true); });
+		}));
+
+		report("LockFreeQueue push/pop, " + threads, measure(OPS, [&]() {
+			LockFreeQueue<mavlink_message_t> queue(CAPACITY);
+			run_queue(producers, OPS, [&](const mavlink_message_t& m) { return queue.push_back(m); },
+			[&]() { return queue.pop_front(true); });
+		}));
+	}
+}
+
+static void dispatch_group()
+{
+	constexpr size_t OPS = 100000;
+	const mavlink_message_t message = make_message(2);
+
+	for (size_t subscribers : { 1, 10, 100 }) {
+		mavlink::ConfigurationSettings settings = { .sysid = 255, .compid = 190 };
+
+		mavlink::Mavlink raw(settings);
+		mavlink::Mavlink typed(settings);
+
+		for (size_t i = 0; i < subscribers; i++) {
+			raw.subscribe_to_message(MAVLINK_MSG_ID_HIGHRES_IMU, [](const mavlink_message_t& msg) {
+				mavlink_highres_imu_t imu;
+				mavlink_msg_highres_imu_decode(&msg, &imu);
+				sink = sink + uint64_t(imu.time_usec);
+			});
+
+			typed.subscribe<mavlink_highres_imu_t>([](const mavlink_highres_imu_t& imu) { sink = sink + uint64_t(imu.time_usec); });
+		}
+
+		const std::string count = std::to_string(subscribers) + " subscriber" + (subscribers > 1 ? "s" : "");
+
+		report("handle_message raw, " + count, measure(OPS, [&]() {
+			for (size_t i = 0; i < OPS; i++) {
+				raw.handle_message(message);
+			}
+		}));
+
+		report("handle_message typed, " + count, measure(OPS, [&]() {
+			for (size_t i = 0; i < OPS; i++) {
+				typed.handle_message(message);
+			}
+		}));
+	}
+}
+
+static void statistics_group()
+{
+	constexpr size_t MESSAGES = 20000;
+	constexpr size_t CHUNK = 1472;
+	std::vector<char> stream;
+	uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+
+	uint8_t seq[4] {};
+
+	// Four message IDs from each of four sources, every hundredth frame lost
+	for (size_t i = 0; i < MESSAGES; i++) {
+		const mavlink_message_t message = make_message(i);
+		const mavlink_msg_entry_t* entry = mavlink_get_msg_entry(message.msgid);
+		const size_t source = (i / 4) % 4;
+		const uint16_t length = mavlink::encode_frame(buffer, uint8_t(1 + source), 1, seq[source]++, message.msgid,
+					_MAV_PAYLOAD(&message), entry->max_msg_len, entry->crc_extra);
+
+		if (i % 100 != 99) {
+			stream.insert(stream.end(), buffer, buffer + length);
+		}
+	}
+
+	auto parse_and_count = [&](mavlink::LinkCounters & counters) {
+		MessageParser parser;
+		mavlink_message_t message;
+		const uint64_t now_ms = millis();
+
+		for (size_t offset = 0; offset < stream.size(); offset += CHUNK) {
+			const size_t length = std::min(CHUNK, stream.size() - offset);
+			parser.set_input(&stream[offset], length);
+
+			while (parser.parse(&message)) {
+				counters.count(message, now_ms);
+				sink = sink + message.msgid;
+			}
+
+			counters.input(length, parser.counters());
+		}
+	};
+
+	// Every repetition starts the sequence numbers over, which counts as a gap
+	mavlink::LinkCounters repeated;
+
+	report("parse and count, " + std::to_string(CHUNK) + " byte chunks", measure(MESSAGES, [&]() {
+		parse_and_count(repeated);
+	}));
+
+	mavlink::LinkCounters counters;
+	parse_and_count(counters);
+
+	constexpr size_t SNAPSHOTS = 10000;
+	mavlink::LinkStatistics statistics;
+
+	report("statistics snapshot, 4 IDs, 4 sources", measure(SNAPSHOTS, [&]() {
+		for (size_t i = 0; i < SNAPSHOTS; i++) {
+			statistics = {};
+			counters.snapshot(&statistics, millis());
+			sink = sink + statistics.lost;
+		}
+	}));
+
+	printf("%zu frames sent, %lu received, %lu lost in %zu sources, %zu message IDs\n", MESSAGES, statistics.frames_received,
+	       statistics.lost, statistics.sources.size(), statistics.messages.size());
+
+	// An outage longer than the reorder window counts once, the frames after it are in order again
+	mavlink::LinkCounters outage;
+	mavlink_message_t message = make_message(1);
+
+	auto count_seq = [&](size_t seq) {
+		message.seq = uint8_t(seq);
+		outage.count(message, 0);
+		mavlink::LinkStatistics snapshot;
+		outage.snapshot(&snapshot, 0);
+		return snapshot.lost;
+	};
+
+	for (size_t seq = 0; seq < 10; seq++) {
+		count_seq(seq);
+	}
+
+	const uint64_t outage_lost = count_seq(210);
+	const uint64_t next_lost = count_seq(211) - outage_lost;
+	printf("200 frame outage, %lu lost, %lu more on the next frame%s\n", outage_lost, next_lost,
+	       outage_lost == 200 && next_lost == 0 ? "" : ", expected 200 and 0");
+}
+
+static void print_latency(const char* name, const mavlink::LatencySnapshot& snapshot)
+{
+	printf("  %-20s %8lu samples, p50 %8.1f us, p99 %8.1f us, max %8.1f us\n", name, snapshot.count,
+	       double(snapshot.p50_ns) / 1e3, double(snapshot.p99_ns) / 1e3, double(snapshot.max_ns) / 1e3);
+}
+
+static void latency_group()
+{
+	constexpr size_t OPS = 1000000;
+	mavlink::LatencyHistogram histogram;
+
+	report("LatencyHistogram record", measure(OPS, [&]() {
+		for (size_t i = 0; i < OPS; i++) {
+			histogram.record(i * 37);
+		}
+	}));
+
+	// The cost of the instrumentation on a dispatch
+	constexpr size_t DISPATCHES = 100000;
+	const mavlink_message_t message = make_message(2);
+
+	for (bool enabled : { false, true }) {
+		mavlink::ConfigurationSettings settings = { .sysid = 255, .compid = 190, .latency_histograms = enabled };
+		mavlink::Mavlink mavlink(settings);
+		mavlink.subscribe<mavlink_highres_imu_t>([](const mavlink_highres_imu_t& imu) { sink = sink + uint64_t(imu.time_usec); });
+
+		report(std::string("handle_message, histograms ") + (enabled ? "on" : "off"), measure(DISPATCHES, [&]() {
+			for (size_t i = 0; i < DISPATCHES; i++) {
+				mavlink.handle_message(message, enabled ? mavlink::latency_clock_ns() : 0);
+			}
+		}));
+	}
+
+	// A handler that blocks every hundredth call shows up in the tail of its own message ID only
+	mavlink::ConfigurationSettings settings = { .sysid = 255, .compid = 190, .latency_histograms = true };
+	mavlink::Mavlink mavlink(settings);
+	size_t calls = 0;
+
+	mavlink.subscribe<mavlink_highres_imu_t>([&](const mavlink_highres_imu_t& imu) {
+		if (++calls % 100 == 0) {
+			std::this_thread::sleep_for(std::chrono::microseconds(500));
+		}
+
+		sink = sink + uint64_t(imu.time_usec);
+	});
+
+	mavlink.subscribe<mavlink_attitude_t>([](const mavlink_attitude_t& attitude) { sink = sink + uint64_t(attitude.time_boot_ms); });
+
+	for (size_t i = 0; i < 10000; i++) {
+		mavlink.handle_message(make_message(i), mavlink::latency_clock_ns());
+	}
+
+	const mavlink::LatencyHistograms histograms = mavlink.latency_histograms();
+	printf("slow HIGHRES_IMU handler, every 100th call blocks 500 us:\n");
+	print_latency("receive to dispatch", histograms.receive);
+
+	for (const mavlink::CallbackLatency& callbacks : histograms.callbacks) {
+		const std::string name = "callbacks " + std::to_string(callbacks.message_id);
+		print_latency(name.c_str(), callbacks.duration);
+	}
+}
+
+int main(int argc, const char** argv)
+{
+	const std::string filter = argc > 1 ? argv[1] : "";
+
+	struct Group {
+		const char* name;
+		void (*run)();
+	};
+
+	const Group groups[] = {
+		{ "parse", parse_group },
+		{ "encode", encode_group },
+		{ "queue", queue_group },
+		{ "dispatch", dispatch_group },
+		{ "statistics", statistics_group },
+		{ "latency", latency_group },
+	};
+
+	printf("%-44s %10s %14s %12s\n", "case", "ns/op", "ops/s", "allocs/op");
+
+	for (const Group& group : groups) {
+		if (filter.empty() || filter == group.name) {
+			group.run();
+		}
+	}
+
+	return 0;
+}
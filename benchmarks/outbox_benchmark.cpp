@@ -0,0 +1,117 @@
+// Overloads a simulated 10k messages per second link with 50k telemetry messages per second, while a COMMAND_ACK is
+// queued every millisecond. Reports per telemetry policy what each class queued and dropped, and how long acks waited.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <FrameEncoder.hpp>
+#include <Outbox.hpp>
+#include <helpers.hpp>
+
+static constexpr size_t LINK_FRAMES_PER_MS = 10;
+static constexpr size_t TELEMETRY_PER_MS = 50;
+static constexpr int DURATION_MS = 1000;
+
+template<typename T>
+static void queue(mavlink::Outbox& outbox, uint32_t msgid, const T& payload, uint8_t crc_extra)
+{
+	outbox.push(mavlink::outbox_class(msgid), msgid, mavlink::frame_length(&payload, sizeof(T)), [&](uint8_t* buffer) {
+		mavlink::encode_frame(buffer, 1, 1, 0, msgid, &payload, sizeof(T), crc_extra);
+	});
+}
+
+int main()
+{
+	const char* policy_names[] = { "drop newest", "drop oldest", "latest value" };
+	const char* class_names[] = { "control", "heartbeat", "telemetry", "bulk" };
+
+	for (mavlink::OutboxPolicy policy : { mavlink::OutboxPolicy::DropNewest, mavlink::OutboxPolicy::DropOldest,
+					      mavlink::OutboxPolicy::LatestValue }) {
+		mavlink::ConfigurationSettings settings = {};
+		settings.outbox_classes[size_t(mavlink::OutboxClass::Telemetry)].policy = policy;
+
+		mavlink::Outbox outbox(settings, 16384);
+		std::atomic<bool> running {true};
+		std::vector<double> ack_waits;
+		size_t telemetry_sent = 0;
+
+		// The link, only takes so many frames per millisecond
+		std::thread link([&]() {
+			mavlink::Outbox::Frame frames[LINK_FRAMES_PER_MS];
+
+			while (running) {
+				const size_t count = outbox.peek(frames, LINK_FRAMES_PER_MS);
+				const uint32_t now = uint32_t(micros());
+
+				for (size_t i = 0; i < count; i++) {
+					const uint8_t* frame = frames[i].data;
+					const uint32_t msgid = frame[7] | (frame[8] << 8) | (uint32_t(frame[9]) << 16);
+
+					if (msgid == MAVLINK_MSG_ID_COMMAND_ACK) {
+						mavlink_command_ack_t ack = {};
+						memcpy(&ack, &frame[MAVLINK_NUM_HEADER_BYTES], frame[1]);
+						ack_waits.push_back(double(now - uint32_t(ack.result_param2)));
+
+					} else {
+						telemetry_sent++;
+					}
+				}
+
+				outbox.release();
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+
+		for (int ms = 0; ms < DURATION_MS; ms++) {
+			for (size_t i = 0; i < TELEMETRY_PER_MS; i++) {
+				switch (i % 3) {
+				case 0: {
+						mavlink_highres_imu_t imu = { .time_usec = uint32_t(micros()) };
+						queue(outbox, MAVLINK_MSG_ID_HIGHRES_IMU, imu, MAVLINK_MSG_ID_HIGHRES_IMU_CRC);
+						break;
+					}
+
+				case 1: {
+						mavlink_attitude_t attitude = { .time_boot_ms = uint32_t(ms), .roll = 0.1f };
+						queue(outbox, MAVLINK_MSG_ID_ATTITUDE, attitude, MAVLINK_MSG_ID_ATTITUDE_CRC);
+						break;
+					}
+
+				default: {
+						mavlink_global_position_int_t position = { .time_boot_ms = uint32_t(ms), .lat = 473977418 };
+						queue(outbox, MAVLINK_MSG_ID_GLOBAL_POSITION_INT, position, MAVLINK_MSG_ID_GLOBAL_POSITION_INT_CRC);
+						break;
+					}
+				}
+			}
+
+			mavlink_command_ack_t ack = { .command = 400, .result = 0, .result_param2 = int32_t(uint32_t(micros())) };
+			queue(outbox, MAVLINK_MSG_ID_COMMAND_ACK, ack, MAVLINK_MSG_ID_COMMAND_ACK_CRC);
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		running = false;
+		link.join();
+
+		std::sort(ack_waits.begin(), ack_waits.end());
+		const std::vector<mavlink::OutboxCounters> counters = outbox.counters();
+
+		printf("\ntelemetry policy: %s, %zu telemetry frames on the link\n", policy_names[size_t(policy)], telemetry_sent);
+		printf("%-10s %10s %10s %10s\n", "class", "queued", "dropped", "replaced");
+
+		for (size_t i = 0; i < counters.size(); i++) {
+			printf("%-10s %10lu %10lu %10lu\n", class_names[i], counters[i].queued, counters[i].dropped, counters[i].replaced);
+		}
+
+		if (!ack_waits.empty()) {
+			printf("%zu acks on the link, wait p50 %.0f us, max %.0f us\n", ack_waits.size(), ack_waits[ack_waits.size() / 2],
+			       ack_waits.back());
+		}
+	}
+
+	return 0;
+}
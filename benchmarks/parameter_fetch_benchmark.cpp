@@ -0,0 +1,169 @@
+// Fetches 1500 parameters from a simulated autopilot over UDP loopback. The autopilot answers PARAM_REQUEST_LIST with
+// every value back to back and drops a share of them, which the client then requests again with PARAM_REQUEST_READ.
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <Mavlink.hpp>
+#include <MessageParser.hpp>
+
+static constexpr int RECEIVER_PORT = 14830;
+static constexpr uint16_t PARAMETER_COUNT = 1500;
+static constexpr uint8_t AUTOPILOT_SYSID = 1;
+static constexpr uint8_t AUTOPILOT_COMPID = 1;
+
+// Answers parameter requests from a bare socket
+struct Autopilot {
+	int fd {-1};
+	struct sockaddr_in addr {};
+	uint32_t loss_percent {};
+	std::atomic<bool> running {true};
+	size_t list_values {};
+	size_t read_values {};
+
+	void send(const mavlink_message_t& message)
+	{
+		uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+		const uint16_t length = mavlink_msg_to_send_buffer(buffer, &message);
+		sendto(fd, buffer, length, 0, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+	}
+
+	void send_value(uint16_t index)
+	{
+		mavlink_param_value_t value = {
+			.param_value = float(index),
+			.param_count = PARAMETER_COUNT,
+			.param_index = index,
+			.param_type = MAV_PARAM_TYPE_REAL32
+		};
+
+		snprintf(value.param_id, sizeof(value.param_id), "PARAM_%u", index);
+
+		mavlink_message_t message;
+		mavlink_msg_param_value_encode(AUTOPILOT_SYSID, AUTOPILOT_COMPID, &message, &value);
+		send(message);
+	}
+
+	void run()
+	{
+		MessageParser parser;
+		mavlink_message_t message;
+		char buffer[2048];
+		uint64_t next_heartbeat_ms = 0;
+
+		while (running) {
+			if (millis() >= next_heartbeat_ms) {
+				mavlink_heartbeat_t heartbeat = { .type = MAV_TYPE_QUADROTOR, .mavlink_version = 3 };
+				mavlink_msg_heartbeat_encode(AUTOPILOT_SYSID, AUTOPILOT_COMPID, &message, &heartbeat);
+				send(message);
+				next_heartbeat_ms = millis() + 500;
+			}
+
+			struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+
+			if (poll(&pfd, 1, 100) <= 0) {
+				continue;
+			}
+
+			const ssize_t length = recv(fd, buffer, sizeof(buffer), 0);
+
+			if (length <= 0) {
+				continue;
+			}
+
+			parser.set_input(buffer, length);
+
+			while (parser.parse(&message)) {
+				if (message.msgid == MAVLINK_MSG_ID_PARAM_REQUEST_LIST) {
+					for (uint16_t i = 0; i < PARAMETER_COUNT; i++) {
+						// Spread the losses evenly
+						if (uint32_t(i * 37 + 11) % 100 >= loss_percent) {
+							send_value(i);
+							list_values++;
+						}
+					}
+
+				} else if (message.msgid == MAVLINK_MSG_ID_PARAM_REQUEST_READ) {
+					mavlink_param_request_read_t request;
+					mavlink_msg_param_request_read_decode(&message, &request);
+
+					if (request.param_index >= 0 && request.param_index < PARAMETER_COUNT) {
+						send_value(uint16_t(request.param_index));
+						read_values++;
+					}
+				}
+			}
+		}
+	}
+};
+
+static bool run(uint32_t loss_percent)
+{
+	mavlink::ConfigurationSettings settings = {
+		.connection_url = "udp://127.0.0.1:" + std::to_string(RECEIVER_PORT),
+		.sysid = 255,
+		.compid = 190
+	};
+
+	mavlink::Mavlink mavlink(settings);
+
+	if (mavlink.start() != mavlink::ConnectionResult::Success) {
+		LOG(RED_TEXT "Failed to start connection" NORMAL_TEXT);
+		return false;
+	}
+
+	Autopilot autopilot;
+	autopilot.loss_percent = loss_percent;
+	autopilot.fd = socket(AF_INET, SOCK_DGRAM, 0);
+	autopilot.addr.sin_family = AF_INET;
+	autopilot.addr.sin_port = htons(RECEIVER_PORT);
+	inet_pton(AF_INET, "127.0.0.1", &autopilot.addr.sin_addr);
+
+	std::thread autopilot_thread([&autopilot]() { autopilot.run(); });
+
+	while (!mavlink.connected()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	// The UDP send thread polls for the connection once a second, let it see the link before timing
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+	mavlink::ParameterFetchResult result = mavlink.fetch_parameters(AUTOPILOT_SYSID, AUTOPILOT_COMPID);
+
+	autopilot.running = false;
+	autopilot_thread.join();
+	mavlink.stop();
+	close(autopilot.fd);
+
+	bool values_match = result.complete;
+
+	for (size_t i = 0; values_match && i < result.parameters.size(); i++) {
+		const std::string name = "PARAM_" + std::to_string(i);
+		values_match = result.parameters[i].float_value == float(i)
+			       && strncmp(result.parameters[i].name, name.c_str(), sizeof(result.parameters[i].name)) == 0;
+	}
+
+	LOG("\n%u%% of the list lost: %u of %u parameters in %.1f ms, %zu listed, %u requested, %zu answered, values %s",
+	    loss_percent, result.received, PARAMETER_COUNT, double(result.elapsed_us) / 1000, autopilot.list_values,
+	    result.requested, autopilot.read_values, values_match ? "match" : "MISMATCH");
+
+	return values_match;
+}
+
+int main()
+{
+	bool success = true;
+
+	for (uint32_t loss_percent : {0, 5, 30}) {
+		success &= run(loss_percent);
+	}
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+// Serves 1000 parameters over UDP loopback to a bare socket acting as ground station. Times PARAM_REQUEST_LIST until all
+// values arrived, then reads parameters back one at a time by index and by name.
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Mavlink.hpp>
+#include <MessageParser.hpp>
+
+static constexpr int RECEIVER_PORT = 14820;
+static constexpr size_t PARAMETER_COUNT = 1000;
+static constexpr size_t READ_COUNT = 200;
+
+struct GroundStation {
+	int fd {-1};
+	struct sockaddr_in addr {};
+	MessageParser parser {};
+
+	void send(const mavlink_message_t& message)
+	{
+		uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+		const uint16_t length = mavlink_msg_to_send_buffer(buffer, &message);
+		sendto(fd, buffer, length, 0, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+	}
+
+	// Returns false on timeout
+	bool receive_param_value(mavlink_param_value_t* value, int timeout_ms)
+	{
+		mavlink_message_t message;
+		char buffer[2048];
+
+		for (;;) {
+			while (parser.parse(&message)) {
+				if (message.msgid == MAVLINK_MSG_ID_PARAM_VALUE) {
+					mavlink_msg_param_value_decode(&message, value);
+					return true;
+				}
+			}
+
+			struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+
+			if (poll(&pfd, 1, timeout_ms) <= 0) {
+				return false;
+			}
+
+			const ssize_t length = recv(fd, buffer, sizeof(buffer), 0);
+
+			if (length > 0) {
+				parser.set_input(buffer, length);
+			}
+		}
+	}
+};
+
+static std::string parameter_name(size_t i)
+{
+	return "PARAM_" + std::to_string(i);
+}
+
+int main()
+{
+	mavlink::ConfigurationSettings settings = {
+		.connection_url = "udp://127.0.0.1:" + std::to_string(RECEIVER_PORT),
+		.sysid = 1,
+		.compid = 1
+	};
+
+	mavlink::Mavlink mavlink(settings);
+
+	mavlink.enable_parameters([]() {
+		std::vector<mavlink::Parameter> parameters(PARAMETER_COUNT);
+
+		for (size_t i = 0; i < PARAMETER_COUNT; i++) {
+			parameters[i].name = parameter_name(i);
+			parameters[i].float_value = float(i);
+			parameters[i].type = MAV_PARAM_TYPE_REAL32;
+		}
+
+		return parameters;
+	}, [](mavlink::Parameter*) { return false; });
+
+	if (mavlink.start() != mavlink::ConnectionResult::Success) {
+		LOG(RED_TEXT "Failed to start connection" NORMAL_TEXT);
+		return 1;
+	}
+
+	GroundStation gcs;
+	gcs.fd = socket(AF_INET, SOCK_DGRAM, 0);
+	gcs.addr.sin_family = AF_INET;
+	gcs.addr.sin_port = htons(RECEIVER_PORT);
+	inet_pton(AF_INET, "127.0.0.1", &gcs.addr.sin_addr);
+
+	mavlink_message_t message;
+	mavlink_heartbeat_t heartbeat = { .type = MAV_TYPE_GCS, .mavlink_version = 3 };
+	mavlink_msg_heartbeat_encode(255, 190, &message, &heartbeat);
+	gcs.send(message);
+
+	while (!mavlink.connected()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	// The first value through the link only shows that it is up
+	mavlink_param_value_t value;
+	mavlink_param_request_read_t request_first = { .param_index = 0, .target_system = 1, .target_component = 1 };
+	mavlink_msg_param_request_read_encode(255, 190, &message, &request_first);
+	gcs.send(message);
+
+	if (!gcs.receive_param_value(&value, 3000)) {
+		LOG(RED_TEXT "No answer to PARAM_REQUEST_READ" NORMAL_TEXT);
+		return 1;
+	}
+
+	// Full list
+	std::vector<bool> received(PARAMETER_COUNT);
+	size_t received_count = 0;
+
+	mavlink_param_request_list_t request_list = { .target_system = 1, .target_component = 1 };
+	mavlink_msg_param_request_list_encode(255, 190, &message, &request_list);
+	auto start = std::chrono::steady_clock::now();
+	gcs.send(message);
+
+	while (received_count < PARAMETER_COUNT && gcs.receive_param_value(&value, 1000)) {
+		if (value.param_index < PARAMETER_COUNT && !received[value.param_index]) {
+			received[value.param_index] = true;
+			received_count++;
+		}
+	}
+
+	const double list_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	// Single reads, alternating between index and name
+	std::vector<double> read_us;
+	size_t read_failures = 0;
+
+	for (size_t i = 0; i < READ_COUNT; i++) {
+		const size_t index = (i * 7919) % PARAMETER_COUNT;
+		mavlink_param_request_read_t request_read = { .param_index = -1, .target_system = 1, .target_component = 1 };
+
+		if (i % 2) {
+			const std::string name = parameter_name(index);
+			memcpy(request_read.param_id, name.data(), std::min(name.size(), sizeof(request_read.param_id)));
+
+		} else {
+			request_read.param_index = int16_t(index);
+		}
+
+		mavlink_msg_param_request_read_encode(255, 190, &message, &request_read);
+		auto sent = std::chrono::steady_clock::now();
+		gcs.send(message);
+
+		if (!gcs.receive_param_value(&value, 1000) || value.param_index != index) {
+			read_failures++;
+			continue;
+		}
+
+		read_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sent).count());
+	}
+
+	mavlink.stop();
+	close(gcs.fd);
+
+	std::sort(read_us.begin(), read_us.end());
+
+	LOG("\nlist: %zu of %zu parameters in %.1f ms", received_count, PARAMETER_COUNT, list_ms);
+
+	if (!read_us.empty()) {
+		LOG("read: %zu of %zu answered, p50 %.1f us, max %.1f us", read_us.size(), READ_COUNT, read_us[read_us.size() / 2],
+		    read_us.back());
+	}
+
+	return read_failures || received_count < PARAMETER_COUNT;
+}
@@ -0,0 +1,155 @@
+// Microbenchmark of MessageParser against the byte-at-a-time mavlink_parse_char() loop it replaced.
+// Both parsers see the same stream cut into chunks of a fixed size and must produce the same messages.
+// A second stream sprinkled with garbage bytes shows how many messages each parser recovers.
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <MessageParser.hpp>
+#include <helpers.hpp>
+
+struct Result {
+	uint64_t messages {};
+	uint64_t digest {};
+	double seconds {};
+};
+
+static std::vector<char> make_stream(size_t message_count, unsigned garbage_every)
+{
+	std::vector<char> stream;
+	std::mt19937 random(42);
+	mavlink_message_t message;
+	uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+
+	for (size_t i = 0; i < message_count; i++) {
+		switch (i % 4) {
+		case 0: {
+				mavlink_heartbeat_t hb = { .custom_mode = uint32_t(i), .type = 2, .mavlink_version = 3 };
+				mavlink_msg_heartbeat_encode(1, 1, &message, &hb);
+				break;
+			}
+
+		case 1: {
+				mavlink_attitude_t att = { .time_boot_ms = uint32_t(i), .roll = 0.1f, .pitch = 0.2f, .yaw = float(i) };
+				mavlink_msg_attitude_encode(1, 1, &message, &att);
+				break;
+			}
+
+		case 2: {
+				mavlink_highres_imu_t imu = { .time_usec = i, .xacc = 1.f, .yacc = 2.f, .zacc = -9.81f, .temperature = 40.f };
+				mavlink_msg_highres_imu_encode(1, 1, &message, &imu);
+				break;
+			}
+
+		default: {
+				mavlink_statustext_t text = { .severity = MAV_SEVERITY_INFO };
+				snprintf(text.text, sizeof(text.text), "status message number %zu", i);
+				mavlink_msg_statustext_encode(1, 1, &message, &text);
+				break;
+			}
+		}
+
+		uint16_t length = mavlink_msg_to_send_buffer(buffer, &message);
+		stream.insert(stream.end(), buffer, buffer + length);
+
+		if (garbage_every && i % garbage_every == 0) {
+			for (int j = 0; j < 7; j++) {
+				stream.push_back(char(random()));
+			}
+		}
+	}
+
+	return stream;
+}
+
+static void digest(uint64_t& digest, const mavlink_message_t& message)
+{
+	digest = digest * 31 + message.msgid;
+	digest = digest * 31 + message.seq;
+	digest = digest * 31 + message.checksum;
+}
+
+template<class ParseChunk>
+static Result run(const std::vector<char>& stream, size_t chunk_size, ParseChunk&& parse_chunk)
+{
+	Result result;
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t offset = 0; offset < stream.size(); offset += chunk_size) {
+		size_t length = std::min(chunk_size, stream.size() - offset);
+		parse_chunk(&stream[offset], length, result);
+	}
+
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+static void report(const char* name, size_t chunk_size, const Result& result, size_t bytes)
+{
+	LOG("%-18s %6zu %10lu %10.1f %10.1f", name, chunk_size, result.messages,
+	    result.seconds * 1e9 / double(result.messages), double(bytes) / result.seconds / 1e6);
+}
+
+static Result parse_reference(const std::vector<char>& stream, size_t chunk_size)
+{
+	return run(stream, chunk_size, [](const char* data, size_t length, Result & result) {
+		mavlink_message_t message;
+		mavlink_status_t status;
+
+		for (size_t i = 0; i < length; i++) {
+			if (mavlink_parse_char(MAVLINK_COMM_0, data[i], &message, &status)) {
+				result.messages++;
+				digest(result.digest, message);
+			}
+		}
+	});
+}
+
+static Result parse_bulk(const std::vector<char>& stream, size_t chunk_size)
+{
+	MessageParser parser;
+
+	return run(stream, chunk_size, [&parser](const char* data, size_t length, Result & result) {
+		mavlink_message_t message;
+		parser.set_input(data, length);
+
+		while (parser.parse(&message)) {
+			result.messages++;
+			digest(result.digest, message);
+		}
+	});
+}
+
+int main(int argc, const char** argv)
+{
+	size_t message_count = argc > 1 ? std::stoul(argv[1]) : 1000000;
+	std::vector<char> stream = make_stream(message_count, 0);
+
+	LOG("%zu messages, %zu bytes", message_count, stream.size());
+	LOG("%-18s %6s %10s %10s %10s", "parser", "chunk", "messages", "ns/msg", "MB/s");
+
+	bool match = true;
+
+	for (size_t chunk_size : {64, 1472, 65536}) {
+		Result reference = parse_reference(stream, chunk_size);
+		Result bulk = parse_bulk(stream, chunk_size);
+
+		report("mavlink_parse_char", chunk_size, reference, stream.size());
+		report("MessageParser", chunk_size, bulk, stream.size());
+
+		if (reference.messages != bulk.messages || reference.digest != bulk.digest) {
+			LOG(RED_TEXT "Parsers disagree: %lu vs %lu messages" NORMAL_TEXT, reference.messages, bulk.messages);
+			match = false;
+		}
+	}
+
+	std::vector<char> noisy = make_stream(message_count, 97);
+
+	LOG("Garbage inserted after every 97th message:");
+	LOG("  mavlink_parse_char recovered %lu of %zu messages", parse_reference(noisy, 1472).messages, message_count);
+	LOG("  MessageParser recovered %lu of %zu messages", parse_bulk(noisy, 1472).messages, message_count);
+
+	return match ? 0 : 1;
+}
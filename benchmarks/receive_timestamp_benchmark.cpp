@@ -0,0 +1,205 @@
+// Loopback benchmark for the receive timestamps of UdpConnection.
+// Compares the receive rate with receive_timestamps off and on for recvfrom(), recvmmsg() and io_uring. Then sends
+// bursts of HIGHRES_IMU stamped with their send time to a handler that is slower than the burst, and reports how
+// far behind the send the kernel receive time and the callback start are.
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <LatencyHistogram.hpp>
+#include <Mavlink.hpp>
+
+static constexpr int RECEIVER_PORT = 14610; // Each run binds the next port, an io_uring ring lets go of its socket with a delay
+static constexpr size_t BURST_SIZE = 32;
+static constexpr size_t BURSTS = 100;
+static constexpr uint64_t HANDLER_NS = 20000; // Busy time of the slow handler, a burst takes 640 us to handle
+
+struct Transport {
+	const char* name;
+	uint16_t batch_size;
+	bool io_uring;
+};
+
+static int port = RECEIVER_PORT;
+
+class Sender
+{
+public:
+	Sender()
+	{
+		_fd = socket(AF_INET, SOCK_DGRAM, 0);
+		_addr.sin_family = AF_INET;
+		_addr.sin_port = htons(port);
+		inet_pton(AF_INET, "127.0.0.1", &_addr.sin_addr);
+	};
+
+	~Sender() { close(_fd); };
+
+	// The send time goes into time_usec, in steady clock nanoseconds
+	void send(uint64_t index)
+	{
+		mavlink_highres_imu_t imu = { .time_usec = mavlink::latency_clock_ns(), .fields_updated = uint16_t(index) };
+		mavlink_message_t message;
+		uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+
+		mavlink_msg_highres_imu_encode(1, 1, &message, &imu);
+		const uint16_t length = mavlink_msg_to_send_buffer(buffer, &message);
+		sendto(_fd, buffer, length, 0, reinterpret_cast<const sockaddr*>(&_addr), sizeof(_addr));
+	};
+
+private:
+	int _fd {-1};
+	struct sockaddr_in _addr {};
+};
+
+static mavlink::ConfigurationSettings settings(const Transport& transport, bool timestamps)
+{
+	port++;
+
+	return {
+		.connection_url = "udp://127.0.0.1:" + std::to_string(port),
+		.sysid = 255,
+		.compid = 1,
+		.udp_receive_batch_size = transport.batch_size,
+		.io_uring = transport.io_uring,
+		.receive_timestamps = timestamps
+	};
+}
+
+static void wait_until_drained(const std::atomic<uint64_t>& received)
+{
+	uint64_t last = 0;
+
+	do {
+		last = received;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	} while (received != last);
+}
+
+static double receive_rate(const Transport& transport, bool timestamps, size_t message_count)
+{
+	mavlink::Mavlink mavlink(settings(transport, timestamps));
+	std::atomic<uint64_t> received {};
+	std::atomic<uint64_t> stamped {};
+
+	mavlink.subscribe_to_message(MAVLINK_MSG_ID_HIGHRES_IMU, [&](const mavlink_message_t&, uint64_t received_ns) {
+		stamped += received_ns != 0;
+		received++;
+	});
+
+	if (mavlink.start() != mavlink::ConnectionResult::Success) {
+		LOG(RED_TEXT "Failed to start connection" NORMAL_TEXT);
+		return 0;
+	}
+
+	Sender sender;
+	const auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < message_count; i++) {
+		sender.send(i);
+
+		// Let the receiver catch up now and then so that the socket buffer does not overflow
+		if (i % 64 == 63) {
+			std::this_thread::yield();
+		}
+	}
+
+	wait_until_drained(received);
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() - 0.1;
+	mavlink.stop();
+
+	if (stamped != (timestamps ? received.load() : 0)) {
+		LOG(RED_TEXT "%lu of %lu messages had a receive time" NORMAL_TEXT, stamped.load(), received.load());
+	}
+
+	return double(received) / seconds;
+}
+
+static double percentile(std::vector<uint64_t>& values, double fraction)
+{
+	if (values.empty()) {
+		return 0;
+	}
+
+	std::sort(values.begin(), values.end());
+	return double(values[std::min(values.size() - 1, size_t(fraction * double(values.size())))]) / 1e3;
+}
+
+static void slow_handler(const Transport& transport)
+{
+	mavlink::Mavlink mavlink(settings(transport, true));
+	std::vector<uint64_t> kernel_delay;
+	std::vector<uint64_t> callback_delay;
+	std::atomic<uint64_t> received {};
+
+	kernel_delay.reserve(BURST_SIZE * BURSTS);
+	callback_delay.reserve(BURST_SIZE * BURSTS);
+
+	mavlink.subscribe<mavlink_highres_imu_t>([&](const mavlink_highres_imu_t& imu, uint64_t received_ns) {
+		const uint64_t start_ns = mavlink::latency_clock_ns();
+		kernel_delay.push_back(received_ns - imu.time_usec);
+		callback_delay.push_back(start_ns - imu.time_usec);
+
+		while (mavlink::latency_clock_ns() - start_ns < HANDLER_NS) {}
+
+		received++;
+	});
+
+	if (mavlink.start() != mavlink::ConnectionResult::Success) {
+		LOG(RED_TEXT "Failed to start connection" NORMAL_TEXT);
+		return;
+	}
+
+	Sender sender;
+
+	for (size_t burst = 0; burst < BURSTS; burst++) {
+		for (size_t i = 0; i < BURST_SIZE; i++) {
+			sender.send(burst * BURST_SIZE + i);
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+
+	wait_until_drained(received);
+	mavlink.stop();
+
+	LOG("%-22s %10lu %12.1f %12.1f %12.1f %12.1f", transport.name, received.load(), percentile(kernel_delay, 0.5),
+	    percentile(kernel_delay, 0.99), percentile(callback_delay, 0.5), percentile(callback_delay, 0.99));
+}
+
+int main(int argc, const char** argv)
+{
+	const size_t message_count = argc > 1 ? std::stoul(argv[1]) : 200000;
+
+	const Transport transports[] = {
+		{ "udp, recvfrom", 1, false },
+		{ "udp, recvmmsg 64", 64, false },
+		{ "udp, io_uring", 64, true },
+	};
+
+	LOG("Sending %zu messages per run over loopback", message_count);
+	LOG("%-22s %16s %16s", "transport", "off msgs/s", "on msgs/s");
+
+	for (const Transport& transport : transports) {
+		const double off = receive_rate(transport, false, message_count);
+		const double on = receive_rate(transport, true, message_count);
+		LOG("%-22s %16.0f %16.0f", transport.name, off, on);
+	}
+
+	LOG("\nBursts of %zu to a handler that takes %lu us, delay after the send", BURST_SIZE, HANDLER_NS / 1000);
+	LOG("%-22s %10s %12s %12s %12s %12s", "transport", "received", "kernel p50", "kernel p99", "callback p50",
+	    "callback p99");
+
+	for (const Transport& transport : transports) {
+		slow_handler(transport);
+	}
+
+	return 0;
+}
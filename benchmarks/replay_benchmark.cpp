@@ -0,0 +1,195 @@
+// Writes a synthetic ten minute flight to a tlog and replays it through the replay connection. Full speed replays report
+// the messages per second of the receive pipeline, with callbacks in the replay thread and on dispatch threads. A timed
+// replay reports how far behind the recorded timing the messages arrive.
+#include <endian.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Mavlink.hpp>
+#include <helpers.hpp>
+
+static constexpr uint64_t FLIGHT_SECONDS = 600;
+static constexpr uint64_t IMU_HZ = 1000;
+static constexpr uint64_t ATTITUDE_HZ = 250;
+static constexpr uint64_t POSITION_HZ = 50;
+static constexpr double TIMED_SPEED = 200;
+
+static void write_record(FILE* file, uint64_t timestamp_us, const mavlink_message_t& message)
+{
+	uint8_t buffer[sizeof(uint64_t) + MAVLINK_MAX_PACKET_LEN];
+	const uint64_t timestamp_be = htobe64(timestamp_us);
+	memcpy(buffer, &timestamp_be, sizeof(timestamp_be));
+	const uint16_t length = mavlink_msg_to_send_buffer(buffer + sizeof(timestamp_be), &message);
+	fwrite(buffer, 1, sizeof(timestamp_be) + length, file);
+}
+
+// Returns the number of frames written
+static size_t write_flight(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+
+	if (!file) {
+		return 0;
+	}
+
+	const uint64_t start_us = 1700000000000000;
+	size_t frames = 0;
+	mavlink_message_t message;
+
+	// One tick per IMU sample, the slower messages on every n-th tick
+	for (uint64_t tick = 0; tick < FLIGHT_SECONDS * IMU_HZ; tick++) {
+		const uint64_t time_us = tick * 1000000 / IMU_HZ;
+		const uint64_t timestamp_us = start_us + time_us;
+
+		if (tick % IMU_HZ == 0) {
+			mavlink_heartbeat_t heartbeat = { .type = MAV_TYPE_QUADROTOR, .mavlink_version = 3 };
+			mavlink_msg_heartbeat_encode(1, 1, &message, &heartbeat);
+			write_record(file, timestamp_us, message);
+			frames++;
+		}
+
+		mavlink_highres_imu_t imu = { .time_usec = time_us, .xacc = 0.1f, .zacc = -9.81f };
+		mavlink_msg_highres_imu_encode(1, 1, &message, &imu);
+		write_record(file, timestamp_us, message);
+		frames++;
+
+		if (tick % (IMU_HZ / ATTITUDE_HZ) == 0) {
+			mavlink_attitude_t attitude = { .time_boot_ms = uint32_t(time_us / 1000), .roll = 0.1f, .pitch = -0.05f };
+			mavlink_msg_attitude_encode(1, 1, &message, &attitude);
+			write_record(file, timestamp_us, message);
+			frames++;
+		}
+
+		if (tick % (IMU_HZ / POSITION_HZ) == 0) {
+			mavlink_global_position_int_t position = { .time_boot_ms = uint32_t(time_us / 1000), .lat = 473977420, .lon = 85455940 };
+			mavlink_msg_global_position_int_encode(1, 1, &message, &position);
+			write_record(file, timestamp_us, message);
+			frames++;
+		}
+	}
+
+	fclose(file);
+	return frames;
+}
+
+struct Result {
+	size_t received {};
+	mavlink::ReplayCounters counters {};
+	std::vector<double> lag_us {};
+};
+
+static Result replay(const std::string& path, double speed, uint16_t dispatch_threads)
+{
+	mavlink::ConfigurationSettings settings = {
+		.connection_url = "replay://" + path + "?speed=" + std::to_string(speed),
+		.sysid = 255,
+		.compid = 190,
+		.dispatch_threads = dispatch_threads,
+		.dispatch_queue_size = 65536,
+		.dispatch_overflow_policy = mavlink::DispatchOverflowPolicy::Block
+	};
+
+	Result result;
+	std::atomic<size_t> received {};
+	std::atomic<float> checksum {};
+	uint64_t first_arrival_us = 0;
+	uint32_t first_time_ms = 0;
+
+	mavlink::Mavlink mavlink(settings);
+
+	mavlink.subscribe<mavlink_highres_imu_t>([&](const mavlink_highres_imu_t& imu) {
+		received.fetch_add(1, std::memory_order_relaxed);
+		checksum.store(imu.zacc, std::memory_order_relaxed);
+	});
+
+	mavlink.subscribe<mavlink_global_position_int_t>([&](const mavlink_global_position_int_t&) {
+		received.fetch_add(1, std::memory_order_relaxed);
+	});
+
+	mavlink.subscribe<mavlink_attitude_t>([&](const mavlink_attitude_t& attitude) {
+		received.fetch_add(1, std::memory_order_relaxed);
+
+		// Lag behind the recorded timing, relative to the first attitude
+		if (speed > 0) {
+			const uint64_t now = micros();
+
+			if (!first_arrival_us) {
+				first_arrival_us = now;
+				first_time_ms = attitude.time_boot_ms;
+			}
+
+			const double expected_us = double(attitude.time_boot_ms - first_time_ms) * 1000 / speed;
+			result.lag_us.push_back(double(now - first_arrival_us) - expected_us);
+		}
+	});
+
+	mavlink.subscribe_to_message(MAVLINK_MSG_ID_HEARTBEAT, [&](const mavlink_message_t&) {
+		received.fetch_add(1, std::memory_order_relaxed);
+	});
+
+	if (mavlink.start() != mavlink::ConnectionResult::Success) {
+		LOG(RED_TEXT "Failed to start replay" NORMAL_TEXT);
+		return result;
+	}
+
+	while (!mavlink.replay_counters().finished) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	// Lets the dispatch threads catch up
+	mavlink.stop();
+
+	result.received = received;
+	result.counters = mavlink.replay_counters();
+	return result;
+}
+
+int main()
+{
+	const std::string path = "/tmp/replay_benchmark.tlog";
+	const size_t frames = write_flight(path);
+
+	if (!frames) {
+		return 1;
+	}
+
+	LOG("\n%zu frames, %lu s of flight", frames, FLIGHT_SECONDS);
+	LOG("%-28s %10s %10s %12s %12s %12s", "mode", "played", "received", "msgs/s", "lag p50 us", "lag max us");
+
+	bool success = true;
+
+	struct Run {
+		const char* name;
+		double speed;
+		uint16_t dispatch_threads;
+	};
+
+	const Run runs[] = {
+		{ "full speed", 0, 0 },
+		{ "full speed, 2 dispatch", 0, 2 },
+		{ "200x", TIMED_SPEED, 0 },
+	};
+
+	for (const Run& run : runs) {
+		Result result = replay(path, run.speed, run.dispatch_threads);
+		std::sort(result.lag_us.begin(), result.lag_us.end());
+		const size_t lags = result.lag_us.size();
+
+		LOG("%-28s %10lu %10zu %12.0f %12.0f %12.0f", run.name, result.counters.frames, result.received,
+		    double(result.counters.frames) * 1e6 / double(std::max<uint64_t>(result.counters.elapsed_us, 1)),
+		    lags ? result.lag_us[lags / 2] : 0.0, lags ? result.lag_us.back() : 0.0);
+
+		success &= result.counters.frames == frames && result.received == frames && !result.counters.bad_records;
+	}
+
+	unlink(path.c_str());
+
+	return success ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+// Pseudo terminal benchmark for the SerialConnection transmit path.
+// Queues HIGHRES_IMU messages stamped with the enqueue time while nothing but heartbeats arrives, reads them back from
+// the master side of the pty and reports the enqueue to wire latency and the number of write calls per message.
+#include <pty.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Mavlink.hpp>
+#include <MessageParser.hpp>
+#include <SerialConnection.hpp>
+#include <helpers.hpp>
+
+struct Scenario {
+	const char* name;
+	size_t burst;       // Messages queued back to back
+	int interval_us;    // Pause between bursts
+	size_t rounds;
+};
+
+int main()
+{
+	int master;
+	int slave;
+	char name[64];
+
+	if (openpty(&master, &slave, name, nullptr, nullptr) != 0) {
+		LOG(RED_TEXT "openpty failed" NORMAL_TEXT);
+		return 1;
+	}
+
+	struct termios tc;
+	tcgetattr(master, &tc);
+	cfmakeraw(&tc);
+	tcsetattr(master, TCSANOW, &tc);
+
+	mavlink::ConfigurationSettings settings = {
+		.connection_url = std::string("serial:") + name + ":921600",
+		.sysid = 1,
+		.compid = 1,
+		.serial_low_latency = true
+	};
+
+	mavlink::Mavlink mavlink(settings);
+	mavlink::SerialConnection connection(&mavlink);
+
+	if (connection.start() != mavlink::ConnectionResult::Success) {
+		LOG(RED_TEXT "Failed to start connection" NORMAL_TEXT);
+		return 1;
+	}
+
+	std::atomic<bool> running {true};
+	std::mutex mutex;
+	std::vector<double> latencies;
+
+	// Heartbeats are the only traffic towards the connection, it connects to sysid 0 compid 0 by default
+	std::thread heartbeats([&]() {
+		uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+		mavlink_message_t message;
+		mavlink_heartbeat_t heartbeat = { .type = MAV_TYPE_GCS, .mavlink_version = 3 };
+		mavlink_msg_heartbeat_encode(0, 0, &message, &heartbeat);
+		uint16_t length = mavlink_msg_to_send_buffer(buffer, &message);
+
+		while (running) {
+			[[maybe_unused]] ssize_t ret = write(master, buffer, length);
+			std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		}
+	});
+
+	std::thread reader([&]() {
+		MessageParser parser;
+		mavlink_message_t message;
+		char buffer[4096];
+
+		while (running) {
+			const ssize_t length = read(master, buffer, sizeof(buffer));
+
+			if (length <= 0) {
+				continue;
+			}
+
+			const uint64_t now = micros();
+			parser.set_input(buffer, length);
+
+			while (parser.parse(&message)) {
+				if (message.msgid == MAVLINK_MSG_ID_HIGHRES_IMU) {
+					mavlink_highres_imu_t imu;
+					mavlink_msg_highres_imu_decode(&message, &imu);
+					std::scoped_lock<std::mutex> lock(mutex);
+					latencies.push_back(double(now - imu.time_usec));
+				}
+			}
+		}
+	});
+
+	while (!connection.connected()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	const Scenario scenarios[] = {
+		{ "single 1kHz", 1, 1000, 2000 },
+		{ "burst 10", 10, 5000, 400 },
+		{ "burst 100", 100, 20000, 100 },
+	};
+
+	std::vector<std::string> rows;
+
+	for (const Scenario& scenario : scenarios) {
+		{
+			std::scoped_lock<std::mutex> lock(mutex);
+			latencies.clear();
+		}
+
+		const uint64_t syscalls_start = connection.write_syscalls();
+		const size_t expected = scenario.burst * scenario.rounds;
+
+		for (size_t round = 0; round < scenario.rounds; round++) {
+			for (size_t i = 0; i < scenario.burst; i++) {
+				mavlink_highres_imu_t imu = { .time_usec = micros() };
+				mavlink_message_t message;
+				mavlink_msg_highres_imu_encode(1, 1, &message, &imu);
+
+				while (!connection.queue_message(message)) {
+					std::this_thread::yield();
+				}
+			}
+
+			std::this_thread::sleep_for(std::chrono::microseconds(scenario.interval_us));
+		}
+
+		// Wait for the tail end to come out of the pty
+		for (int i = 0; i < 100; i++) {
+			std::scoped_lock<std::mutex> lock(mutex);
+
+			if (latencies.size() >= expected) {
+				break;
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+
+		std::scoped_lock<std::mutex> lock(mutex);
+		std::sort(latencies.begin(), latencies.end());
+		const size_t received = latencies.size();
+		const double writes = double(connection.write_syscalls() - syscalls_start);
+
+		char row[256];
+		snprintf(row, sizeof(row), "%-12s %10zu %10.3f %10.1f %10.1f %10.1f", scenario.name, received,
+			 writes / double(std::max<size_t>(received, 1)), received ? latencies[received / 2] : 0.0,
+			 received ? latencies[received * 99 / 100] : 0.0, received ? latencies.back() : 0.0);
+		rows.push_back(row);
+	}
+
+	running = false;
+	connection.stop();
+	close(slave); // Wakes up the reader
+	close(master);
+	heartbeats.join();
+	reader.join();
+
+	// Printed at the end, the connection logs while running
+	LOG("\nEnqueue to wire latency over a pty with no incoming traffic but heartbeats");
+	LOG("%-12s %10s %10s %10s %10s %10s", "scenario", "received", "writes/msg", "p50 us", "p99 us", "max us");
+
+	for (auto& row : rows) {
+		LOG("%s", row.c_str());
+	}
+
+	const mavlink::SerialConnection::ReceiveTiming timing = connection.receive_timing();
+	LOG("\nReceived %lu heartbeats, first byte to dispatch avg %.1f us, max %lu us", timing.frames,
+	    double(timing.total_us) / double(std::max<uint64_t>(timing.frames, 1)), timing.max_us);
+
+	return 0;
+}
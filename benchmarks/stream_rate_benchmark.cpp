@@ -0,0 +1,215 @@
+// Publishes HIGHRES_IMU at 1 kHz and ATTITUDE at 500 Hz over UDP loopback while both streams are limited to lower rates,
+// once without and once with a link budget. Reports the rate each stream arrives at and the age of the samples.
+// Runs with the connection's own threads, on an event loop and on io_uring, where the connection's thread runs the
+// scheduler, and reports the threads of the process while the streams run.
+#include <dirent.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <EventLoop.hpp>
+#include <Mavlink.hpp>
+#include <MessageParser.hpp>
+#include <helpers.hpp>
+
+static constexpr int RECEIVER_PORT = 14810; // Each run binds the next port, an io_uring ring lets go of its socket with a delay
+static constexpr int DURATION_MS = 3000;
+
+struct StreamResult {
+	size_t received {};
+	std::vector<double> ages_us {};
+};
+
+struct Transport {
+	const char* name;
+	bool event_loop;
+	bool io_uring;
+};
+
+static size_t thread_count()
+{
+	size_t count = 0;
+	DIR* dir = opendir("/proc/self/task");
+
+	while (dir && readdir(dir)) {
+		count++;
+	}
+
+	if (dir) {
+		closedir(dir);
+	}
+
+	return count > 2 ? count - 2 : 0; // . and ..
+}
+
+static int port = RECEIVER_PORT;
+
+static void run(const Transport& transport, uint32_t budget_bytes_per_second)
+{
+	port++;
+	std::shared_ptr<mavlink::EventLoop> loop;
+
+	if (transport.event_loop) {
+		loop = std::make_shared<mavlink::EventLoop>(1);
+		loop->start();
+	}
+
+	mavlink::ConfigurationSettings settings = {
+		.connection_url = "udp://127.0.0.1:" + std::to_string(port),
+		.sysid = 1,
+		.compid = 1,
+		.emit_heartbeat = true,
+		.event_loop = loop,
+		.io_uring = transport.io_uring,
+		.stream_budget_bytes_per_second = budget_bytes_per_second
+	};
+
+	mavlink::Mavlink mavlink(settings);
+	mavlink.set_stream_rate(MAVLINK_MSG_ID_HIGHRES_IMU, 50.f);
+	mavlink.set_stream_rate(MAVLINK_MSG_ID_ATTITUDE, 20.f);
+
+	if (mavlink.start() != mavlink::ConnectionResult::Success) {
+		LOG(RED_TEXT "Failed to start connection" NORMAL_TEXT);
+		return;
+	}
+
+	// The other end of the link, sends heartbeats and collects what the streams send
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+	std::atomic<bool> running {true};
+	StreamResult imu_result;
+	StreamResult attitude_result;
+	size_t heartbeats = 0;
+
+	std::thread receiver([&]() {
+		uint8_t heartbeat_buffer[MAVLINK_MAX_PACKET_LEN];
+		mavlink_message_t message;
+		mavlink_heartbeat_t heartbeat = { .type = MAV_TYPE_GCS, .mavlink_version = 3 };
+		mavlink_msg_heartbeat_encode(255, 1, &message, &heartbeat);
+		const uint16_t heartbeat_length = mavlink_msg_to_send_buffer(heartbeat_buffer, &message);
+
+		MessageParser parser;
+		char buffer[2048];
+		uint64_t next_heartbeat_ms = 0;
+
+		while (running) {
+			if (millis() >= next_heartbeat_ms) {
+				sendto(fd, heartbeat_buffer, heartbeat_length, 0, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+				next_heartbeat_ms = millis() + 500;
+			}
+
+			struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+
+			if (poll(&pfd, 1, 100) <= 0) {
+				continue;
+			}
+
+			const ssize_t length = recv(fd, buffer, sizeof(buffer), 0);
+
+			if (length <= 0) {
+				continue;
+			}
+
+			parser.set_input(buffer, length);
+
+			while (parser.parse(&message)) {
+				if (message.msgid == MAVLINK_MSG_ID_HIGHRES_IMU) {
+					mavlink_highres_imu_t imu;
+					mavlink_msg_highres_imu_decode(&message, &imu);
+					imu_result.received++;
+					imu_result.ages_us.push_back(double(micros() - imu.time_usec));
+
+				} else if (message.msgid == MAVLINK_MSG_ID_ATTITUDE) {
+					mavlink_attitude_t attitude;
+					mavlink_msg_attitude_decode(&message, &attitude);
+					attitude_result.received++;
+					attitude_result.ages_us.push_back(double(uint32_t(micros()) - attitude.time_boot_ms));
+
+				} else if (message.msgid == MAVLINK_MSG_ID_HEARTBEAT) {
+					heartbeats++;
+				}
+			}
+		}
+	});
+
+	while (!mavlink.connected()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	// Publishers, far faster than the stream rates
+	const uint64_t end_us = micros() + DURATION_MS * 1000;
+
+	for (size_t tick = 0; micros() < end_us; tick++) {
+		mavlink_message_t message;
+		mavlink_highres_imu_t imu = { .time_usec = micros(), .xacc = 9.81f };
+		mavlink_msg_highres_imu_encode(1, 1, &message, &imu);
+		mavlink.send_message(message);
+
+		if (tick % 2 == 0) {
+			// The age is carried in the low bits of the clock
+			mavlink_attitude_t attitude = { .time_boot_ms = uint32_t(micros()), .roll = 0.1f };
+			mavlink_msg_attitude_encode(1, 1, &message, &attitude);
+			mavlink.send_message(message);
+		}
+
+		std::this_thread::sleep_for(std::chrono::microseconds(1000));
+	}
+
+	const std::vector<mavlink::StreamCounters> counters = mavlink.stream_counters();
+	const size_t threads = thread_count();
+	running = false;
+	receiver.join();
+	mavlink.stop();
+	close(fd);
+
+	if (loop) {
+		loop->stop();
+	}
+
+	LOG("\n%s, budget %s, %zu threads including the publisher and the receiver", transport.name,
+	    budget_bytes_per_second ? (std::to_string(budget_bytes_per_second) + " bytes/s").c_str() : "unlimited", threads);
+	LOG("%-12s %8s %10s %10s %10s %10s", "message", "rate Hz", "wire Hz", "replaced", "age p50us", "age max us");
+
+	for (const mavlink::StreamCounters& stream : counters) {
+		StreamResult& result = stream.message_id == MAVLINK_MSG_ID_HIGHRES_IMU ? imu_result : attitude_result;
+		std::sort(result.ages_us.begin(), result.ages_us.end());
+		const size_t count = result.ages_us.size();
+
+		LOG("%-12s %8.1f %10.1f %10lu %10.0f %10.0f", stream.message_id == MAVLINK_MSG_ID_HIGHRES_IMU ? "HIGHRES_IMU" : "ATTITUDE",
+		    stream.rate_hz, double(result.received) * 1000 / DURATION_MS, stream.replaced, count ? result.ages_us[count / 2] : 0.0,
+		    count ? result.ages_us.back() : 0.0);
+	}
+
+	LOG("%zu heartbeats", heartbeats);
+}
+
+int main()
+{
+	const Transport transports[] = {
+		{ "threads", false, false },
+		{ "event loop", true, false },
+		{ "io_uring", false, true },
+	};
+
+	for (const Transport& transport : transports) {
+		run(transport, 0);
+
+		// Less than both streams need at their rates
+		run(transport, 1000);
+	}
+
+	return 0;
+}
@@ -0,0 +1,158 @@
+// Records frames from several threads into rotated tlog files and reads them back. Reports the cost of record() on the
+// calling thread, the frames dropped because the writer fell behind and whether the files hold every recorded frame.
+#include <endian.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <chrono>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <MessageParser.hpp>
+#include <TlogRecorder.hpp>
+
+static constexpr size_t THREADS = 4;
+static constexpr size_t FRAMES_PER_THREAD = 256 * 1000;
+static constexpr uint64_t ROTATE_BYTES = 8 << 20;
+
+struct FileContent {
+	size_t records {};
+	size_t bad_records {};
+	bool ordered {true};
+};
+
+static double thread_cpu_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return double(ts.tv_sec) * 1e9 + double(ts.tv_nsec);
+}
+
+// Walks the records of a tlog, every frame has to parse and timestamps must not go backwards
+static FileContent read_tlog(const std::string& path)
+{
+	FileContent content;
+	const int fd = open(path.c_str(), O_RDONLY);
+
+	if (fd < 0) {
+		return content;
+	}
+
+	struct stat st;
+	fstat(fd, &st);
+	std::vector<uint8_t> data(st.st_size);
+
+	if (read(fd, data.data(), data.size()) != ssize_t(data.size())) {
+		data.clear();
+	}
+
+	close(fd);
+
+	MessageParser parser;
+	mavlink_message_t message;
+	uint64_t last_timestamp_us = 0;
+	size_t offset = 0;
+
+	while (offset + sizeof(uint64_t) + MAVLINK_NUM_NON_PAYLOAD_BYTES <= data.size()) {
+		uint64_t timestamp_us;
+		memcpy(&timestamp_us, &data[offset], sizeof(timestamp_us));
+		timestamp_us = be64toh(timestamp_us);
+		offset += sizeof(timestamp_us);
+
+		// Threads race to the queue, so allow for some reordering between them
+		content.ordered &= timestamp_us + 100000 >= last_timestamp_us;
+		last_timestamp_us = std::max(last_timestamp_us, timestamp_us);
+
+		parser.set_input(reinterpret_cast<const char*>(&data[offset]), data.size() - offset);
+
+		if (!parser.parse(&message) || parser.frame() != &data[offset]) {
+			content.bad_records++;
+			break;
+		}
+
+		offset += parser.frame_size();
+		content.records++;
+	}
+
+	return content;
+}
+
+// flight.tlog, flight.1.tlog, ...
+static std::string file_name(uint32_t index)
+{
+	return index ? "/tmp/tlog_benchmark." + std::to_string(index) + ".tlog" : "/tmp/tlog_benchmark.tlog";
+}
+
+int main()
+{
+	// The recorder does not overwrite the files of an earlier run, it would continue after them
+	for (uint32_t i = 0; unlink(file_name(i).c_str()) == 0; i++) {}
+
+	const std::string path = file_name(0);
+	mavlink::TlogRecorder recorder(path, ROTATE_BYTES);
+
+	if (!recorder.start()) {
+		return 1;
+	}
+
+	mavlink_message_t message;
+	mavlink_highres_imu_t imu = { .time_usec = 1, .xacc = 9.81f };
+	mavlink_msg_highres_imu_encode(1, 1, &message, &imu);
+	uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+	const uint16_t frame_length = mavlink_msg_to_send_buffer(frame, &message);
+
+	std::vector<double> record_ns(THREADS);
+	std::vector<std::thread> threads;
+
+	for (size_t t = 0; t < THREADS; t++) {
+		threads.emplace_back([&, t]() {
+			for (size_t i = 0; i < FRAMES_PER_THREAD; i += 256) {
+				// CPU time of this thread, the others may run in between on a small machine
+				const double start_ns = thread_cpu_ns();
+
+				for (size_t j = 0; j < 256; j++) {
+					recorder.record(frame, frame_length);
+				}
+
+				record_ns[t] += thread_cpu_ns() - start_ns;
+
+				// Bursts of 256 frames per millisecond and thread
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+	}
+
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	auto stop_start = std::chrono::steady_clock::now();
+	recorder.stop();
+	const double stop_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stop_start).count();
+
+	const mavlink::TlogCounters counters = recorder.counters();
+
+	FileContent total;
+
+	for (uint32_t i = 0; i < counters.files; i++) {
+		const std::string file = file_name(i);
+		const FileContent content = read_tlog(file);
+		total.records += content.records;
+		total.bad_records += content.bad_records;
+		total.ordered &= content.ordered;
+		unlink(file.c_str());
+	}
+
+	const size_t frames = THREADS * FRAMES_PER_THREAD;
+
+	LOG("\n%zu frames of %u bytes from %zu threads", frames, frame_length, THREADS);
+	LOG("record: %.0f ns of CPU time per frame", record_ns[0] / FRAMES_PER_THREAD);
+	LOG("recorded %lu, dropped %lu, %lu bytes in %u files, stop took %.1f ms", counters.recorded, counters.dropped,
+	    counters.bytes, counters.files, stop_ms);
+	LOG("read back %zu records, %zu bad, timestamps %s", total.records, total.bad_records, total.ordered ? "ordered" : "OUT OF ORDER");
+
+	return total.records == counters.recorded && !total.bad_records && total.ordered ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+// Loopback benchmark for the UdpConnection receive path.
+// Blasts HIGHRES_IMU datagrams at a UdpConnection and reports the number of receive syscalls per message
+// for the single recvfrom() path and for a range of recvmmsg() batch sizes.
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Mavlink.hpp>
+#include <UdpConnection.hpp>
+
+static constexpr int RECEIVER_PORT = 14600;
+
+struct Result {
+	uint64_t received {};
+	uint64_t syscalls {};
+	double seconds {};
+};
+
+static Result run(uint16_t batch_size, size_t message_count)
+{
+	mavlink::ConfigurationSettings settings = {
+		.connection_url = "udp://127.0.0.1:" + std::to_string(RECEIVER_PORT),
+		.sysid = 255,
+		.compid = 1,
+		.udp_receive_batch_size = batch_size
+	};
+
+	mavlink::Mavlink mavlink(settings);
+	std::atomic<uint64_t> received {};
+
+	mavlink.subscribe_to_message(MAVLINK_MSG_ID_HIGHRES_IMU, [&received](const mavlink_message_t&) {
+		received++;
+	});
+
+	mavlink::UdpConnection connection(&mavlink);
+
+	if (connection.start() != mavlink::ConnectionResult::Success) {
+		LOG(RED_TEXT "Failed to start connection" NORMAL_TEXT);
+		return {};
+	}
+
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(RECEIVER_PORT);
+	inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+	mavlink_highres_imu_t imu = {};
+	mavlink_message_t message;
+	uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < message_count; i++) {
+		imu.time_usec = i;
+		mavlink_msg_highres_imu_encode(1, 1, &message, &imu);
+		uint16_t length = mavlink_msg_to_send_buffer(buffer, &message);
+		sendto(fd, buffer, length, 0, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+
+		// Let the receiver catch up now and then so that the socket buffer does not overflow
+		if (i % 64 == 63) {
+			std::this_thread::yield();
+		}
+	}
+
+	// Wait until the receiver has drained the socket
+	uint64_t last = 0;
+
+	do {
+		last = received;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	} while (received != last);
+
+	auto elapsed = std::chrono::steady_clock::now() - start;
+
+	Result result = {
+		.received = received,
+		.syscalls = connection.receive_syscalls(),
+		.seconds = std::chrono::duration<double>(elapsed).count() - 0.1
+	};
+
+	close(fd);
+	connection.stop();
+
+	return result;
+}
+
+int main(int argc, const char** argv)
+{
+	size_t message_count = argc > 1 ? std::stoul(argv[1]) : 200000;
+
+	LOG("Sending %zu messages per run over loopback", message_count);
+	LOG("%8s %10s %10s %12s %12s", "batch", "received", "syscalls", "syscalls/msg", "msgs/s");
+
+	for (uint16_t batch_size : {1, 8, 32, 64, 256}) {
+		Result result = run(batch_size, message_count);
+		double per_message = result.received ? double(result.syscalls) / double(result.received) : 0.0;
+		LOG("%8u %10lu %10lu %12.3f %12.0f", batch_size, result.received, result.syscalls, per_message, double(result.received) / result.seconds);
+	}
+
+	return 0;
+}
@@ -19,7 +19,8 @@ enum class ConnectionResult {
 	DestinationIpUnknown,
 	ConnectionsExhausted,
 	ConnectionUrlInvalid,
-	BaudrateUnknown
+	BaudrateUnknown,
+	FileError
 };
 
 std::ostream& operator<<(std::ostream& str, const ConnectionResult& result);
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <ConnectionResult.hpp>
+#include <EventNotifier.hpp>
+
+namespace mavlink
+{
+
+// Runs any number of connections on a small pool of epoll threads instead of a receive and a send thread per connection.
+// Share one loop between Mavlink instances through ConfigurationSettings::event_loop. Each connection is pinned to one
+// thread of the pool, so the callbacks of a connection never run concurrently.
+class EventLoop
+{
+public:
+	class Client
+	{
+	public:
+		virtual ~Client() = default;
+
+		// Called with the epoll events of a file descriptor added with watch()
+		virtual void handle_events(int fd, uint32_t events) = 0;
+
+		// Called about every TICK_INTERVAL_MS
+		virtual void tick() = 0;
+	};
+
+	static constexpr int TICK_INTERVAL_MS = 100;
+
+	explicit EventLoop(size_t threads = 1);
+	~EventLoop();
+
+	// Non-copyable
+	EventLoop(const EventLoop&) = delete;
+	const EventLoop& operator=(const EventLoop&) = delete;
+
+	ConnectionResult start();
+	void stop();
+
+	// Assigns the client to the thread with the fewest clients
+	void attach(Client* client);
+
+	// Removes the client and all its file descriptors. No callback of the client runs after this returns, unless it is
+	// called from one of the client's own callbacks.
+	void detach(Client* client);
+
+	// Level triggered, 'events' as in epoll_ctl()
+	bool watch(Client* client, int fd, uint32_t events);
+	bool modify(Client* client, int fd, uint32_t events);
+
+	// Stops watching one file descriptor of the client, e.g. a device that went away
+	bool unwatch(Client* client, int fd);
+
+	size_t threads() const { return _workers.size(); };
+
+private:
+	struct Watch {
+		Client* client;
+		int fd;
+	};
+
+	struct Worker {
+		int epoll_fd {-1};
+		std::unique_ptr<std::thread> thread {};
+
+		// Held while callbacks run. Recursive so that callbacks can call modify() and detach().
+		std::recursive_mutex mutex {};
+		std::vector<Client*> clients {};
+		std::unordered_map<int, std::unique_ptr<Watch>> watches {};
+
+		// Removed watches whose events may still be in the batch returned by epoll_wait()
+		std::vector<std::unique_ptr<Watch>> retired {};
+
+		EventNotifier wakeup {};
+
+		size_t client_count {}; // Guarded by _clients_mutex
+	};
+
+	void worker_thread_main(Worker* worker);
+
+	Worker* worker_of(Client* client);
+
+	std::vector<std::unique_ptr<Worker>> _workers {};
+
+	// Never held while locking a worker mutex, worker mutexes are always locked first
+	std::mutex _clients_mutex {};
+	std::unordered_map<Client*, Worker*> _clients {};
+
+	std::atomic_bool _should_exit {false};
+};
+
+} // end namespace mavlink
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#include <cstdint>
+
+// Thin wrapper around an eventfd used to wake up a consumer thread.
+// The file descriptor can also be handed to poll/epoll alongside sockets and ttys.
+class EventNotifier
+{
+public:
+	EventNotifier() : _fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {};
+
+	~EventNotifier()
+	{
+		if (_fd >= 0) {
+			close(_fd);
+		}
+	}
+
+	// Non-copyable
+	EventNotifier(const EventNotifier&) = delete;
+	const EventNotifier& operator=(const EventNotifier&) = delete;
+
+	void notify()
+	{
+		uint64_t one = 1;
+		[[maybe_unused]] ssize_t ret = write(_fd, &one, sizeof(one));
+	};
+
+	// Returns true if notified, false on timeout. A negative timeout waits forever.
+	bool wait(int timeout_ms = -1)
+	{
+		struct pollfd pfd = { .fd = _fd, .events = POLLIN, .revents = 0 };
+
+		if (poll(&pfd, 1, timeout_ms) > 0) {
+			reset();
+			return true;
+		}
+
+		return false;
+	};
+
+	// Consumes any pending notifications
+	void reset()
+	{
+		uint64_t count;
+		[[maybe_unused]] ssize_t ret = read(_fd, &count, sizeof(count));
+	};
+
+	int fd() const { return _fd; };
+
+private:
+	int _fd {-1};
+};
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <utility>
+
+#include <EventNotifier.hpp>
+
+// Bounded lock-free queue for many producers and a single consumer.
+// Each cell carries a sequence number that tells producers and the consumer whose turn it is (D. Vyukov's bounded queue).
+// Producers never block, a full queue makes push_back/emplace_back return false. The consumer can block in pop_front,
+// it is woken through an eventfd which is only written to when the consumer is actually waiting.
+template<class T>
+class LockFreeQueue
+{
+public:
+	// Capacity is rounded up to the next power of two
+	LockFreeQueue(size_t capacity)
+	{
+		size_t size = 2;
+
+		while (size < capacity) {
+			size <<= 1;
+		}
+
+		_mask = size - 1;
+		_cells = std::make_unique<Cell[]>(size);
+
+		for (size_t i = 0; i < size; i++) {
+			_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	};
+
+	~LockFreeQueue()
+	{
+		clear();
+	}
+
+	// Non-copyable
+	LockFreeQueue(const LockFreeQueue&) = delete;
+	const LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+	// Constructs the item in place. Safe to call from any thread.
+	template<class... Args>
+	bool emplace_back(Args&& ... args)
+	{
+		size_t position = _head.load(std::memory_order_relaxed);
+		Cell* cell;
+
+		for (;;) {
+			cell = &_cells[position & _mask];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			intptr_t diff = intptr_t(sequence) - intptr_t(position);
+
+			if (diff == 0) {
+				if (_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					break;
+				}
+
+			} else if (diff < 0) {
+				// Full
+				return false;
+
+			} else {
+				position = _head.load(std::memory_order_relaxed);
+			}
+		}
+
+		new (cell->storage) T(std::forward<Args>(args)...);
+		cell->sequence.store(position + 1, std::memory_order_release);
+
+		// Pairs with the fence in wait_for_data()
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (_consumer_waiting.load(std::memory_order_relaxed)) {
+			_notifier.notify();
+		}
+
+		return true;
+	};
+
+	bool push_back(const T& item)
+	{
+		return emplace_back(item);
+	};
+
+	// Consumer only. Moves the front item into 'item'.
+	bool pop_front(T& item, bool blocking = false)
+	{
+		return consume_one([&item](T & front) { item = std::move(front); }, blocking);
+	};
+
+	// Consumer only. Same interface as ThreadSafeQueue::pop_front.
+	std::optional<T> pop_front(bool blocking = false)
+	{
+		std::optional<T> item;
+		consume_one([&item](T & front) { item.emplace(std::move(front)); }, blocking);
+		return item;
+	};
+
+	// Consumer only. Calls 'callback(T&)' on up to 'max' items in place, without copying them out of the queue.
+	template<class F>
+	size_t consume(F&& callback, size_t max = SIZE_MAX)
+	{
+		size_t count = 0;
+
+		while (count < max && consume_one(callback, false)) {
+			count++;
+		}
+
+		return count;
+	};
+
+	// Consumer only. Destroys all queued items.
+	void clear()
+	{
+		consume([](T&) {});
+	};
+
+	// Wakes the consumer up if it is blocked in pop_front. Safe to call from any thread.
+	void wake()
+	{
+		_notifier.notify();
+	};
+
+	bool empty() const
+	{
+		size_t position = _tail.load(std::memory_order_relaxed);
+		const Cell& cell = _cells[position & _mask];
+		return intptr_t(cell.sequence.load(std::memory_order_acquire)) - intptr_t(position + 1) < 0;
+	};
+
+	size_t capacity() const { return _mask + 1; };
+
+	// Readable whenever the consumer should look at the queue again, for use with poll/epoll
+	int fd() const { return _notifier.fd(); };
+
+private:
+	struct Cell {
+		std::atomic<size_t> sequence {};
+		alignas(T) unsigned char storage[sizeof(T)];
+	};
+
+	template<class F>
+	bool consume_one(F&& callback, bool blocking)
+	{
+		if (empty() && (!blocking || !wait_for_data())) {
+			return false;
+		}
+
+		size_t position = _tail.load(std::memory_order_relaxed);
+		Cell& cell = _cells[position & _mask];
+
+		if (intptr_t(cell.sequence.load(std::memory_order_acquire)) - intptr_t(position + 1) < 0) {
+			return false;
+		}
+
+		T* item = std::launder(reinterpret_cast<T*>(cell.storage));
+		callback(*item);
+		item->~T();
+
+		cell.sequence.store(position + _mask + 1, std::memory_order_release);
+		_tail.store(position + 1, std::memory_order_relaxed);
+		return true;
+	};
+
+	// Blocks until a producer pushes or wake() is called. Returns true if there is data.
+	bool wait_for_data()
+	{
+		_consumer_waiting.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (empty()) {
+			_notifier.wait();
+		}
+
+		_consumer_waiting.store(false, std::memory_order_relaxed);
+		return !empty();
+	};
+
+	static constexpr size_t CACHE_LINE_SIZE = 64;
+
+	std::unique_ptr<Cell[]> _cells {};
+	size_t _mask {};
+
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> _head {};
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> _tail {};
+	alignas(CACHE_LINE_SIZE) std::atomic<bool> _consumer_waiting {};
+
+	EventNotifier _notifier {};
+};
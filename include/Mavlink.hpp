@@ -6,8 +6,11 @@
 #include <mutex>
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include <ConnectionResult.hpp>
+#include <EventLoop.hpp>
+#include <MessageTraits.hpp>
 #include <ThreadSafeQueue.hpp>
 
 #include <mavlink.h>
@@ -16,9 +19,42 @@ namespace mavlink
 {
 
 using MessageCallback = std::function<void(const mavlink_message_t&)>;
+// Also gets the receive time of the message, see ConfigurationSettings::receive_timestamps
+using TimedMessageCallback = std::function<void(const mavlink_message_t&, uint64_t received_ns)>;
+using SubscriptionHandle = uint64_t; // Identifies a single subscription, 0 is never a valid handle
+
+// What the receiving thread does when the dispatch queue of a worker thread is full
+enum class DispatchOverflowPolicy {
+	DropNewest, // Drop the received message
+	Block,      // Wait until the worker makes room. Backs up into the socket or serial buffers.
+};
+
+// Outbound traffic classes, a higher class is always sent first. 
+enum class OutboxClass : uint8_t {
+	Control,   // Commands, acks, mode changes
+	Heartbeat,
+	Telemetry,
+	Bulk,      // Parameters, logs, missions, file transfer
+	Count
+};
+
+// What a class of the outbox does when it is full
+enum class OutboxPolicy : uint8_t {
+	DropNewest,  // Drop the message being queued
+	DropOldest,  // Drop queued messages that are not being sent yet to make room
+	LatestValue, // Replace the queued message with the same ID, drop the oldest if still full
+};
+
+// Class send_message() puts a message in
+OutboxClass outbox_class(uint32_t message_id);
+
+struct OutboxClassSettings {
+	size_t size_bytes {}; // Rounded up to a power of two. 0 uses outbox_size_bytes for telemetry and 4 KiB for the other classes.
+	OutboxPolicy policy {};
+};
 
 struct ConfigurationSettings {
-	std::string connection_url {};  // Connection string format -- udp://0.0.0.0:14561
+	std::string connection_url {};  // Connection string format -- udp://0.0.0.0:14561, udpout://127.0.0.1:14550, serial:/dev/ttyUSB0:921600, replay://flight.tlog?speed=1
 	uint8_t sysid {};               // System ID of this system
 	uint8_t compid {};              // Component ID of this system
 	uint8_t target_sysid {};        // System ID to connect to. If set to 0 all messages from all systems will be handled.
@@ -26,6 +62,24 @@ struct ConfigurationSettings {
 	uint8_t mav_type {};            // See https://mavlink.io/en/messages/common.html#MAV_TYPE
 	uint8_t mav_autopilot {};       // see https://mavlink.io/en/messages/common.html#MAV_AUTOPILOT
 	bool emit_heartbeat {};         // If set to true will emit heartbeats at 1Hz
+	uint16_t udp_receive_batch_size {}; // Datagrams read per recvmmsg() call. 0 or 1 uses a single recvfrom() per datagram.
+	uint16_t udp_send_batch_size {};    // Queued messages flushed per sendmmsg() call. 0 or 1 uses a single sendto() per message.
+	size_t outbox_size_bytes {};        // Size of the outgoing telemetry queue in bytes, rounded up to a power of two. Defaults to 16 KiB if 0.
+	OutboxClassSettings outbox_classes[size_t(OutboxClass::Count)] {}; // Indexed by OutboxClass
+	uint16_t dispatch_threads {};       // Worker threads running the message callbacks. 0 runs them in the receiving thread.
+	uint32_t dispatch_queue_size {};    // Messages queued per worker thread, rounded up to a power of two. Defaults to 1024 if 0.
+	DispatchOverflowPolicy dispatch_overflow_policy {};
+	std::shared_ptr<EventLoop> event_loop {}; // Runs the connection on this event loop instead of its own threads. See EventLoop.hpp.
+	bool io_uring {};                   // Runs the connection on one io_uring thread. Falls back to plain syscalls if the kernel lacks support.
+	bool serial_low_latency {};         // Serial only. Returns reads at the first byte, requests ASYNC_LOW_LATENCY and times received frames.
+	uint32_t stream_budget_bytes_per_second {}; // Link budget shared by the streams with a rate, see set_stream_rate(). 0 for no limit.
+	uint16_t param_values_per_second {}; // Caps the parameter list stream. 0 sends as fast as the outbox takes them.
+	std::string tlog_path {};           // Records every frame received and sent into this tlog file. Empty to not record.
+	uint64_t tlog_rotate_bytes {};      // Continues in a new numbered file once a tlog reaches this size. 0 to never rotate.
+	bool latency_histograms {};         // Times callbacks, outbox residency and receive to dispatch, see latency_histograms()
+	bool receive_timestamps {};         // Passes the receive time to timed subscribers. UDP takes the kernel timestamp of the datagram, serial the time the read returned.
+	std::vector<uint32_t> cached_messages {}; // Message IDs whose newest message per sysid and compid is kept, see latest_message()
+	uint16_t message_cache_sources {};  // Systems and components cached per message ID, rounded up to a power of two. Later ones are not. Defaults to 16 if 0.
 };
 
 struct Parameter {
@@ -40,6 +94,25 @@ struct Parameter {
 	uint8_t type {}; // See https://mavlink.io/en/messages/common.html#MAV_PARAM_TYPE
 };
 
+// Parameter of a remote component, see Mavlink::fetch_parameters()
+struct ParameterEntry {
+	char name[16] {}; // Not null terminated if the name takes all 16 characters, empty if the parameter never arrived
+	union {
+		float float_value;
+		int int_value;
+	};
+
+	uint8_t type {}; // See https://mavlink.io/en/messages/common.html#MAV_PARAM_TYPE
+};
+
+struct ParameterFetchResult {
+	bool complete {};             // Every parameter arrived
+	uint64_t elapsed_us {};       // From PARAM_REQUEST_LIST until the last parameter arrived or the fetch gave up
+	uint32_t received {};         // Parameters that arrived
+	uint32_t requested {};        // PARAM_REQUEST_READs sent for parameters missing from the list
+	std::vector<ParameterEntry> parameters {}; // Indexed by param_index
+};
+
 struct MavlinkCommand {
 	MavlinkCommand(uint16_t source_system, uint16_t source_component, const mavlink_command_long_t& msg)
 		: source_system(source_system)
@@ -66,7 +139,114 @@ struct MavlinkCommand {
 	float param7 {};
 };
 
+// Per dispatch worker thread
+struct DispatchCounters {
+	uint64_t dispatched {};
+	uint64_t dropped {};  // Messages dropped because the queue was full
+	uint64_t blocked {};  // Messages the receiving thread had to wait for
+};
+
+// Per outbox class
+struct OutboxCounters {
+	uint64_t queued {};
+	uint64_t dropped {};  // Messages dropped by the policy of the class
+	uint64_t replaced {}; // Queued messages replaced by a newer one with the same ID
+};
+
+// Per stream with a rate
+struct StreamCounters {
+	uint32_t message_id {};
+	uint8_t target_system {};
+	uint8_t target_component {};
+	float rate_hz {};
+	uint64_t sent {};
+	uint64_t replaced {}; // Samples replaced by a newer one before their slot
+};
+
+// Tlog recording, see ConfigurationSettings::tlog_path
+struct TlogCounters {
+	uint64_t recorded {};
+	uint64_t dropped {}; // Frames dropped because the writer fell behind or the file could not be written
+	uint64_t bytes {};   // Written to the files
+	uint32_t files {};
+};
+
+// Playback of a replay:// connection
+struct ReplayCounters {
+	uint64_t frames {};      // Frames played
+	uint64_t bad_records {}; // Records without a valid frame
+	uint64_t elapsed_us {};  // Since the start, until the end of the file once finished
+	bool finished {};
+};
+
+// Per message ID received, see LinkStatistics
+struct MessageStatistics {
+	uint32_t message_id {};
+	uint64_t received {};
+	float rate_hz {}; // Averaged over windows of at least a second, 0 once the message stopped arriving
+};
+
+// Per system and component heard from, see LinkStatistics
+struct SourceStatistics {
+	uint8_t sysid {};
+	uint8_t compid {};
+	uint64_t received {};
+	uint64_t lost {}; // Frames missing from the sequence numbers
+};
+
+// Counters of the connection, see Mavlink::statistics()
+struct LinkStatistics {
+	uint64_t bytes_received {};
+	uint64_t frames_received {};
+	uint64_t crc_errors {};
+	uint64_t bytes_dropped {};  // Received bytes that were not part of a valid frame
+	uint64_t bytes_sent {};     // Handed to the kernel
+	uint64_t frames_sent {};
+	uint64_t outbox_dropped {}; // Messages dropped by the outbox policies, see outbox_counters() for the classes
+	uint64_t lost {};           // Sum of the sources
+	std::vector<MessageStatistics> messages {}; // Sorted by message ID
+	std::vector<SourceStatistics> sources {};   // Sorted by sysid and compid
+};
+
+// Distribution of a latency in nanoseconds, percentiles are the upper limit of their histogram bucket
+struct LatencySnapshot {
+	uint64_t count {};
+	uint64_t mean_ns {};
+	uint64_t p50_ns {};
+	uint64_t p90_ns {};
+	uint64_t p99_ns {};
+	uint64_t p999_ns {};
+	uint64_t max_ns {};
+};
+
+struct CallbackLatency {
+	uint32_t message_id {};
+	LatencySnapshot duration {}; // All callbacks of one message
+};
+
+// See Mavlink::latency_histograms()
+struct LatencyHistograms {
+	LatencySnapshot receive {}; // From the receive timestamp of a frame until its callbacks start, including the dispatch queue
+	LatencySnapshot outbox {};  // From queueing a frame until it is handed to the kernel
+	std::vector<CallbackLatency> callbacks {}; // Sorted by message ID
+};
+
+// See Mavlink::latest_message()
+struct CachedMessage {
+	mavlink_message_t message {};
+	uint64_t received_ns {}; // Receive time, 0 unless receive_timestamps or latency_histograms is set
+	uint64_t updates {};     // Messages received for this sysid, compid and message ID so far
+};
+
 class Connection;
+class MessageDispatcher;
+class DispatchExecutor;
+class StreamScheduler;
+class ParameterServer;
+class ParameterClient;
+class TlogRecorder;
+class LatencyRecorder;
+class MessageCache;
 
 class Mavlink
 {
@@ -80,48 +260,132 @@ public:
 	uint8_t sysid() const { return _settings.sysid; };
 	uint8_t compid() const { return _settings.compid; };
 
-	void subscribe_to_message(uint16_t message_id, const MessageCallback& callback);
-	void handle_message(const mavlink_message_t& message);
+	// Any number of callbacks can subscribe to the same message, they are called in subscription order
+	SubscriptionHandle subscribe_to_message(uint32_t message_id, const MessageCallback& callback);
+
+	// Called with the receive time as std::chrono::steady_clock nanoseconds, 0 unless receive_timestamps or latency_histograms is set
+	SubscriptionHandle subscribe_to_message(uint32_t message_id, const TimedMessageCallback& callback);
+
+	// Typed subscription, e.g. subscribe<mavlink_highres_imu_t>([](const mavlink_highres_imu_t& imu) { ... });
+	// The message is decoded once per received message and the decoded struct is shared by all typed subscribers.
+	// A callback taking (const T&, uint64_t received_ns) also gets the receive time.
+	template<typename T, typename F>
+	SubscriptionHandle subscribe(F&& callback)
+	{
+		using Callback = std::decay_t<F>;
+		auto context = std::make_shared<Callback>(std::forward<F>(callback));
+		return subscribe_decoded(MessageTraits<T>::id, &decode_as<T>, &invoke_as<T, Callback>, std::move(context));
+	}
+
+	bool unsubscribe(SubscriptionHandle handle);
+	// 'received_ns' is the steady_clock time the message was received, 0 if unknown
+	void handle_message(const mavlink_message_t& message, uint64_t received_ns = 0);
 
 	bool connected();
 
+	// One entry per dispatch worker thread, empty if callbacks run in the receiving thread
+	std::vector<DispatchCounters> dispatch_counters() const;
+
+	// Indexed by OutboxClass, empty before start()
+	std::vector<OutboxCounters> outbox_counters() const;
+
+	// Once a message ID has a rate, send_message() only keeps its newest sample and a timer sends that at the rate. The timer
+	// runs on the thread of an event loop or io_uring connection, or on a thread of its own.
+	// A rate for a target applies to the messages addressed to that system and component. A rate of 0 removes the stream.
+	// Only send_message() is rate limited. The heartbeat, STATUSTEXT, PARAM_VALUE and COMMAND_ACK this class sends itself
+	// bypass the streams, they are paced on their own or must not be thinned out.
+	void set_stream_rate(uint32_t message_id, float rate_hz, uint8_t target_system = 0, uint8_t target_component = 0);
+	std::vector<StreamCounters> stream_counters() const;
+
+	// Zero if not recording
+	TlogCounters tlog_counters() const;
+
+	// Zero unless the connection is a replay:// of a tlog
+	ReplayCounters replay_counters() const;
+
+	// Snapshot of the link counters, read without blocking the connection. Zero before start().
+	LinkStatistics statistics() const;
+
+	// Empty unless latency_histograms is set. The histograms are also logged on stop().
+	LatencyHistograms latency_histograms() const;
+
+	// Newest 'message_id' from 'sysid' and 'compid' if the ID is in cached_messages. Any thread, without blocking the
+	// receiving thread. Returns false if none was received yet.
+	bool latest_message(uint32_t message_id, uint8_t sysid, uint8_t compid, CachedMessage* cached) const;
+
+	// Typed, e.g. latest<mavlink_attitude_t>(1, 1, &attitude)
+	template<typename T>
+	bool latest(uint8_t sysid, uint8_t compid, T* decoded, uint64_t* received_ns = nullptr) const
+	{
+		return latest_decoded(MessageTraits<T>::id, sysid, compid, &decode_as<T>, decoded, received_ns);
+	}
+
 	//-----------------------------------------------------------------------------
 	// Message senders
 	void send_message(const mavlink_message_t& message);
+	void send_message(const mavlink_message_t& message, OutboxClass outbox_class);
 	void send_heartbeat();
 	void send_status_text(std::string&& message, MAV_SEVERITY severity = MAV_SEVERITY_CRITICAL);
 	void send_command_ack(const mavlink::MavlinkCommand& mav_cmd, MAV_RESULT mav_result);
 
 	//-----------------------------------------------------------------------------
 	// Helpers
+	// Once per instance, later calls are ignored
 	void enable_parameters(std::function<std::vector<Parameter>(void)> request_list_cb,
 			       std::function<bool(Parameter*)> set_cb);
 
+	// Fetches all parameters of a remote component. Blocks until every parameter arrived, or none arrived for 'timeout_ms'.
+	// Must not be called from a message callback.
+	ParameterFetchResult fetch_parameters(uint8_t target_system, uint8_t target_component, uint32_t timeout_ms = 1000);
+
 private:
 	const ConfigurationSettings& settings() const { return _settings; };
 
+	SubscriptionHandle subscribe_decoded(uint32_t message_id, DecodeFunction decode, DecodedCallback callback,
+					     std::shared_ptr<void> context);
+
+	bool latest_decoded(uint32_t message_id, uint8_t sysid, uint8_t compid, DecodeFunction decode, void* decoded,
+			    uint64_t* received_ns) const;
+
 	//-----------------------------------------------------------------------------
 	// Message handlers
-	void handle_param_request_list(const mavlink_message_t& message);
-	void handle_param_set(const mavlink_message_t& message);
+	void handle_param_request_list(const mavlink_param_request_list_t& msg);
+	void handle_param_request_read(const mavlink_param_request_read_t& msg);
+	void handle_param_set(const mavlink_param_set_t& msg);
 	//-----------------------------------------------------------------------------
 	// Message senders
-	void send_param_value(const Parameter& param);
+	bool send_param_value(const Parameter& param);
+	bool send_payload(uint32_t message_id, const void* payload, uint8_t max_length, uint8_t crc_extra);
+	bool ready_to_send();
+
+	// Connected, or a udpout:// remote that is announced to before it answers
+	bool can_send();
 
 private:
+	static constexpr size_t DEFAULT_DISPATCH_QUEUE_SIZE = 1024;
+
 	ConfigurationSettings _settings {};
 
+	// Outlives everything that records into it
+	std::unique_ptr<LatencyRecorder> _latency {};
+	bool _latency_logged {};
+
 	std::unique_ptr<Connection> _connection {};
 
-	// Mavlink parameter callbacks
-	std::function<std::vector<Parameter>(void)> _mav_param_request_list_cb;
-	std::function<bool(Parameter* param)> _mav_param_set_cb;
+	// Mavlink parameter callbacks, served from a cache
+	std::unique_ptr<ParameterServer> _parameter_server {};
+	size_t _parameter_task {}; // Scheduler task streaming the parameters, woken by the requests
+	std::unique_ptr<ParameterClient> _parameter_client {};
 
-	std::mutex _subscriptions_mutex {};
-	std::unordered_map<uint16_t, MessageCallback> _message_subscriptions {}; // Mavlink message ID --> callback(mavlink_message_t)
+	std::unique_ptr<MessageDispatcher> _dispatcher; // Mavlink message ID --> callbacks(mavlink_message_t)
+	std::unique_ptr<DispatchExecutor> _executor {};
+	std::unique_ptr<StreamScheduler> _scheduler {}; // Rate-limited streams and the heartbeat
+	std::unique_ptr<TlogRecorder> _recorder {};
+	std::unique_ptr<MessageCache> _cache {};
 
 	friend class UdpConnection;
 	friend class SerialConnection;
+	friend class ReplayConnection;
 };
 
 } // end namespace mavlink
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+#include <mavlink.h>
+
+namespace mavlink
+{
+
+// Decodes 'message' into the struct at 'decoded'
+using DecodeFunction = void(*)(const mavlink_message_t& message, void* decoded);
+// Calls the subscriber stored in 'context' with the decoded struct and the receive time of the message
+using DecodedCallback = void(*)(void* context, const void* decoded, uint64_t received_ns);
+
+// Maps a generated message struct to its message ID and decode function at compile time.
+// Messages that are not listed at the bottom of this file can be added with MAVLINK_MESSAGE_TRAITS() at global scope.
+template<typename T>
+struct MessageTraits;
+
+template<typename T>
+void decode_as(const mavlink_message_t& message, void* decoded)
+{
+	MessageTraits<T>::decode(message, static_cast<T*>(decoded));
+}
+
+// Subscribers that take a second uint64_t argument get the receive time, see ConfigurationSettings::receive_timestamps
+template<typename T, typename F>
+void invoke_as(void* context, const void* decoded, uint64_t received_ns)
+{
+	if constexpr (std::is_invocable_v<F&, const T&, uint64_t>) {
+		(*static_cast<F*>(context))(*static_cast<const T*>(decoded), received_ns);
+
+	} else {
+		(*static_cast<F*>(context))(*static_cast<const T*>(decoded));
+	}
+}
+
+} // end namespace mavlink
+
+#define MAVLINK_MESSAGE_TRAITS(name, NAME) \
+	template<> \
+	struct mavlink::MessageTraits<mavlink_##name##_t> { \
+		static_assert(sizeof(mavlink_##name##_t) <= MAVLINK_MAX_PAYLOAD_LEN); \
+		static constexpr uint32_t id = MAVLINK_MSG_ID_##NAME; \
+		static void decode(const mavlink_message_t& message, mavlink_##name##_t* decoded) \
+		{ \
+			mavlink_msg_##name##_decode(&message, decoded); \
+		} \
+	};
+
+MAVLINK_MESSAGE_TRAITS(heartbeat, HEARTBEAT)
+MAVLINK_MESSAGE_TRAITS(system_time, SYSTEM_TIME)
+MAVLINK_MESSAGE_TRAITS(ping, PING)
+MAVLINK_MESSAGE_TRAITS(param_request_read, PARAM_REQUEST_READ)
+MAVLINK_MESSAGE_TRAITS(param_request_list, PARAM_REQUEST_LIST)
+MAVLINK_MESSAGE_TRAITS(param_value, PARAM_VALUE)
+MAVLINK_MESSAGE_TRAITS(param_set, PARAM_SET)
+MAVLINK_MESSAGE_TRAITS(attitude, ATTITUDE)
+MAVLINK_MESSAGE_TRAITS(global_position_int, GLOBAL_POSITION_INT)
+MAVLINK_MESSAGE_TRAITS(command_long, COMMAND_LONG)
+MAVLINK_MESSAGE_TRAITS(command_ack, COMMAND_ACK)
+MAVLINK_MESSAGE_TRAITS(highres_imu, HIGHRES_IMU)
+MAVLINK_MESSAGE_TRAITS(optical_flow_rad, OPTICAL_FLOW_RAD)
+MAVLINK_MESSAGE_TRAITS(timesync, TIMESYNC)
+MAVLINK_MESSAGE_TRAITS(statustext, STATUSTEXT)
@@ -9,4 +9,6 @@
 
 #define LOG(...) do { printf(__VA_ARGS__); puts(""); } while (0)
 
-#define millis() uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count())
+// Monotonic, for intervals and timeouts only
+#define millis() uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count())
+#define micros() uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count())
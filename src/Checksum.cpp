@@ -0,0 +1,189 @@
+#include <Checksum.hpp>
+
+#include <array>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace mavlink
+{
+
+static constexpr uint8_t MAVLINK_STX = 0xFD;
+static constexpr uint8_t MAVLINK_STX_MAVLINK1 = 0xFE;
+
+// tables[0] is the classic byte table. tables[k][b] is the CRC of byte b followed by k zero bytes,
+// which lets slicing-by-N fold N input bytes with N independent table lookups.
+static constexpr std::array<std::array<uint16_t, 256>, 8> make_tables()
+{
+	std::array<std::array<uint16_t, 256>, 8> tables {};
+
+	for (unsigned b = 0; b < 256; b++) {
+		uint16_t crc = b;
+
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+		}
+
+		tables[0][b] = crc;
+	}
+
+	for (size_t k = 1; k < tables.size(); k++) {
+		for (unsigned b = 0; b < 256; b++) {
+			uint16_t previous = tables[k - 1][b];
+			tables[k][b] = (previous >> 8) ^ tables[0][previous & 0xFF];
+		}
+	}
+
+	return tables;
+}
+
+static constexpr auto TABLES = make_tables();
+
+uint16_t crc16_accumulate(uint8_t byte, uint16_t crc)
+{
+	return (crc >> 8) ^ TABLES[0][(crc ^ byte) & 0xFF];
+}
+
+uint16_t crc16_bytewise(const uint8_t* data, size_t length, uint16_t crc)
+{
+	// Same arithmetic as crc_accumulate() in checksum.h
+	while (length--) {
+		uint8_t tmp = *data++ ^ uint8_t(crc & 0xFF);
+		tmp ^= (tmp << 4);
+		crc = (crc >> 8) ^ (tmp << 8) ^ (tmp << 3) ^ (tmp >> 4);
+	}
+
+	return crc;
+}
+
+uint16_t crc16_table(const uint8_t* data, size_t length, uint16_t crc)
+{
+	while (length--) {
+		crc = (crc >> 8) ^ TABLES[0][(crc ^ *data++) & 0xFF];
+	}
+
+	return crc;
+}
+
+uint16_t crc16_slicing4(const uint8_t* data, size_t length, uint16_t crc)
+{
+	while (length >= 4) {
+		crc ^= data[0] | (data[1] << 8);
+		crc = TABLES[3][crc & 0xFF] ^ TABLES[2][crc >> 8] ^ TABLES[1][data[2]] ^ TABLES[0][data[3]];
+		data += 4;
+		length -= 4;
+	}
+
+	return crc16_table(data, length, crc);
+}
+
+uint16_t crc16_slicing8(const uint8_t* data, size_t length, uint16_t crc)
+{
+	while (length >= 8) {
+		crc ^= data[0] | (data[1] << 8);
+		crc = TABLES[7][crc & 0xFF] ^ TABLES[6][crc >> 8] ^ TABLES[5][data[2]] ^ TABLES[4][data[3]]
+		      ^ TABLES[3][data[4]] ^ TABLES[2][data[5]] ^ TABLES[1][data[6]] ^ TABLES[0][data[7]];
+		data += 8;
+		length -= 8;
+	}
+
+	return crc16_slicing4(data, length, crc);
+}
+
+const uint8_t* find_start_marker_scalar(const uint8_t* data, size_t length)
+{
+	const uint8_t* end = data + length;
+
+	while (data != end && *data != MAVLINK_STX && *data != MAVLINK_STX_MAVLINK1) {
+		data++;
+	}
+
+	return data;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+const uint8_t* find_start_marker_sse2(const uint8_t* data, size_t length)
+{
+	const __m128i stx = _mm_set1_epi8(char(MAVLINK_STX));
+	const __m128i stx1 = _mm_set1_epi8(char(MAVLINK_STX_MAVLINK1));
+
+	while (length >= 16) {
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+		int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, stx), _mm_cmpeq_epi8(chunk, stx1)));
+
+		if (mask) {
+			return data + __builtin_ctz(mask);
+		}
+
+		data += 16;
+		length -= 16;
+	}
+
+	return find_start_marker_scalar(data, length);
+}
+
+__attribute__((target("avx2")))
+const uint8_t* find_start_marker_avx2(const uint8_t* data, size_t length)
+{
+	const __m256i stx = _mm256_set1_epi8(char(MAVLINK_STX));
+	const __m256i stx1 = _mm256_set1_epi8(char(MAVLINK_STX_MAVLINK1));
+
+	while (length >= 32) {
+		__m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+		unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, stx), _mm256_cmpeq_epi8(chunk, stx1)));
+
+		if (mask) {
+			return data + __builtin_ctz(mask);
+		}
+
+		data += 32;
+		length -= 32;
+	}
+
+	return find_start_marker_sse2(data, length);
+}
+#endif
+
+using FindStartMarker = const uint8_t * (*)(const uint8_t*, size_t);
+
+struct StartMarkerSearch {
+	FindStartMarker function;
+	const char* name;
+};
+
+static StartMarkerSearch select_start_marker_search()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		return { find_start_marker_avx2, "avx2" };
+	}
+
+	if (__builtin_cpu_supports("sse2")) {
+		return { find_start_marker_sse2, "sse2" };
+	}
+
+#endif
+	return { find_start_marker_scalar, "scalar" };
+}
+
+static const StartMarkerSearch& start_marker_search()
+{
+	static const StartMarkerSearch search = select_start_marker_search();
+	return search;
+}
+
+const uint8_t* find_start_marker(const uint8_t* data, size_t length)
+{
+	return start_marker_search().function(data, length);
+}
+
+const char* start_marker_search_name()
+{
+	return start_marker_search().name;
+}
+
+} // end namespace mavlink
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mavlink
+{
+
+// CRC-16/MCRF4XX as used by MAVLink (X.25 polynomial, reflected, init 0xFFFF). All variants produce the same result as
+// running crc_accumulate() from the generated headers over every byte, they differ only in how many bytes they consume per step.
+uint16_t crc16_bytewise(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF);
+uint16_t crc16_table(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF);
+uint16_t crc16_slicing4(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF);
+uint16_t crc16_slicing8(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF);
+
+// Fastest variant, use this one
+inline uint16_t crc16(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF)
+{
+	return crc16_slicing8(data, length, crc);
+}
+
+// Equivalent of crc_accumulate() for a single byte
+uint16_t crc16_accumulate(uint8_t byte, uint16_t crc);
+
+// Returns a pointer to the first MAVLink 1 or 2 start marker (0xFE/0xFD), or data + length if there is none.
+// The implementation is picked once at startup from what the CPU supports.
+const uint8_t* find_start_marker(const uint8_t* data, size_t length);
+
+const uint8_t* find_start_marker_scalar(const uint8_t* data, size_t length);
+#if defined(__x86_64__) || defined(__i386__)
+const uint8_t* find_start_marker_sse2(const uint8_t* data, size_t length);
+const uint8_t* find_start_marker_avx2(const uint8_t* data, size_t length);
+#endif
+
+// Name of the start marker search picked for this CPU: "scalar", "sse2" or "avx2"
+const char* start_marker_search_name();
+
+} // end namespace mavlink
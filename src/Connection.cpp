@@ -1,10 +1,15 @@
 #include <Connection.hpp>
+#include <FrameEncoder.hpp>
+
+#include <sys/epoll.h>
 
 namespace mavlink
 {
 
-Connection::Connection(uint64_t connection_timeout_ms)
-	: _connection_timeout_ms(connection_timeout_ms)
+Connection::Connection(uint64_t connection_timeout_ms, const ConfigurationSettings& settings)
+	: _timestamps(settings.receive_timestamps || settings.latency_histograms)
+	, _message_outbox_queue(settings, DEFAULT_OUTBOX_SIZE_BYTES)
+	, _connection_timeout_ms(connection_timeout_ms)
 {}
 
 bool Connection::connected()
@@ -19,7 +24,79 @@ bool Connection::connection_timed_out()
 
 bool Connection::queue_message(const mavlink_message_t& message)
 {
-	return _message_outbox_queue.push_back(message);
+	return queue_message(message, outbox_class(message.msgid));
+}
+
+bool Connection::queue_message(const mavlink_message_t& message, OutboxClass outbox_class)
+{
+	const uint16_t length = frame_length(message);
+
+	const mavlink_msg_entry_t* entry = mavlink_get_msg_entry(message.msgid);
+
+	// Signed and MAVLink 1 frames go out as they were finalized, the signature covers the sequence number
+	const bool renumber = entry && message.magic == MAVLINK_STX && !(message.incompat_flags & MAVLINK_IFLAG_SIGNED);
+
+	return _message_outbox_queue.push(outbox_class, message.msgid, length, [&](uint8_t* buffer) {
+		if (renumber) {
+			encode_frame(buffer, message.sysid, message.compid, _tx_sequence++, message.msgid, _MAV_PAYLOAD(&message), message.len,
+				     entry->crc_extra);
+
+		} else {
+			mavlink_msg_to_send_buffer(buffer, &message);
+		}
+	});
+}
+
+bool Connection::queue_payload(uint8_t sysid, uint8_t compid, uint32_t msgid, const void* payload, uint8_t max_length, uint8_t crc_extra)
+{
+	const uint16_t length = frame_length(payload, max_length);
+
+	return _message_outbox_queue.push(outbox_class(msgid), msgid, length, [&](uint8_t* buffer) {
+		encode_frame(buffer, sysid, compid, _tx_sequence++, msgid, payload, max_length, crc_extra);
+	});
+}
+
+LinkStatistics Connection::statistics() const
+{
+	LinkStatistics statistics;
+	_link_counters.snapshot(&statistics, millis());
+	statistics.bytes_sent = _message_outbox_queue.bytes_sent();
+	statistics.frames_sent = _message_outbox_queue.frames_sent();
+
+	for (const OutboxCounters& counters : _message_outbox_queue.counters()) {
+		statistics.outbox_dropped += counters.dropped;
+	}
+
+	return statistics;
+}
+
+void Connection::drain_outbox()
+{
+	_message_outbox_queue.disarm();
+
+	// Frames stay queued until the connection is up, this is called again once it is
+	if (!(_connected || _remote_known) || _send_blocked) {
+		return;
+	}
+
+	do {
+		if (!flush_outbox()) {
+			LOG(RED_TEXT "Send message failed!" NORMAL_TEXT);
+		}
+
+	} while (!_send_blocked && !_message_outbox_queue.arm());
+}
+
+void Connection::set_send_blocked(int fd, bool blocked)
+{
+	if (blocked != _send_blocked) {
+		_send_blocked = blocked;
+
+		// The sending thread polls for POLLOUT itself while this is set
+		if (_event_loop) {
+			_event_loop->modify(this, fd, blocked ? EPOLLIN | EPOLLOUT : EPOLLIN);
+		}
+	}
 }
 
 bool Connection::should_handle_message(const mavlink_message_t& message)
@@ -3,43 +3,133 @@
 #include <mavlink.h>
 
 #include <ConnectionResult.hpp>
-#include <ThreadSafeQueue.hpp>
+#include <EventLoop.hpp>
+#include <IoUring.hpp>
+#include <LatencyHistogram.hpp>
+#include <LinkCounters.hpp>
+#include <MessageParser.hpp>
+#include <Outbox.hpp>
+#include <TlogRecorder.hpp>
 #include <helpers.hpp>
 
 namespace mavlink
 {
 
-class Connection
+class StreamScheduler;
+
+class Connection : public EventLoop::Client
 {
 public:
-	Connection(uint64_t connection_timeout_ms);
+	Connection(uint64_t connection_timeout_ms, const ConfigurationSettings& settings);
 
 	bool connected();
 	bool connection_timed_out();
-	bool queue_message(const mavlink_message_t& message);
+
+	// Messages go out while connected, or right away if the remote address was given up front
+	bool can_send() { return _remote_known || connected(); };
 	bool should_handle_message(const mavlink_message_t& message);
 
+	// Both serialize straight into the outbox. Safe to call from any thread. Return false if the message was dropped.
+	bool queue_message(const mavlink_message_t& message);
+	bool queue_message(const mavlink_message_t& message, OutboxClass outbox_class);
+	bool queue_payload(uint8_t sysid, uint8_t compid, uint32_t msgid, const void* payload, uint8_t max_length, uint8_t crc_extra);
+
+	std::vector<OutboxCounters> outbox_counters() const { return _message_outbox_queue.counters(); };
+
+	// Any thread, without locks
+	LinkStatistics statistics() const;
+
+	// Records the frames received and sent from now on, nullptr stops recording. Set before start().
+	void set_recorder(TlogRecorder* recorder)
+	{
+		_recorder = recorder;
+		_message_outbox_queue.set_recorder(recorder);
+	};
+
+	// Times outbox residency and receive to dispatch. Set before start().
+	void set_latency(LatencyRecorder* latency)
+	{
+		_latency = latency;
+		_message_outbox_queue.set_latency(&latency->outbox);
+	};
+
+	// Event loop and io_uring connections run the scheduler on their thread, see StreamScheduler::run(). Set before start().
+	void set_scheduler(StreamScheduler* scheduler) { _scheduler = scheduler; };
+
+	// Set by start() if the scheduler needs no thread of its own
+	bool runs_scheduler() const { return _runs_scheduler; };
+
 	virtual ConnectionResult start() = 0;
 	virtual void stop() = 0;
-	virtual bool send_message(const mavlink_message_t& message) = 0;
+	virtual bool send_frame(const uint8_t* data, uint16_t length) = 0;
+
+	// Sends what is queued in the outbox. Returns false if a frame could not be sent.
+	// On a non-blocking file descriptor this stops early and calls set_send_blocked() if the kernel buffer is full.
+	virtual bool flush_outbox() = 0;
 
 	static constexpr uint64_t HEARTBEAT_INTERVAL_MS = 1000; // 1Hz
+	static constexpr size_t DEFAULT_OUTBOX_SIZE_BYTES = 16384;
 
 protected:
-	ThreadSafeQueue<mavlink_message_t> _message_outbox_queue {100};
+	// Event loop only. Flushes the outbox until it is empty or sending would block, then waits for the next push.
+	void drain_outbox();
+
+	// Watches 'fd' for writability while the kernel buffer is full. On the event loop or in the sending thread.
+	void set_send_blocked(int fd, bool blocked);
+
+	// Runs the connection instead of its own threads if set
+	std::shared_ptr<EventLoop> _event_loop {};
+	bool _send_blocked {};
+
+	// Set in start() if io_uring was requested and the kernel supports it, runs the connection on a single thread
+	std::unique_ptr<IoUring> _uring {};
+
+	StreamScheduler* _scheduler {};
+	bool _runs_scheduler {};
+
+	// Receiving thread, after each parsed frame
+	void record_received()
+	{
+		if (_recorder) {
+			_recorder->record(_parser.frame(), _parser.frame_size());
+		}
+	};
+
+	// Parser state is per connection, only used by the receiving thread
+	MessageParser _parser {};
+
+	// Receiving thread, after each parsed frame and after parsing all of a read
+	void count_received(const mavlink_message_t& message) { _link_counters.count(message, millis()); };
+	void count_input(size_t length) { _link_counters.input(length, _parser.counters()); };
+
+	LinkCounters _link_counters {};
+
+	// Receiving thread, the time a read returned for MessageDispatcher::dispatch(). 0 unless receive times are taken.
+	uint64_t received_ns() const { return _timestamps ? latency_clock_ns() : 0; };
+
+	// Set if receive_timestamps or latency_histograms is
+	bool _timestamps {};
+
+	LatencyRecorder* _latency {};
+
+	TlogRecorder* _recorder {};
+
+	// Wire format frames by class. Any thread can queue, only the connection's sending thread consumes.
+	Outbox _message_outbox_queue;
+	std::atomic<uint8_t> _tx_sequence {}; // Numbers every frame queued on this connection, taken once the frame has a slot
 
 	uint8_t _target_sysid {};
 	uint8_t _target_compid {};
 
 	bool _initialized {};
-	bool _connected {};
+	// Set by the receiving thread once the remote is known. The release store publishes the remote address to the
+	// sending thread, which loads this before it reads the address.
+	std::atomic<bool> _connected {};
+	bool _remote_known {};
 
 	uint64_t _last_received_heartbeat_ms {};
-	uint64_t _last_sent_heartbeat_ms {};
 
 	uint64_t _connection_timeout_ms {};
-
-	bool _emit_heartbeat {};
 };
 
 } // end namespace mavlink
\ No newline at end of file
@@ -48,6 +48,9 @@ std::ostream& operator<<(std::ostream& str, const ConnectionResult& result)
 	case ConnectionResult::BaudrateUnknown:
 		return str << "Baudrate unknown";
 
+	case ConnectionResult::FileError:
+		return str << "File error";
+
 	default:
 		return str << "Unknown";
 	}
@@ -0,0 +1,130 @@
+#include <DispatchExecutor.hpp>
+#include <MessageDispatcher.hpp>
+
+#include <helpers.hpp>
+
+namespace mavlink
+{
+
+DispatchExecutor::DispatchExecutor(MessageDispatcher* dispatcher, size_t threads, size_t queue_size, DispatchOverflowPolicy policy)
+	: _dispatcher(dispatcher)
+	, _policy(policy)
+{
+	for (size_t i = 0; i < threads; i++) {
+		_shards.push_back(std::make_unique<Shard>(queue_size));
+	}
+}
+
+DispatchExecutor::~DispatchExecutor()
+{
+	stop();
+}
+
+void DispatchExecutor::start()
+{
+	_should_exit = false;
+
+	for (auto& shard : _shards) {
+		shard->thread = std::make_unique<std::thread>(&DispatchExecutor::worker_thread_main, this, shard.get());
+	}
+}
+
+void DispatchExecutor::stop()
+{
+	_should_exit = true;
+
+	// Messages still queued are discarded
+	for (auto& shard : _shards) {
+		if (shard->thread) {
+			shard->room.notify();
+			shard->queue.wake();
+			shard->thread->join();
+			shard->thread.reset();
+			shard->queue.clear();
+		}
+	}
+}
+
+void DispatchExecutor::submit(const mavlink_message_t& message, uint64_t received_ns)
+{
+	Shard& shard = shard_for(message);
+	const Received received = { message, received_ns };
+
+	if (shard.queue.push_back(received)) {
+		return;
+	}
+
+	if (_policy == DispatchOverflowPolicy::DropNewest) {
+		shard.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	// Block: hold up the receiving thread until the worker makes room. The flag is set before each retry, so a pop
+	// that comes after the failed push always sees it and wakes the wait below.
+	shard.blocked.fetch_add(1, std::memory_order_relaxed);
+	shard.submitter_waiting.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	while (!shard.queue.push_back(received)) {
+		if (_should_exit.load(std::memory_order_relaxed)) {
+			shard.dropped.fetch_add(1, std::memory_order_relaxed);
+			break;
+		}
+
+		shard.room.wait(BLOCK_WAIT_TIMEOUT_MS);
+	}
+
+	shard.submitter_waiting.store(false, std::memory_order_relaxed);
+}
+
+std::vector<DispatchCounters> DispatchExecutor::counters() const
+{
+	std::vector<DispatchCounters> counters;
+
+	for (auto& shard : _shards) {
+		counters.push_back({
+			.dispatched = shard->dispatched.load(std::memory_order_relaxed),
+			.dropped = shard->dropped.load(std::memory_order_relaxed),
+			.blocked = shard->blocked.load(std::memory_order_relaxed),
+		});
+	}
+
+	return counters;
+}
+
+void DispatchExecutor::worker_thread_main(Shard* shard)
+{
+	LOG("[DispatchExecutor] Starting worker thread");
+
+	Received received;
+
+	while (!_should_exit.load(std::memory_order_relaxed)) {
+		if (shard->queue.pop_front(received, true)) {
+			// Pairs with the fence in submit()
+			if (_policy == DispatchOverflowPolicy::Block) {
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+
+				if (shard->submitter_waiting.load(std::memory_order_relaxed)) {
+					shard->room.notify();
+				}
+			}
+
+			_dispatcher->dispatch(received.message, received.received_ns);
+			shard->dispatched.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	LOG("[DispatchExecutor] Exiting worker thread");
+}
+
+DispatchExecutor::Shard& DispatchExecutor::shard_for(const mavlink_message_t& message)
+{
+	uint64_t key = (uint64_t(message.sysid) << 32) | (uint64_t(message.compid) << 24) | message.msgid;
+
+	// Fibonacci hashing spreads neighbouring message IDs across the shards
+	key *= 0x9E3779B97F4A7C15ull;
+
+	return *_shards[(key >> 32) % _shards.size()];
+}
+
+} // end namespace mavlink
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <EventNotifier.hpp>
+#include <LockFreeQueue.hpp>
+#include <Mavlink.hpp>
+
+namespace mavlink
+{
+
+class MessageDispatcher;
+
+// Runs message callbacks on worker threads instead of the receiving thread.
+// Each worker owns a bounded queue (a shard). Messages are assigned to a shard by (sysid, compid, msgid), so messages of
+// one stream are handled in order by the same worker while different streams are handled in parallel.
+class DispatchExecutor
+{
+public:
+	DispatchExecutor(MessageDispatcher* dispatcher, size_t threads, size_t queue_size, DispatchOverflowPolicy policy);
+	~DispatchExecutor();
+
+	void start();
+	void stop();
+
+	// Called from the receiving thread, see MessageDispatcher::dispatch()
+	void submit(const mavlink_message_t& message, uint64_t received_ns = 0);
+
+	std::vector<DispatchCounters> counters() const;
+
+private:
+	static constexpr int BLOCK_WAIT_TIMEOUT_MS = 10; // Between checks for stop() while a full shard holds up the receiving thread
+
+	struct Received {
+		mavlink_message_t message;
+		uint64_t received_ns;
+	};
+
+	struct Shard {
+		Shard(size_t queue_size) : queue(queue_size) {}
+
+		LockFreeQueue<Received> queue;
+		std::unique_ptr<std::thread> thread {};
+
+		// Block policy -- the worker signals freed room while the receiving thread waits for it
+		EventNotifier room {};
+		std::atomic<bool> submitter_waiting {};
+
+		std::atomic<uint64_t> dispatched {};
+		std::atomic<uint64_t> dropped {};
+		std::atomic<uint64_t> blocked {};
+	};
+
+	void worker_thread_main(Shard* shard);
+
+	Shard& shard_for(const mavlink_message_t& message);
+
+	MessageDispatcher* _dispatcher {};
+	DispatchOverflowPolicy _policy {};
+
+	std::vector<std::unique_ptr<Shard>> _shards {};
+
+	std::atomic<bool> _should_exit {};
+};
+
+} // end namespace mavlink
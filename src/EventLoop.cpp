@@ -0,0 +1,235 @@
+#include <EventLoop.hpp>
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <helpers.hpp>
+
+namespace mavlink
+{
+
+static constexpr int EPOLL_MAX_EVENTS = 64;
+
+EventLoop::EventLoop(size_t threads)
+{
+	for (size_t i = 0; i < std::max<size_t>(threads, 1); i++) {
+		auto worker = std::make_unique<Worker>();
+		worker->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+		// The wakeup notifier is the only watch without a client
+		struct epoll_event event = { .events = EPOLLIN, .data = { .ptr = nullptr } };
+		epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, worker->wakeup.fd(), &event);
+
+		_workers.push_back(std::move(worker));
+	}
+}
+
+EventLoop::~EventLoop()
+{
+	stop();
+
+	for (auto& worker : _workers) {
+		close(worker->epoll_fd);
+	}
+}
+
+ConnectionResult EventLoop::start()
+{
+	for (auto& worker : _workers) {
+		if (worker->epoll_fd < 0) {
+			LOG("epoll_create1 error");
+			return ConnectionResult::SocketError;
+		}
+	}
+
+	_should_exit = false;
+
+	for (auto& worker : _workers) {
+		if (!worker->thread) {
+			worker->thread = std::make_unique<std::thread>(&EventLoop::worker_thread_main, this, worker.get());
+		}
+	}
+
+	return ConnectionResult::Success;
+}
+
+void EventLoop::stop()
+{
+	_should_exit = true;
+
+	for (auto& worker : _workers) {
+		if (worker->thread) {
+			worker->wakeup.notify();
+			worker->thread->join();
+			worker->thread.reset();
+		}
+	}
+}
+
+void EventLoop::attach(Client* client)
+{
+	Worker* least_busy = nullptr;
+
+	{
+		std::scoped_lock<std::mutex> lock(_clients_mutex);
+
+		for (auto& worker : _workers) {
+			if (!least_busy || worker->client_count < least_busy->client_count) {
+				least_busy = worker.get();
+			}
+		}
+
+		least_busy->client_count++;
+		_clients[client] = least_busy;
+	}
+
+	std::scoped_lock<std::recursive_mutex> lock(least_busy->mutex);
+	least_busy->clients.push_back(client);
+}
+
+void EventLoop::detach(Client* client)
+{
+	Worker* worker = worker_of(client);
+
+	if (!worker) {
+		return;
+	}
+
+	// Waits for the callbacks that are running right now
+	std::scoped_lock<std::recursive_mutex> lock(worker->mutex);
+
+	for (auto it = worker->watches.begin(); it != worker->watches.end();) {
+		if (it->second->client == client) {
+			epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, it->first, nullptr);
+			it->second->client = nullptr;
+			worker->retired.push_back(std::move(it->second));
+			it = worker->watches.erase(it);
+
+		} else {
+			it++;
+		}
+	}
+
+	std::erase(worker->clients, client);
+
+	std::scoped_lock<std::mutex> clients_lock(_clients_mutex);
+	worker->client_count--;
+	_clients.erase(client);
+}
+
+bool EventLoop::watch(Client* client, int fd, uint32_t events)
+{
+	Worker* worker = worker_of(client);
+
+	if (!worker) {
+		return false;
+	}
+
+	std::scoped_lock<std::recursive_mutex> lock(worker->mutex);
+
+	auto watch = std::make_unique<Watch>(Watch { client, fd });
+	struct epoll_event event = { .events = events, .data = { .ptr = watch.get() } };
+
+	if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+		LOG("epoll_ctl add error: %s", strerror(errno));
+		return false;
+	}
+
+	worker->watches[fd] = std::move(watch);
+	return true;
+}
+
+bool EventLoop::modify(Client* client, int fd, uint32_t events)
+{
+	Worker* worker = worker_of(client);
+
+	if (!worker) {
+		return false;
+	}
+
+	std::scoped_lock<std::recursive_mutex> lock(worker->mutex);
+
+	auto it = worker->watches.find(fd);
+
+	if (it == worker->watches.end()) {
+		return false;
+	}
+
+	struct epoll_event event = { .events = events, .data = { .ptr = it->second.get() } };
+	return epoll_ctl(worker->epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+bool EventLoop::unwatch(Client* client, int fd)
+{
+	Worker* worker = worker_of(client);
+
+	if (!worker) {
+		return false;
+	}
+
+	std::scoped_lock<std::recursive_mutex> lock(worker->mutex);
+
+	auto it = worker->watches.find(fd);
+
+	if (it == worker->watches.end() || it->second->client != client) {
+		return false;
+	}
+
+	epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+	it->second->client = nullptr;
+	worker->retired.push_back(std::move(it->second));
+	worker->watches.erase(it);
+	return true;
+}
+
+EventLoop::Worker* EventLoop::worker_of(Client* client)
+{
+	std::scoped_lock<std::mutex> lock(_clients_mutex);
+	auto it = _clients.find(client);
+	return it != _clients.end() ? it->second : nullptr;
+}
+
+void EventLoop::worker_thread_main(Worker* worker)
+{
+	LOG("[EventLoop] Starting worker thread");
+
+	struct epoll_event events[EPOLL_MAX_EVENTS];
+	uint64_t next_tick_ms = millis() + TICK_INTERVAL_MS;
+
+	while (!_should_exit) {
+		const uint64_t now = millis();
+		const int timeout_ms = next_tick_ms > now ? int(next_tick_ms - now) : 0;
+		const int count = epoll_wait(worker->epoll_fd, events, EPOLL_MAX_EVENTS, timeout_ms);
+
+		std::scoped_lock<std::recursive_mutex> lock(worker->mutex);
+
+		for (int i = 0; i < count; i++) {
+			Watch* watch = static_cast<Watch*>(events[i].data.ptr);
+
+			if (!watch) {
+				worker->wakeup.reset();
+
+			} else if (watch->client) {
+				watch->client->handle_events(watch->fd, events[i].events);
+			}
+		}
+
+		if (millis() >= next_tick_ms) {
+			// Index based, a tick may detach its own client
+			for (size_t i = 0; i < worker->clients.size(); i++) {
+				worker->clients[i]->tick();
+			}
+
+			next_tick_ms = millis() + TICK_INTERVAL_MS;
+		}
+
+		worker->retired.clear();
+	}
+
+	LOG("[EventLoop] Exiting worker thread");
+}
+
+} // end namespace mavlink
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <mavlink.h>
+
+#include <Checksum.hpp>
+
+namespace mavlink
+{
+
+// Number of bytes mavlink_msg_to_send_buffer() writes for 'message'
+inline uint16_t frame_length(const mavlink_message_t& message)
+{
+	if (message.magic == MAVLINK_STX_MAVLINK1) {
+		return MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1 + MAVLINK_NUM_CHECKSUM_BYTES + message.len;
+	}
+
+	uint16_t signature_len = (message.incompat_flags & MAVLINK_IFLAG_SIGNED) ? MAVLINK_SIGNATURE_BLOCK_LEN : 0;
+	return MAVLINK_NUM_NON_PAYLOAD_BYTES + _mav_trim_payload(_MAV_PAYLOAD(&message), message.len) + signature_len;
+}
+
+// Number of bytes encode_frame() writes for a payload struct of 'max_length' bytes
+inline uint16_t frame_length(const void* payload, uint8_t max_length)
+{
+	return MAVLINK_NUM_NON_PAYLOAD_BYTES + _mav_trim_payload(static_cast<const char*>(payload), max_length);
+}
+
+// Encodes a MAVLink 2 frame for a message struct straight into 'buffer', without going through a mavlink_message_t.
+// The generated message structs are packed in wire order, so the struct is the payload.
+inline uint16_t encode_frame(uint8_t* buffer, uint8_t sysid, uint8_t compid, uint8_t seq, uint32_t msgid,
+			     const void* payload, uint8_t max_length, uint8_t crc_extra)
+{
+	const uint8_t length = _mav_trim_payload(static_cast<const char*>(payload), max_length);
+
+	buffer[0] = MAVLINK_STX;
+	buffer[1] = length;
+	buffer[2] = 0; // incompat_flags
+	buffer[3] = 0; // compat_flags
+	buffer[4] = seq;
+	buffer[5] = sysid;
+	buffer[6] = compid;
+	buffer[7] = msgid & 0xFF;
+	buffer[8] = (msgid >> 8) & 0xFF;
+	buffer[9] = (msgid >> 16) & 0xFF;
+	memcpy(&buffer[MAVLINK_NUM_HEADER_BYTES], payload, length);
+
+	uint16_t checksum = crc16(&buffer[1], MAVLINK_CORE_HEADER_LEN + length);
+	checksum = crc16_accumulate(crc_extra, checksum);
+
+	buffer[MAVLINK_NUM_HEADER_BYTES + length] = checksum & 0xFF;
+	buffer[MAVLINK_NUM_HEADER_BYTES + length + 1] = checksum >> 8;
+
+	return MAVLINK_NUM_NON_PAYLOAD_BYTES + length;
+}
+
+} // end namespace mavlink
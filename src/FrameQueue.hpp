@@ -0,0 +1,289 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include <EventNotifier.hpp>
+
+namespace mavlink
+{
+
+// Wakes up the consumer of one or more queues. Producers only touch the eventfd while the consumer is about to wait,
+// and only the first one to see it waiting does.
+class ConsumerSignal
+{
+public:
+	// Producers, after publishing
+	void published()
+	{
+		// Pairs with the fence in begin_wait()
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (_waiting.load(std::memory_order_relaxed) && _waiting.exchange(false, std::memory_order_relaxed)) {
+			_notifier.notify();
+		}
+	};
+
+	// Consumer, check the queues for data after this and before blocking
+	void begin_wait()
+	{
+		_waiting.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	};
+
+	void end_wait()
+	{
+		_waiting.store(false, std::memory_order_relaxed);
+	};
+
+	bool wait(int timeout_ms) { return _notifier.wait(timeout_ms); };
+	void notify() { _notifier.notify(); };
+	void reset() { _notifier.reset(); };
+	int fd() const { return _notifier.fd(); };
+
+private:
+	std::atomic<bool> _waiting {};
+	EventNotifier _notifier {};
+};
+
+// Bounded lock-free byte ring holding variable length records, for many producers and a single consumer.
+// Producers reserve exactly the number of bytes a frame needs by advancing the head, write the frame in place and then
+// publish it by storing its length in the record header. The consumer peeks at published records without copying them
+// and releases them once they are on the wire. Released bytes are zeroed so that a header reads 0 until it is published.
+class FrameQueue
+{
+public:
+	struct Frame {
+		const uint8_t* data;
+		uint16_t length;
+	};
+
+	// Capacity is rounded up to the next power of two. Queues sharing a consumer can share its 'signal'.
+	FrameQueue(size_t capacity_bytes, ConsumerSignal* signal = nullptr)
+		: _own_signal(signal ? nullptr : std::make_unique<ConsumerSignal>())
+		, _signal(signal ? signal : _own_signal.get())
+	{
+		size_t size = MIN_CAPACITY;
+
+		while (size < capacity_bytes) {
+			size <<= 1;
+		}
+
+		_mask = size - 1;
+		_buffer = std::make_unique<uint64_t[]>(size / sizeof(uint64_t)); // zero initialized
+	};
+
+	// Non-copyable
+	FrameQueue(const FrameQueue&) = delete;
+	const FrameQueue& operator=(const FrameQueue&) = delete;
+
+	// Reserves 'length' bytes and calls 'write(uint8_t*)' to fill them in place. Safe to call from any thread.
+	// Returns false without calling 'write' if the queue is full. The stream position of the record goes to 'position'.
+	template<class F>
+	bool push(uint16_t length, F&& write, uint64_t* position = nullptr)
+	{
+		const size_t record_size = align(HEADER_SIZE + length);
+		uint64_t head = _head.load(std::memory_order_relaxed);
+		size_t padding;
+
+		for (;;) {
+			const uint64_t tail = _tail.load(std::memory_order_acquire);
+			const size_t contiguous = capacity() - (head & _mask);
+
+			// Records never wrap around the end of the buffer, the remainder is skipped with a padding record
+			padding = contiguous < record_size ? contiguous : 0;
+
+			if (head + padding + record_size - tail > capacity()) {
+				return false;
+			}
+
+			if (_head.compare_exchange_weak(head, head + padding + record_size, std::memory_order_relaxed)) {
+				break;
+			}
+		}
+
+		if (padding) {
+			header(head).store(PADDING_FLAG | uint32_t(padding), std::memory_order_release);
+			head += padding;
+		}
+
+		write(data(head));
+		header(head).store(length, std::memory_order_release);
+		_signal->published();
+
+		if (position) {
+			*position = head;
+		}
+
+		return true;
+	};
+
+	// Consumer only. Fills 'frames' with up to 'max' published frames, in order. The frame data stays valid until release().
+	size_t peek(Frame* frames, size_t max)
+	{
+		uint64_t position = _tail.load(std::memory_order_relaxed);
+		const uint64_t head = _head.load(std::memory_order_relaxed);
+		size_t count = 0;
+
+		// A full queue has the oldest record at the head, wrapped around
+		while (count < max && position != head) {
+			const uint32_t value = header(position).load(std::memory_order_acquire);
+
+			if (value == 0) {
+				break;
+			}
+
+			if (value & PADDING_FLAG) {
+				position += value & ~PADDING_FLAG;
+				continue;
+			}
+
+			frames[count++] = { data(position), uint16_t(value) };
+			position += align(HEADER_SIZE + value);
+		}
+
+		_peek_end = position;
+		return count;
+	};
+
+	// Consumer only. Frees everything returned by the last peek().
+	void release()
+	{
+		release_to(_peek_end);
+	};
+
+	// Consumer only. Frees the first 'count' frames returned by the last peek(), the rest stays queued.
+	void release(size_t count)
+	{
+		uint64_t position = _tail.load(std::memory_order_relaxed);
+
+		while (count) {
+			const uint32_t value = header(position).load(std::memory_order_relaxed);
+
+			if (value & PADDING_FLAG) {
+				position += value & ~PADDING_FLAG;
+				continue;
+			}
+
+			position += align(HEADER_SIZE + value);
+			count--;
+		}
+
+		release_to(position);
+	};
+
+	// Consumer only. Turns the frame pushed at 'position' into padding, so it is never sent. The frame must not be peeked.
+	// Returns false if it was released already.
+	bool skip(uint64_t position)
+	{
+		if (position < _tail.load(std::memory_order_relaxed)) {
+			return false;
+		}
+
+		const uint32_t value = header(position).load(std::memory_order_relaxed);
+		header(position).store(PADDING_FLAG | uint32_t(align(HEADER_SIZE + value)), std::memory_order_relaxed);
+		return true;
+	};
+
+	// Consumer only. Drops everything that is queued.
+	void clear()
+	{
+		Frame frame;
+
+		while (peek(&frame, 1)) {
+			release();
+		}
+	};
+
+	// Consumer only. Blocks until a frame is published, wake() is called or the timeout expires.
+	// Returns true if there is data. A negative timeout waits forever.
+	bool wait(int timeout_ms = -1)
+	{
+		_signal->begin_wait();
+
+		if (empty()) {
+			_signal->wait(timeout_ms);
+		}
+
+		_signal->end_wait();
+		return !empty();
+	};
+
+	// Wakes the consumer up if it is blocked in wait(). Safe to call from any thread.
+	void wake()
+	{
+		_signal->notify();
+	};
+
+	// Consumer only, for event loops watching fd(). Makes the next push signal fd().
+	// Returns false if frames were published before that, in which case the consumer has to flush again before waiting.
+	bool arm()
+	{
+		_signal->begin_wait();
+		return empty();
+	};
+
+	// Consumer only. Stops the signalling started by arm() and consumes pending signals, call before flushing.
+	void disarm()
+	{
+		_signal->end_wait();
+		_signal->reset();
+	};
+
+	bool empty()
+	{
+		return header(_tail.load(std::memory_order_relaxed)).load(std::memory_order_acquire) == 0;
+	};
+
+	size_t capacity() const { return _mask + 1; };
+
+	// Readable whenever the consumer should look at the queue again, for use with poll/epoll
+	int fd() const { return _signal->fd(); };
+
+private:
+	static constexpr size_t HEADER_SIZE = sizeof(uint64_t);
+	static constexpr size_t MIN_CAPACITY = 1024;
+	static constexpr uint32_t PADDING_FLAG = 1u << 31;
+	static constexpr size_t CACHE_LINE_SIZE = 64;
+
+	static size_t align(size_t size) { return (size + 7) & ~size_t(7); };
+
+	void release_to(uint64_t end)
+	{
+		uint64_t tail = _tail.load(std::memory_order_relaxed);
+
+		while (tail != end) {
+			const size_t offset = tail & _mask;
+			const size_t length = std::min<size_t>(end - tail, capacity() - offset);
+			memset(reinterpret_cast<uint8_t*>(_buffer.get()) + offset, 0, length);
+			tail += length;
+		}
+
+		_tail.store(tail, std::memory_order_release);
+	};
+
+	std::atomic_ref<uint32_t> header(uint64_t position)
+	{
+		return std::atomic_ref<uint32_t>(*reinterpret_cast<uint32_t*>(&_buffer[(position & _mask) / sizeof(uint64_t)]));
+	};
+
+	uint8_t* data(uint64_t position)
+	{
+		return reinterpret_cast<uint8_t*>(&_buffer[(position & _mask) / sizeof(uint64_t)]) + HEADER_SIZE;
+	};
+
+	std::unique_ptr<uint64_t[]> _buffer {};
+	size_t _mask {};
+
+	alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> _head {};
+	alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> _tail {};
+	uint64_t _peek_end {};
+
+	std::unique_ptr<ConsumerSignal> _own_signal {};
+	ConsumerSignal* _signal {};
+};
+
+} // end namespace mavlink
@@ -0,0 +1,331 @@
+#include <IoUring.hpp>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include <helpers.hpp>
+
+namespace mavlink
+{
+
+static unsigned round_up_pow2(unsigned value)
+{
+	unsigned size = 1;
+
+	while (size < value) {
+		size <<= 1;
+	}
+
+	return size;
+}
+
+IoUring::~IoUring()
+{
+	// Closing the ring cancels whatever is still posted
+	if (_fd >= 0) {
+		close(_fd);
+	}
+
+	if (_buf_ring) {
+		munmap(_buf_ring, _buf_ring_size);
+	}
+
+	if (_sqes) {
+		munmap(_sqes, _sqes_size);
+	}
+
+	if (_cq_ring && _cq_ring != _sq_ring) {
+		munmap(_cq_ring, _cq_ring_size);
+	}
+
+	if (_sq_ring) {
+		munmap(_sq_ring, _sq_ring_size);
+	}
+}
+
+bool IoUring::recvmsg_multishot_supported()
+{
+	IoUring ring;
+
+	if (!ring.init(2, 1, 64)) {
+		return false;
+	}
+
+	const int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+
+	if (fd < 0) {
+		return false;
+	}
+
+	// Nothing is sent to the socket, a supported receive stays posted until the ring is closed
+	const msghdr msg = {};
+	ring.recvmsg_multishot(fd, &msg, 0);
+	ring.submit_and_wait(0);
+
+	bool failed = false;
+	ring.for_each_completion([&failed](const io_uring_cqe & cqe) { failed |= cqe.res < 0; });
+
+	close(fd);
+	return !failed;
+}
+
+bool IoUring::init(unsigned entries, unsigned buffer_count, unsigned buffer_size)
+{
+	io_uring_params params = {};
+	_fd = int(syscall(__NR_io_uring_setup, round_up_pow2(entries), &params));
+
+	if (_fd < 0) {
+		LOG("io_uring_setup error: %s", strerror(errno));
+		return false;
+	}
+
+	// Timeouts are passed to io_uring_enter() directly, that needs Linux 5.11
+	if (!(params.features & IORING_FEAT_EXT_ARG)) {
+		LOG("io_uring lacks IORING_FEAT_EXT_ARG");
+		return false;
+	}
+
+	_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		_sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+	}
+
+	_sq_ring = mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+
+	if (_sq_ring == MAP_FAILED) {
+		_sq_ring = nullptr;
+		return false;
+	}
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		_cq_ring = _sq_ring;
+
+	} else {
+		_cq_ring = mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+
+		if (_cq_ring == MAP_FAILED) {
+			_cq_ring = nullptr;
+			return false;
+		}
+	}
+
+	_sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+	void* sqes = mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES);
+
+	if (sqes == MAP_FAILED) {
+		return false;
+	}
+
+	_sqes = static_cast<io_uring_sqe*>(sqes);
+
+	uint8_t* sq = static_cast<uint8_t*>(_sq_ring);
+	_sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+	_sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+	_sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+	_sq_entries = params.sq_entries;
+	_sq_pending_tail = *_sq_tail;
+
+	// Submission slots map 1:1 to SQEs, so the index array is filled in once
+	unsigned* sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+	for (unsigned i = 0; i < _sq_entries; i++) {
+		sq_array[i] = i;
+	}
+
+	uint8_t* cq = static_cast<uint8_t*>(_cq_ring);
+	_cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+	_cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+	_cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+	_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+	// Provided buffer ring, the kernel takes a buffer from it for every receive that completes
+	const unsigned count = round_up_pow2(buffer_count);
+	_buf_ring_size = count * sizeof(io_uring_buf);
+	void* ring = mmap(nullptr, _buf_ring_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+	if (ring == MAP_FAILED) {
+		return false;
+	}
+
+	_buf_ring = static_cast<io_uring_buf*>(ring);
+	_buf_mask = count - 1;
+	_buffer_size = buffer_size;
+	_buffers.resize(size_t(count) * buffer_size);
+
+	io_uring_buf_reg reg = {};
+	reg.ring_addr = reinterpret_cast<uint64_t>(_buf_ring);
+	reg.ring_entries = count;
+	reg.bgid = BUFFER_GROUP;
+
+	if (syscall(__NR_io_uring_register, _fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+		LOG("io_uring provided buffer ring error: %s", strerror(errno));
+		return false;
+	}
+
+	for (unsigned i = 0; i < count; i++) {
+		recycle_buffer(uint16_t(i));
+	}
+
+	return true;
+}
+
+io_uring_sqe* IoUring::get_sqe()
+{
+	// Hand the queued submissions to the kernel if the ring is full
+	if (_sq_pending_tail - __atomic_load_n(_sq_head, __ATOMIC_ACQUIRE) >= _sq_entries) {
+		submit_and_wait(0);
+	}
+
+	io_uring_sqe* sqe = &_sqes[_sq_pending_tail & _sq_mask];
+	_sq_pending_tail++;
+
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+void IoUring::recvmsg_multishot(int fd, const msghdr* msg, uint64_t user_data)
+{
+	io_uring_sqe* sqe = get_sqe();
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->fd = fd;
+	sqe->addr = reinterpret_cast<uint64_t>(msg);
+	sqe->len = 1;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = BUFFER_GROUP;
+	sqe->user_data = user_data;
+}
+
+void IoUring::read(int fd, uint64_t user_data)
+{
+	io_uring_sqe* sqe = get_sqe();
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = fd;
+	sqe->off = uint64_t(-1); // Current file position, ttys have none
+	sqe->len = _buffer_size;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = BUFFER_GROUP;
+	sqe->user_data = user_data;
+}
+
+void IoUring::poll_multishot(int fd, uint64_t user_data)
+{
+	io_uring_sqe* sqe = get_sqe();
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = fd;
+	sqe->poll32_events = POLLIN;
+	sqe->len = IORING_POLL_ADD_MULTI;
+	sqe->user_data = user_data;
+}
+
+void IoUring::sendmsg(int fd, const msghdr* msg, uint64_t user_data)
+{
+	io_uring_sqe* sqe = get_sqe();
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->fd = fd;
+	sqe->addr = reinterpret_cast<uint64_t>(msg);
+	sqe->len = 1;
+	sqe->user_data = user_data;
+}
+
+void IoUring::writev(int fd, const iovec* iov, unsigned count, uint64_t user_data)
+{
+	io_uring_sqe* sqe = get_sqe();
+	sqe->opcode = IORING_OP_WRITEV;
+	sqe->fd = fd;
+	sqe->off = uint64_t(-1);
+	sqe->addr = reinterpret_cast<uint64_t>(iov);
+	sqe->len = count;
+	sqe->user_data = user_data;
+}
+
+int IoUring::submit_and_wait(int timeout_ms)
+{
+	const unsigned to_submit = _sq_pending_tail - *_sq_tail;
+	__atomic_store_n(_sq_tail, _sq_pending_tail, __ATOMIC_RELEASE);
+
+	unsigned flags = 0;
+	__kernel_timespec timeout = {};
+	io_uring_getevents_arg arg = {};
+
+	if (timeout_ms != 0) {
+		// Completions that are already there return right away
+		flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+		timeout.tv_sec = timeout_ms / 1000;
+		timeout.tv_nsec = (timeout_ms % 1000) * 1000000;
+		arg.sigmask_sz = _NSIG / 8;
+		arg.ts = timeout_ms > 0 ? reinterpret_cast<uint64_t>(&timeout) : 0;
+
+	} else if (to_submit == 0) {
+		return 0;
+	}
+
+	_syscalls++;
+	const int result = int(syscall(__NR_io_uring_enter, _fd, to_submit, timeout_ms != 0 ? 1 : 0, flags, &arg, sizeof(arg)));
+
+	return result < 0 ? -errno : result;
+}
+
+void IoUring::recycle_buffer(uint16_t id)
+{
+	io_uring_buf& entry = _buf_ring[_buf_tail & _buf_mask];
+	entry.addr = reinterpret_cast<uint64_t>(buffer(id));
+	entry.len = _buffer_size;
+	entry.bid = id;
+
+	// The ring tail overlays the reserved field of the first entry
+	_buf_tail++;
+	std::atomic_ref<uint16_t>(_buf_ring[0].resv).store(_buf_tail, std::memory_order_release);
+}
+
+bool IoUring::buffer_id(const io_uring_cqe& cqe, uint16_t* id)
+{
+	if (!(cqe.flags & IORING_CQE_F_BUFFER)) {
+		return false;
+	}
+
+	*id = uint16_t(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+	return true;
+}
+
+const uint8_t* IoUring::recvmsg_payload(const io_uring_cqe& cqe, const msghdr& msg, void* name, size_t* length,
+		msghdr* control)
+{
+	uint16_t id;
+
+	if (cqe.res <= 0 || !buffer_id(cqe, &id)) {
+		return nullptr;
+	}
+
+	// The kernel lays the buffer out as io_uring_recvmsg_out, name, control and payload
+	const uint8_t* data = buffer(id);
+	const io_uring_recvmsg_out* out = reinterpret_cast<const io_uring_recvmsg_out*>(data);
+	const size_t header = sizeof(io_uring_recvmsg_out) + msg.msg_namelen + msg.msg_controllen;
+
+	if (size_t(cqe.res) < header) {
+		return nullptr;
+	}
+
+	if (name) {
+		memcpy(name, data + sizeof(io_uring_recvmsg_out), std::min<size_t>(out->namelen, msg.msg_namelen));
+	}
+
+	if (control) {
+		control->msg_control = const_cast<uint8_t*>(data) + sizeof(io_uring_recvmsg_out) + msg.msg_namelen;
+		control->msg_controllen = std::min<size_t>(out->controllen, msg.msg_controllen);
+	}
+
+	*length = std::min<size_t>(out->payloadlen, cqe.res - header);
+	return data + header;
+}
+
+} // end namespace mavlink
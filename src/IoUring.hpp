@@ -0,0 +1,116 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace mavlink
+{
+
+// Minimal io_uring wrapper on top of the raw syscalls, so the library does not depend on liburing.
+// Besides the submission and completion rings it registers a ring of provided buffers that the kernel picks receive
+// buffers from, so receives stay posted without handing the kernel a buffer per operation.
+// Not thread safe, a ring is owned by the thread of a single connection.
+class IoUring
+{
+public:
+	IoUring() = default;
+	~IoUring();
+
+	// Non-copyable
+	IoUring(const IoUring&) = delete;
+	const IoUring& operator=(const IoUring&) = delete;
+
+	// Returns false if the kernel lacks io_uring or provided buffer rings (Linux 5.19), the caller falls back to plain syscalls.
+	// 'entries' and 'buffer_count' are rounded up to powers of two.
+	bool init(unsigned entries, unsigned buffer_count, unsigned buffer_size);
+
+	// Multishot recvmsg needs Linux 6.0, older kernels with provided buffer rings fail it on submission.
+	// Tries one on a socket and ring of its own.
+	static bool recvmsg_multishot_supported();
+
+	// The operations below queue a submission, they are handed to the kernel by the next submit().
+	// Receives pick a provided buffer, the buffer ID is in the completion flags, see buffer_id().
+
+	// Multishot recvmsg, 'msg' only describes the name and control lengths and has to stay valid. See recvmsg_payload().
+	void recvmsg_multishot(int fd, const msghdr* msg, uint64_t user_data);
+	void read(int fd, uint64_t user_data);
+	void poll_multishot(int fd, uint64_t user_data);
+	void sendmsg(int fd, const msghdr* msg, uint64_t user_data);
+	void writev(int fd, const iovec* iov, unsigned count, uint64_t user_data);
+
+	// Submits what was queued and waits up to 'timeout_ms' for at least one completion. Returns the number submitted or -errno.
+	int submit_and_wait(int timeout_ms);
+
+	// Calls 'handle(const io_uring_cqe&)' for every pending completion. Returns the number handled.
+	template<class F>
+	unsigned for_each_completion(F&& handle)
+	{
+		unsigned head = *_cq_head;
+		const unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+		unsigned count = 0;
+
+		for (; head != tail; head++, count++) {
+			handle(_cqes[head & _cq_mask]);
+		}
+
+		__atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+		return count;
+	};
+
+	uint8_t* buffer(uint16_t id) { return &_buffers[size_t(id) * _buffer_size]; };
+
+	// Hands a buffer picked by a receive back to the kernel
+	void recycle_buffer(uint16_t id);
+
+	// Returns false if the completion did not pick a buffer
+	static bool buffer_id(const io_uring_cqe& cqe, uint16_t* id);
+
+	// Payload of a multishot recvmsg completion 'cqe' that used 'msg'. Copies the source address to 'name'.
+	// If 'control' is set it points at the control messages in the buffer, for CMSG_FIRSTHDR() and CMSG_NXTHDR().
+	const uint8_t* recvmsg_payload(const io_uring_cqe& cqe, const msghdr& msg, void* name, size_t* length,
+				       msghdr* control = nullptr);
+
+	// Number of io_uring_enter() calls so far
+	uint64_t syscalls() const { return _syscalls; };
+
+private:
+	static constexpr uint16_t BUFFER_GROUP = 0;
+
+	io_uring_sqe* get_sqe();
+
+	int _fd {-1};
+
+	void* _sq_ring {};
+	size_t _sq_ring_size {};
+	void* _cq_ring {};
+	size_t _cq_ring_size {};
+	io_uring_sqe* _sqes {};
+	size_t _sqes_size {};
+
+	unsigned* _sq_head {};
+	unsigned* _sq_tail {};
+	unsigned _sq_mask {};
+	unsigned _sq_entries {};
+	unsigned _sq_pending_tail {}; // Tail including the submissions not handed to the kernel yet
+
+	unsigned* _cq_head {};
+	unsigned* _cq_tail {};
+	unsigned _cq_mask {};
+	io_uring_cqe* _cqes {};
+
+	io_uring_buf* _buf_ring {};
+	size_t _buf_ring_size {};
+	unsigned _buf_mask {};
+	uint16_t _buf_tail {};
+	unsigned _buffer_size {};
+	std::vector<uint8_t> _buffers {};
+
+	uint64_t _syscalls {};
+};
+
+} // end namespace mavlink
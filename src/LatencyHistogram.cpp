@@ -0,0 +1,102 @@
+#include "LatencyHistogram.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+
+#include <helpers.hpp>
+
+namespace mavlink
+{
+
+LatencySnapshot LatencyHistogram::snapshot() const
+{
+	uint64_t counts[BUCKET_COUNT];
+	uint64_t count = 0;
+
+	for (size_t i = 0; i < BUCKET_COUNT; i++) {
+		counts[i] = _buckets[i].load(std::memory_order_relaxed);
+		count += counts[i];
+	}
+
+	LatencySnapshot snapshot = { .count = count };
+
+	if (!count) {
+		return snapshot;
+	}
+
+	const uint64_t max = _max_ns.load(std::memory_order_relaxed);
+	snapshot.mean_ns = _sum_ns.load(std::memory_order_relaxed) / count;
+	snapshot.max_ns = max;
+
+	struct Percentile {
+		double fraction;
+		uint64_t* value;
+	};
+
+	const Percentile percentiles[] = {
+		{ 0.5, &snapshot.p50_ns },
+		{ 0.9, &snapshot.p90_ns },
+		{ 0.99, &snapshot.p99_ns },
+		{ 0.999, &snapshot.p999_ns },
+	};
+
+	uint64_t seen = 0;
+	size_t next = 0;
+
+	for (size_t i = 0; i < BUCKET_COUNT && next < std::size(percentiles); i++) {
+		seen += counts[i];
+
+		while (next < std::size(percentiles) && double(seen) >= percentiles[next].fraction * double(count)) {
+			*percentiles[next].value = std::min(bucket_limit(i), max);
+			next++;
+		}
+	}
+
+	return snapshot;
+}
+
+LatencyHistograms LatencyRecorder::snapshot() const
+{
+	LatencyHistograms histograms = {
+		.receive = receive.snapshot(),
+		.outbox = outbox.snapshot()
+	};
+
+	for (const Slot& slot : _callbacks) {
+		const uint32_t key = slot.key.load(std::memory_order_acquire);
+
+		if (key) {
+			histograms.callbacks.push_back({ key - 1, slot.histogram.snapshot() });
+		}
+	}
+
+	std::sort(histograms.callbacks.begin(), histograms.callbacks.end(), [](const CallbackLatency & a, const CallbackLatency & b) {
+		return a.message_id < b.message_id;
+	});
+
+	return histograms;
+}
+
+static void log_latency(const char* name, const LatencySnapshot& snapshot)
+{
+	LOG("%-16s %10lu %10.1f %10.1f %10.1f %10.1f %10.1f", name, snapshot.count, double(snapshot.p50_ns) / 1e3,
+	    double(snapshot.p99_ns) / 1e3, double(snapshot.p999_ns) / 1e3, double(snapshot.max_ns) / 1e3,
+	    double(snapshot.mean_ns) / 1e3);
+}
+
+void LatencyRecorder::dump() const
+{
+	const LatencyHistograms histograms = snapshot();
+
+	LOG("%-16s %10s %10s %10s %10s %10s %10s", "latency", "count", "p50 us", "p99 us", "p99.9 us", "max us", "mean us");
+	log_latency("receive", histograms.receive);
+	log_latency("outbox", histograms.outbox);
+
+	for (const CallbackLatency& callbacks : histograms.callbacks) {
+		const std::string name = "callbacks " + std::to_string(callbacks.message_id);
+		log_latency(name.c_str(), callbacks.duration);
+	}
+}
+
+} // end namespace mavlink
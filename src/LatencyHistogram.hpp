@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+
+#include <Mavlink.hpp>
+
+namespace mavlink
+{
+
+static constexpr size_t LATENCY_SUB_BUCKET_BITS = 4; // 16 buckets per power of two, values are kept within 6.25%
+static constexpr size_t LATENCY_MAX_EXPONENT = 40;   // Values from 2^40 ns, about 18 minutes, go into the last bucket
+static constexpr size_t LATENCY_MESSAGE_SLOTS = 64;  // Distinct message IDs with a callback histogram, the rest are not timed
+
+inline uint64_t latency_clock_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Log-linear histogram of nanosecond values in the style of HdrHistogram. Fixed size, recording is a few instructions
+// and an atomic add, safe from any number of threads.
+class LatencyHistogram
+{
+public:
+	void record(uint64_t value_ns)
+	{
+		_buckets[bucket(value_ns)].fetch_add(1, std::memory_order_relaxed);
+		_sum_ns.fetch_add(value_ns, std::memory_order_relaxed);
+
+		uint64_t max = _max_ns.load(std::memory_order_relaxed);
+
+		while (value_ns > max && !_max_ns.compare_exchange_weak(max, value_ns, std::memory_order_relaxed)) {}
+	};
+
+	// Any thread, concurrent records may or may not be included
+	LatencySnapshot snapshot() const;
+
+private:
+	static constexpr size_t SUB_BUCKETS = size_t(1) << LATENCY_SUB_BUCKET_BITS;
+	static constexpr size_t BUCKET_COUNT = (LATENCY_MAX_EXPONENT - LATENCY_SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+	// Values below SUB_BUCKETS have a bucket each, above that each power of two is split into SUB_BUCKETS
+	static size_t bucket(uint64_t value)
+	{
+		if (value < SUB_BUCKETS) {
+			return value;
+		}
+
+		const size_t exponent = size_t(std::bit_width(value)) - 1 - LATENCY_SUB_BUCKET_BITS;
+		const size_t index = (exponent + 1) * SUB_BUCKETS + size_t(value >> exponent) - SUB_BUCKETS;
+		return index < BUCKET_COUNT ? index : BUCKET_COUNT - 1;
+	};
+
+	// Highest value that falls into 'index'
+	static uint64_t bucket_limit(size_t index)
+	{
+		if (index < SUB_BUCKETS) {
+			return index;
+		}
+
+		const size_t exponent = index / SUB_BUCKETS - 1;
+		return ((uint64_t(index % SUB_BUCKETS + SUB_BUCKETS) + 1) << exponent) - 1;
+	};
+
+	std::atomic<uint64_t> _buckets[BUCKET_COUNT] {};
+	std::atomic<uint64_t> _sum_ns {};
+	std::atomic<uint64_t> _max_ns {};
+};
+
+// The histograms of one Mavlink instance, allocated once if ConfigurationSettings::latency_histograms is set
+class LatencyRecorder
+{
+public:
+	LatencyHistogram receive {}; // From the receive timestamp of a frame until its callbacks start
+	LatencyHistogram outbox {};  // From queueing a frame until it is handed to the kernel
+
+	// Callback duration of 'message_id', claims a histogram for a new ID. nullptr once all are taken.
+	LatencyHistogram* callbacks(uint32_t message_id)
+	{
+		const uint32_t key = message_id + 1;
+		size_t index = (key * 2654435761u) % LATENCY_MESSAGE_SLOTS;
+
+		for (size_t i = 0; i < LATENCY_MESSAGE_SLOTS; i++, index = (index + 1) % LATENCY_MESSAGE_SLOTS) {
+			uint32_t current = _callbacks[index].key.load(std::memory_order_acquire);
+
+			// Dispatch threads may race for a free slot, the loser checks what the winner claimed it for
+			if (current == 0 && _callbacks[index].key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+				return &_callbacks[index].histogram;
+			}
+
+			if (current == key) {
+				return &_callbacks[index].histogram;
+			}
+		}
+
+		return nullptr;
+	};
+
+	LatencyHistograms snapshot() const;
+
+	// Logs one line per histogram
+	void dump() const;
+
+private:
+	struct Slot {
+		std::atomic<uint32_t> key {}; // Message ID plus one, 0 while free
+		LatencyHistogram histogram {};
+	};
+
+	Slot _callbacks[LATENCY_MESSAGE_SLOTS] {};
+};
+
+} // end namespace mavlink
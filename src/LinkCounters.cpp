@@ -0,0 +1,55 @@
+#include "LinkCounters.hpp"
+
+#include <algorithm>
+
+namespace mavlink
+{
+
+void LinkCounters::snapshot(LinkStatistics* statistics, uint64_t now_ms) const
+{
+	statistics->bytes_received = _bytes.load(std::memory_order_relaxed);
+	statistics->frames_received = _frames.load(std::memory_order_relaxed);
+	statistics->crc_errors = _crc_errors.load(std::memory_order_relaxed);
+	statistics->bytes_dropped = _bytes_dropped.load(std::memory_order_relaxed);
+
+	for (const MessageSlot& slot : _messages) {
+		const uint32_t key = slot.key.load(std::memory_order_acquire);
+
+		if (key == 0) {
+			continue;
+		}
+
+		// A window ends with the next message, one that is overdue by two windows stopped arriving
+		float rate_hz = slot.rate_hz.load(std::memory_order_relaxed);
+		const uint64_t last_window_ms = slot.last_window_ms.load(std::memory_order_relaxed);
+		const float window_ms = rate_hz > 0.f ? std::max(float(LINK_RATE_WINDOW_MS), 1000.f / rate_hz) : float(LINK_RATE_WINDOW_MS);
+
+		if (now_ms > last_window_ms && float(now_ms - last_window_ms) > 2.f * window_ms) {
+			rate_hz = 0.f;
+		}
+
+		statistics->messages.push_back({ key - 1, slot.received.load(std::memory_order_relaxed), rate_hz });
+	}
+
+	for (const SourceSlot& slot : _sources) {
+		const uint32_t key = slot.key.load(std::memory_order_acquire);
+
+		if (key == 0) {
+			continue;
+		}
+
+		const uint64_t lost = slot.lost.load(std::memory_order_relaxed);
+		statistics->sources.push_back({ uint8_t((key - 1) >> 8), uint8_t(key - 1), slot.received.load(std::memory_order_relaxed), lost });
+		statistics->lost += lost;
+	}
+
+	std::sort(statistics->messages.begin(), statistics->messages.end(), [](const MessageStatistics & a, const MessageStatistics & b) {
+		return a.message_id < b.message_id;
+	});
+
+	std::sort(statistics->sources.begin(), statistics->sources.end(), [](const SourceStatistics & a, const SourceStatistics & b) {
+		return a.sysid != b.sysid ? a.sysid < b.sysid : a.compid < b.compid;
+	});
+}
+
+} // end namespace mavlink
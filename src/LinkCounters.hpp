@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <mavlink.h>
+
+#include <Mavlink.hpp>
+#include <MessageParser.hpp>
+
+namespace mavlink
+{
+
+static constexpr size_t LINK_MESSAGE_SLOTS = 256; // Distinct message IDs counted, the rest only show up in the totals
+static constexpr size_t LINK_SOURCE_SLOTS = 64;   // Distinct sysid/compid pairs tracked for sequence gaps
+static constexpr uint64_t LINK_RATE_WINDOW_MS = 1000;
+static constexpr uint8_t LINK_REORDER_WINDOW = 32; // Frames a source may arrive behind its sequence and count as late
+
+// Receive side counters of a connection. Only the receiving thread writes, any thread reads a snapshot without locks.
+// Message IDs and sources live in fixed open addressed tables, a slot is claimed once and never freed.
+class LinkCounters
+{
+public:
+	// Receiving thread, after each parsed frame
+	void count(const mavlink_message_t& message, uint64_t now_ms)
+	{
+		add(_frames, 1);
+
+		if (MessageSlot* slot = find(_messages, LINK_MESSAGE_SLOTS, message.msgid + 1)) {
+			add(slot->received, 1);
+
+			// Rolls the window over on the first message after it ended, slow messages get longer windows
+			if (now_ms - slot->window_start_ms >= LINK_RATE_WINDOW_MS) {
+				if (slot->window_start_ms) {
+					const float rate_hz = float(slot->window_count) * 1000.f / float(now_ms - slot->window_start_ms);
+					slot->rate_hz.store(rate_hz, std::memory_order_relaxed);
+				}
+
+				slot->window_start_ms = now_ms;
+				slot->window_count = 0;
+				slot->last_window_ms.store(now_ms, std::memory_order_relaxed);
+			}
+
+			slot->window_count++;
+		}
+
+		const uint32_t source = (uint32_t(message.sysid) << 8 | message.compid) + 1;
+
+		if (SourceSlot* slot = find(_sources, LINK_SOURCE_SLOTS, source)) {
+			const uint8_t gap = uint8_t(message.seq - slot->next_seq);
+			const uint64_t lost = slot->lost.load(std::memory_order_relaxed);
+
+			// The first frame of a source has nothing to compare with
+			if (!slot->received.load(std::memory_order_relaxed)) {
+				slot->next_seq = message.seq + 1;
+
+			} else if (gap >= 256 - LINK_REORDER_WINDOW) {
+				// Just behind the expected sequence: a sender with priority classes put urgent frames ahead of this one,
+				// which was counted as lost when they arrived
+				if (lost) {
+					slot->lost.store(lost - 1, std::memory_order_relaxed);
+				}
+
+			} else {
+				// Anything further off is an outage, the sequence picks up from this frame
+				add(slot->lost, gap);
+				slot->next_seq = message.seq + 1;
+			}
+
+			add(slot->received, 1);
+		}
+	};
+
+	// Receiving thread, after parsing all frames of a read
+	void input(size_t length, const MessageParser::Counters& parser)
+	{
+		add(_bytes, length);
+		_crc_errors.store(parser.crc_errors, std::memory_order_relaxed);
+		_bytes_dropped.store(parser.bytes_dropped, std::memory_order_relaxed);
+	};
+
+	// Any thread. Fills the receive side of 'statistics'.
+	void snapshot(LinkStatistics* statistics, uint64_t now_ms) const;
+
+private:
+	struct Slot {
+		std::atomic<uint32_t> key {}; // Message ID or sysid << 8 | compid, plus one so that 0 is free
+	};
+
+	struct MessageSlot : Slot {
+		std::atomic<uint64_t> received {};
+		std::atomic<float> rate_hz {};
+		std::atomic<uint64_t> last_window_ms {};
+		uint64_t window_start_ms {};
+		uint64_t window_count {};
+	};
+
+	struct SourceSlot : Slot {
+		std::atomic<uint64_t> received {};
+		std::atomic<uint64_t> lost {};
+		uint8_t next_seq {};
+	};
+
+	// Single writer, a plain load and store instead of a locked add
+	static void add(std::atomic<uint64_t>& counter, uint64_t value)
+	{
+		counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	};
+
+	// Returns the slot of 'key', claims a free one for a new key. nullptr if the table is full.
+	template<class T>
+	static T* find(T* slots, size_t count, uint32_t key)
+	{
+		size_t index = (key * 2654435761u) % count;
+
+		for (size_t i = 0; i < count; i++, index = (index + 1) % count) {
+			const uint32_t current = slots[index].key.load(std::memory_order_relaxed);
+
+			if (current == key) {
+				return &slots[index];
+			}
+
+			if (current == 0) {
+				// Readers only look at the counters once they see the key
+				slots[index].key.store(key, std::memory_order_release);
+				return &slots[index];
+			}
+		}
+
+		return nullptr;
+	};
+
+	std::atomic<uint64_t> _bytes {};
+	std::atomic<uint64_t> _frames {};
+	std::atomic<uint64_t> _crc_errors {};
+	std::atomic<uint64_t> _bytes_dropped {};
+
+	MessageSlot _messages[LINK_MESSAGE_SLOTS] {};
+	SourceSlot _sources[LINK_SOURCE_SLOTS] {};
+};
+
+} // end namespace mavlink
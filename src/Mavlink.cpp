@@ -1,14 +1,96 @@
 #include <Mavlink.hpp>
 
+#include <DispatchExecutor.hpp>
+#include <LatencyHistogram.hpp>
+#include <MessageCache.hpp>
+#include <MessageDispatcher.hpp>
+#include <ParameterClient.hpp>
+#include <ParameterServer.hpp>
+#include <ReplayConnection.hpp>
+#include <StreamScheduler.hpp>
+#include <TlogRecorder.hpp>
 #include <UdpConnection.hpp>
 #include <SerialConnection.hpp>
 
 namespace mavlink
 {
 
+OutboxClass outbox_class(uint32_t message_id)
+{
+	switch (message_id) {
+	case MAVLINK_MSG_ID_COMMAND_ACK:
+	case MAVLINK_MSG_ID_COMMAND_LONG:
+	case MAVLINK_MSG_ID_COMMAND_INT:
+	case MAVLINK_MSG_ID_SET_MODE:
+	case MAVLINK_MSG_ID_MISSION_ACK:
+		return OutboxClass::Control;
+
+	case MAVLINK_MSG_ID_HEARTBEAT:
+		return OutboxClass::Heartbeat;
+
+	case MAVLINK_MSG_ID_PARAM_VALUE:
+	case MAVLINK_MSG_ID_PARAM_REQUEST_LIST:
+	case MAVLINK_MSG_ID_PARAM_REQUEST_READ:
+	case MAVLINK_MSG_ID_MISSION_ITEM_INT:
+	case MAVLINK_MSG_ID_LOG_ENTRY:
+	case MAVLINK_MSG_ID_LOG_DATA:
+	case MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL:
+	case MAVLINK_MSG_ID_ENCAPSULATED_DATA:
+		return OutboxClass::Bulk;
+
+	default:
+		return OutboxClass::Telemetry;
+	}
+}
+
 Mavlink::Mavlink(const ConfigurationSettings& settings)
 	: _settings(settings)
-{}
+	, _dispatcher(std::make_unique<MessageDispatcher>())
+{
+	if (_settings.latency_histograms) {
+		_latency = std::make_unique<LatencyRecorder>();
+		_dispatcher->set_latency(_latency.get());
+	}
+
+	if (_settings.dispatch_threads) {
+		size_t queue_size = _settings.dispatch_queue_size ? _settings.dispatch_queue_size : DEFAULT_DISPATCH_QUEUE_SIZE;
+		_executor = std::make_unique<DispatchExecutor>(_dispatcher.get(), _settings.dispatch_threads, queue_size,
+				_settings.dispatch_overflow_policy);
+	}
+
+	_scheduler = std::make_unique<StreamScheduler>(_settings.stream_budget_bytes_per_second,
+	[this](const mavlink_message_t& message, OutboxClass outbox_class) {
+		return can_send() && _connection->queue_message(message, outbox_class);
+	});
+
+	_parameter_client = std::make_unique<ParameterClient>(
+	[this](uint32_t message_id, const void* payload, uint8_t max_length, uint8_t crc_extra) {
+		return can_send() && _connection->queue_payload(_settings.sysid, _settings.compid, message_id, payload, max_length, crc_extra);
+	});
+
+	subscribe_to_message(MAVLINK_MSG_ID_PARAM_VALUE, [this](const mavlink_message_t& message) {
+		_parameter_client->handle_value(message);
+	});
+
+	if (!_settings.tlog_path.empty()) {
+		_recorder = std::make_unique<TlogRecorder>(_settings.tlog_path, _settings.tlog_rotate_bytes);
+	}
+
+	if (!_settings.cached_messages.empty()) {
+		_cache = std::make_unique<MessageCache>(_settings.cached_messages, _settings.message_cache_sources);
+	}
+
+	// Only send heartbeats while connected to an autopilot, or to announce ourselves to a known remote
+	if (_settings.emit_heartbeat) {
+		_scheduler->add_task(Connection::HEARTBEAT_INTERVAL_MS, [this]() {
+			if (can_send()) {
+				send_heartbeat();
+			}
+
+			return true;
+		});
+	}
+}
 
 Mavlink::~Mavlink()
 {
@@ -22,23 +104,73 @@ ConnectionResult Mavlink::start()
 
 		_connection = std::make_unique<SerialConnection>(this);
 
-	} else if (_settings.connection_url.find("udp:") != std::string::npos) {
+	} else if (_settings.connection_url.find("udp:") != std::string::npos ||
+	           _settings.connection_url.find("udpout:") != std::string::npos) {
 
 		_connection = std::make_unique<UdpConnection>(this);
 
+	} else if (_settings.connection_url.find("replay:") != std::string::npos) {
+
+		_connection = std::make_unique<ReplayConnection>(this);
+
 	} else {
 		LOG("Invalid connection string: %s\nNo connection started", _settings.connection_url.c_str());
 		return ConnectionResult::NotImplemented;
 	}
 
+	if (_latency) {
+		_connection->set_latency(_latency.get());
+		_latency_logged = false;
+	}
+
+	if (_recorder) {
+		if (!_recorder->start()) {
+			return ConnectionResult::FileError;
+		}
+
+		_connection->set_recorder(_recorder.get());
+	}
+
+	if (_executor) {
+		_executor->start();
+	}
+
+	_connection->set_scheduler(_scheduler.get());
+
 	// Spawns thread -- all connection handling happens in that thread context
-	return _connection->start();
+	ConnectionResult result = _connection->start();
+
+	if (result != ConnectionResult::Success) {
+		// A later start() starts them again, e.g. once a serial device shows up
+		if (_executor) _executor->stop();
+
+		if (_recorder) _recorder->stop();
+
+		return result;
+	}
+
+	_scheduler->start(!_connection->runs_scheduler());
+	return result;
 }
 
 void Mavlink::stop()
 {
+	_scheduler->stop();
+
 	// Waits for connection threads to join
 	if (_connection.get()) _connection->stop();
+
+	// Nothing is submitted once the connection threads are gone
+	if (_executor) _executor->stop();
+
+	// Written out and synced once nothing records any more
+	if (_recorder) _recorder->stop();
+
+	// Once per start(), the destructor stops again
+	if (_latency && _connection && !_latency_logged) {
+		_latency->dump();
+		_latency_logged = true;
+	}
 }
 
 bool Mavlink::connected()
@@ -46,73 +178,189 @@ bool Mavlink::connected()
 	return _connection.get() && _connection->connected();
 }
 
-void Mavlink::handle_message(const mavlink_message_t& message)
+bool Mavlink::can_send()
 {
-	std::scoped_lock<std::mutex> lock(_subscriptions_mutex);
+	return _connection.get() && _connection->can_send();
+}
 
-	if (_message_subscriptions.contains(message.msgid)) {
-		_message_subscriptions[message.msgid](message);
+void Mavlink::handle_message(const mavlink_message_t& message, uint64_t received_ns)
+{
+	// Cached before the callbacks run, a callback polling the cache sees the message it was called with
+	if (_cache) {
+		_cache->update(message, received_ns);
+	}
+
+	if (_executor) {
+		_executor->submit(message, received_ns);
+
+	} else {
+		_dispatcher->dispatch(message, received_ns);
 	}
 }
 
-void Mavlink::subscribe_to_message(uint16_t message_id, const MessageCallback& callback)
+std::vector<DispatchCounters> Mavlink::dispatch_counters() const
 {
-	std::scoped_lock<std::mutex> lock(_subscriptions_mutex);
+	return _executor ? _executor->counters() : std::vector<DispatchCounters> {};
+}
 
-	if (_message_subscriptions.find(message_id) == _message_subscriptions.end()) {
-		_message_subscriptions.emplace(message_id, callback);
+std::vector<OutboxCounters> Mavlink::outbox_counters() const
+{
+	return _connection ? _connection->outbox_counters() : std::vector<OutboxCounters> {};
+}
 
-	} else {
-		LOG(RED_TEXT "Mavlink::subscribe_to_message failed, callback already registered" NORMAL_TEXT);
+void Mavlink::set_stream_rate(uint32_t message_id, float rate_hz, uint8_t target_system, uint8_t target_component)
+{
+	_scheduler->set_rate(message_id, target_system, target_component, rate_hz);
+}
+
+std::vector<StreamCounters> Mavlink::stream_counters() const
+{
+	return _scheduler->counters();
+}
+
+TlogCounters Mavlink::tlog_counters() const
+{
+	return _recorder ? _recorder->counters() : TlogCounters {};
+}
+
+ReplayCounters Mavlink::replay_counters() const
+{
+	auto replay = dynamic_cast<ReplayConnection*>(_connection.get());
+	return replay ? replay->counters() : ReplayCounters {};
+}
+
+LatencyHistograms Mavlink::latency_histograms() const
+{
+	return _latency ? _latency->snapshot() : LatencyHistograms {};
+}
+
+bool Mavlink::latest_message(uint32_t message_id, uint8_t sysid, uint8_t compid, CachedMessage* cached) const
+{
+	return _cache && _cache->read(message_id, sysid, compid, &cached->message, &cached->received_ns, &cached->updates);
+}
+
+bool Mavlink::latest_decoded(uint32_t message_id, uint8_t sysid, uint8_t compid, DecodeFunction decode, void* decoded,
+			     uint64_t* received_ns) const
+{
+	// Only the header and payload are filled in, which is all the decoders read
+	mavlink_message_t message;
+	uint64_t timestamp_ns;
+	uint64_t updates;
+
+	if (!_cache || !_cache->read(message_id, sysid, compid, &message, &timestamp_ns, &updates)) {
+		return false;
 	}
+
+	decode(message, decoded);
+
+	if (received_ns) *received_ns = timestamp_ns;
+
+	return true;
 }
 
-void Mavlink::send_message(const mavlink_message_t& message)
+LinkStatistics Mavlink::statistics() const
+{
+	return _connection ? _connection->statistics() : LinkStatistics {};
+}
+
+SubscriptionHandle Mavlink::subscribe_to_message(uint32_t message_id, const MessageCallback& callback)
+{
+	return _dispatcher->subscribe(message_id, callback);
+}
+
+SubscriptionHandle Mavlink::subscribe_to_message(uint32_t message_id, const TimedMessageCallback& callback)
+{
+	return _dispatcher->subscribe(message_id, callback);
+}
+
+SubscriptionHandle Mavlink::subscribe_decoded(uint32_t message_id, DecodeFunction decode, DecodedCallback callback,
+		std::shared_ptr<void> context)
+{
+	return _dispatcher->subscribe(message_id, decode, callback, std::move(context));
+}
+
+bool Mavlink::unsubscribe(SubscriptionHandle handle)
+{
+	return _dispatcher->unsubscribe(handle);
+}
+
+bool Mavlink::ready_to_send()
 {
 	if (!_connection.get()) {
 		LOG("error connection is nullptr");
-		return;
+		return false;
 	}
 
-	if (_connection->connected()) {
-		if (!_connection->queue_message(message)) {
-			LOG(RED_TEXT "Queueing message failed! Message queue full" NORMAL_TEXT);
-		}
-
-	} else {
+	if (!_connection->can_send()) {
 		LOG("error connection is not connected");
+		return false;
+	}
+
+	return true;
+}
+
+// Messages dropped by a full outbox are counted, see outbox_counters()
+void Mavlink::send_message(const mavlink_message_t& message)
+{
+	send_message(message, outbox_class(message.msgid));
+}
+
+void Mavlink::send_message(const mavlink_message_t& message, OutboxClass outbox_class)
+{
+	if (_scheduler->publish(message, outbox_class)) {
+		return;
+	}
+
+	if (ready_to_send()) {
+		_connection->queue_message(message, outbox_class);
 	}
 }
 
+// Encodes the message struct straight into the outbox, skipping the intermediate mavlink_message_t
+bool Mavlink::send_payload(uint32_t message_id, const void* payload, uint8_t max_length, uint8_t crc_extra)
+{
+	return ready_to_send() && _connection->queue_payload(_settings.sysid, _settings.compid, message_id, payload, max_length, crc_extra);
+}
+
 void Mavlink::send_heartbeat()
 {
 	mavlink_heartbeat_t hb = {
 		.type = _settings.mav_type,
 		.autopilot = _settings.mav_autopilot,
-		.system_status = MAV_STATE_ACTIVE  // TODO: report failsafes like this? Or something?
+		.system_status = MAV_STATE_ACTIVE, // TODO: report failsafes like this? Or something?
+		.mavlink_version = 3 // Set by mavlink_msg_heartbeat_pack() otherwise
 	};
 
-	mavlink_message_t message;
-	mavlink_msg_heartbeat_encode(_settings.sysid, _settings.compid, &message, &hb);
-
-	send_message(message);
+	send_payload(MAVLINK_MSG_ID_HEARTBEAT, &hb, MAVLINK_MSG_ID_HEARTBEAT_LEN, MAVLINK_MSG_ID_HEARTBEAT_CRC);
 }
 
 void Mavlink::enable_parameters(std::function<std::vector<Parameter>(void)> request_list_cb,
 				std::function<bool(Parameter*)> set_cb)
 {
-	_mav_param_request_list_cb = std::move(request_list_cb);
-	_mav_param_set_cb = std::move(set_cb);
+	// The handlers and the scheduler task refer to the server through this
+	if (_parameter_server) {
+		LOG(RED_TEXT "Parameters are enabled already" NORMAL_TEXT);
+		return;
+	}
+
+	_parameter_server = std::make_unique<ParameterServer>(std::move(request_list_cb), std::move(set_cb),
+	[this](const Parameter & param) { return can_send() && send_param_value(param); }, _settings.param_values_per_second);
+
+	// The handlers wake the task. Subscribing takes the dispatcher lock, which hands _parameter_task on to the receiving thread.
+	_parameter_task = _scheduler->add_task(PARAM_STREAM_INTERVAL_MS, [this]() { return _parameter_server->run(); });
 
-	subscribe_to_message(MAVLINK_MSG_ID_PARAM_REQUEST_LIST, [this](const mavlink_message_t& message) { handle_param_request_list(message); });
-	subscribe_to_message(MAVLINK_MSG_ID_PARAM_SET, 			[this](const mavlink_message_t& message) { handle_param_set(message); });
+	subscribe<mavlink_param_request_list_t>([this](const mavlink_param_request_list_t& msg) { handle_param_request_list(msg); });
+	subscribe<mavlink_param_request_read_t>([this](const mavlink_param_request_read_t& msg) { handle_param_request_read(msg); });
+	subscribe<mavlink_param_set_t>([this](const mavlink_param_set_t& msg) { handle_param_set(msg); });
 }
 
-void Mavlink::handle_param_request_list(const mavlink_message_t& message)
+ParameterFetchResult Mavlink::fetch_parameters(uint8_t target_system, uint8_t target_component, uint32_t timeout_ms)
 {
-	mavlink_param_request_list_t msg;
-	mavlink_msg_param_request_list_decode(&message, &msg);
+	return _parameter_client->fetch(target_system, target_component, timeout_ms);
+}
 
+void Mavlink::handle_param_request_list(const mavlink_param_request_list_t& msg)
+{
 	bool for_us = msg.target_system == _settings.sysid && msg.target_component == _settings.compid;
 	bool for_system = msg.target_system == _settings.sysid && msg.target_component == 0;
 	bool broadcast = msg.target_system == 0 && msg.target_component == 0;
@@ -122,47 +370,37 @@ void Mavlink::handle_param_request_list(const mavlink_message_t& message)
 		return;
 	}
 
-	LOG(GREEN_TEXT "Sending parameters to GCS" NORMAL_TEXT);
+	// Streamed from the scheduler thread
+	_parameter_server->handle_request_list();
+	_scheduler->wake_task(_parameter_task);
+}
 
-	// Param request_list callback
-	std::vector<Parameter> mavlink_parameters = _mav_param_request_list_cb();
+void Mavlink::handle_param_request_read(const mavlink_param_request_read_t& msg)
+{
+	bool for_us = msg.target_system == _settings.sysid && msg.target_component == _settings.compid;
+	bool for_system = msg.target_system == _settings.sysid && msg.target_component == 0;
 
-	for (auto& p : mavlink_parameters) {
-		send_param_value(p);
+	if (!for_us && !for_system) {
+		return;
 	}
+
+	_parameter_server->handle_request_read(msg);
+	_scheduler->wake_task(_parameter_task);
 }
 
-void Mavlink::handle_param_set(const mavlink_message_t& message)
+void Mavlink::handle_param_set(const mavlink_param_set_t& msg)
 {
-	mavlink_param_set_t msg;
-	mavlink_msg_param_set_decode(&message, &msg);
-
 	bool for_us = msg.target_system == _settings.sysid && msg.target_component == _settings.compid;
 
 	if (!for_us) {
 		return;
 	}
 
-	size_t length = strlen(msg.param_id);
-
-	if (length > 16) {
-		length = 16;
-	}
-
-	Parameter param = {
-		.name = std::string(msg.param_id, length),
-		.float_value = msg.param_value,
-		.type = msg.param_type,
-	};
-	// Param set callback -- it will modify 'param' to set the index on success
-	bool success = _mav_param_set_cb(&param);
-
-	if (success) {
-		send_param_value(param);
-	}
+	_parameter_server->handle_set(msg);
+	_scheduler->wake_task(_parameter_task);
 }
 
-void Mavlink::send_param_value(const Parameter& param)
+bool Mavlink::send_param_value(const Parameter& param)
 {
 	mavlink_param_value_t pv = {
 		.param_value = param.float_value,
@@ -171,12 +409,10 @@ void Mavlink::send_param_value(const Parameter& param)
 		.param_type = param.type
 	};
 
-	snprintf(pv.param_id,  sizeof(pv.param_id), "%s", param.name.c_str());
-
-	mavlink_message_t message;
-	mavlink_msg_param_value_encode(_settings.sysid, _settings.compid, &message, &pv);
+	// Not null terminated if the name takes all 16 characters
+	memcpy(pv.param_id, param.name.data(), std::min(param.name.size(), sizeof(pv.param_id)));
 
-	send_message(message);
+	return send_payload(MAVLINK_MSG_ID_PARAM_VALUE, &pv, MAVLINK_MSG_ID_PARAM_VALUE_LEN, MAVLINK_MSG_ID_PARAM_VALUE_CRC);
 }
 
 void Mavlink::send_command_ack(const mavlink::MavlinkCommand& mav_cmd, MAV_RESULT result)
@@ -188,11 +424,8 @@ void Mavlink::send_command_ack(const mavlink::MavlinkCommand& mav_cmd, MAV_RESUL
 		.target_component = mav_cmd.source_component
 	};
 
-	mavlink_message_t message;
-	mavlink_msg_command_ack_encode(_settings.sysid, _settings.compid, &message, &ack);
-
 	LOG("sending command_ack: %u", result);
-	send_message(message);
+	send_payload(MAVLINK_MSG_ID_COMMAND_ACK, &ack, MAVLINK_MSG_ID_COMMAND_ACK_LEN, MAVLINK_MSG_ID_COMMAND_ACK_CRC);
 }
 
 void Mavlink::send_status_text(std::string&& text, MAV_SEVERITY severity)
@@ -203,11 +436,8 @@ void Mavlink::send_status_text(std::string&& text, MAV_SEVERITY severity)
 
 	snprintf(status.text, sizeof(status.text), "%s", text.c_str());
 
-	mavlink_message_t message;
-	mavlink_msg_statustext_encode(_settings.sysid, _settings.compid, &message, &status);
-
 	LOG("statustext: %s", text.c_str());
-	send_message(message);
+	send_payload(MAVLINK_MSG_ID_STATUSTEXT, &status, MAVLINK_MSG_ID_STATUSTEXT_LEN, MAVLINK_MSG_ID_STATUSTEXT_CRC);
 }
 
 } // end namespace mavlink
@@ -0,0 +1,151 @@
+#include "MessageCache.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <thread>
+
+#include <helpers.hpp>
+
+namespace mavlink
+{
+
+MessageCache::MessageCache(const std::vector<uint32_t>& message_ids, size_t sources_per_message)
+	: _message_ids(message_ids)
+{
+	std::sort(_message_ids.begin(), _message_ids.end());
+	_message_ids.erase(std::unique(_message_ids.begin(), _message_ids.end()), _message_ids.end());
+
+	const size_t sources = sources_per_message ? sources_per_message : DEFAULT_MESSAGE_CACHE_SOURCES;
+	const size_t region = std::bit_ceil(sources);
+
+	_slots = std::make_unique<Slot[]>(std::max<size_t>(_message_ids.size() * region, 1));
+	_mask = region - 1;
+}
+
+MessageCache::Slot* MessageCache::region(uint32_t message_id) const
+{
+	auto it = std::lower_bound(_message_ids.begin(), _message_ids.end(), message_id);
+
+	if (it == _message_ids.end() || *it != message_id) {
+		return nullptr;
+	}
+
+	return &_slots[size_t(it - _message_ids.begin()) * (_mask + 1)];
+}
+
+MessageCache::Slot* MessageCache::find(Slot* region, uint64_t key) const
+{
+	size_t index = (key * 0x9E3779B97F4A7C15ull >> 32) & _mask;
+
+	for (size_t i = 0; i <= _mask; i++, index = (index + 1) & _mask) {
+		const uint64_t current = region[index].key.load(std::memory_order_acquire);
+
+		if (current == key || current == 0) {
+			return &region[index];
+		}
+	}
+
+	return nullptr;
+}
+
+void MessageCache::update(const mavlink_message_t& message, uint64_t received_ns)
+{
+	Slot* slots = region(message.msgid);
+
+	if (!slots) {
+		return;
+	}
+
+	const uint64_t key = make_key(message.msgid, message.sysid, message.compid);
+	Slot* slot = find(slots, key);
+
+	if (!slot) {
+		if (!_full_logged) {
+			LOG(RED_TEXT "Message cache full for message %u, %u/%u is not cached" NORMAL_TEXT, message.msgid, message.sysid,
+			    message.compid);
+			_full_logged = true;
+		}
+
+		return;
+	}
+
+	const uint32_t sequence = slot->sequence.load(std::memory_order_relaxed);
+	slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	// The header and the payload. A trimmed payload is zero filled up to the longest the message gets, so that a shorter
+	// update does not leave the fields of an earlier one behind.
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&message);
+	const mavlink_msg_entry_t* entry = mavlink_get_msg_entry(message.msgid);
+	const size_t header = offsetof(mavlink_message_t, payload64);
+	const size_t length = header + message.len;
+	const size_t words = (header + std::max<size_t>(message.len, entry ? entry->max_msg_len : 0) + 7) / 8;
+
+	for (size_t i = 0; i < words; i++) {
+		uint64_t word = 0;
+
+		if (i * 8 < length) {
+			memcpy(&word, bytes + i * 8, std::min<size_t>(8, length - i * 8));
+		}
+
+		slot->words[i].store(word, std::memory_order_relaxed);
+	}
+
+	slot->length.store(uint32_t(words), std::memory_order_relaxed);
+	slot->received_ns.store(received_ns, std::memory_order_relaxed);
+	slot->updates.store(slot->updates.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	slot->sequence.store(sequence + 2, std::memory_order_release);
+
+	// A new slot becomes visible to readers with its first message in place
+	if (slot->key.load(std::memory_order_relaxed) == 0) {
+		slot->key.store(key, std::memory_order_release);
+	}
+}
+
+bool MessageCache::read(uint32_t message_id, uint8_t sysid, uint8_t compid, mavlink_message_t* message, uint64_t* received_ns,
+			uint64_t* updates) const
+{
+	const uint64_t key = make_key(message_id, sysid, compid);
+	Slot* slots = region(message_id);
+	const Slot* slot = slots ? find(slots, key) : nullptr;
+
+	if (!slot || slot->key.load(std::memory_order_acquire) != key) {
+		return false;
+	}
+
+	uint8_t* bytes = reinterpret_cast<uint8_t*>(message);
+
+	while (true) {
+		const uint32_t sequence = slot->sequence.load(std::memory_order_acquire);
+
+		// The writer is in the middle of an update, it never waits on anything so this is short
+		if (sequence & 1) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Covers every field of the message, the checksum and signature after the payload are left as they were.
+		// A torn copy is overwritten by the next attempt.
+		const size_t length = std::min<size_t>(slot->length.load(std::memory_order_relaxed) * 8, sizeof(mavlink_message_t));
+
+		for (size_t i = 0; i * 8 < length; i++) {
+			const uint64_t word = slot->words[i].load(std::memory_order_relaxed);
+			memcpy(bytes + i * 8, &word, std::min<size_t>(8, length - i * 8));
+		}
+
+		*received_ns = slot->received_ns.load(std::memory_order_relaxed);
+		*updates = slot->updates.load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if (slot->sequence.load(std::memory_order_relaxed) == sequence) {
+			break;
+		}
+	}
+
+	return true;
+}
+
+} // end namespace mavlink
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <mavlink.h>
+
+#include <Mavlink.hpp>
+
+namespace mavlink
+{
+
+static constexpr size_t DEFAULT_MESSAGE_CACHE_SOURCES = 16;
+
+// Newest message per (sysid, compid, message ID) for the IDs in ConfigurationSettings::cached_messages.
+// The receiving thread is the only writer and never waits. Readers on any thread copy a slot under a seqlock and retry
+// if the writer changed it in the meantime. Each message ID has a fixed open addressed region of slots, claimed once and
+// never freed, so that sources of one ID cannot take the slots of another.
+class MessageCache
+{
+public:
+	MessageCache(const std::vector<uint32_t>& message_ids, size_t sources_per_message);
+
+	// Receiving thread, for every message handled
+	void update(const mavlink_message_t& message, uint64_t received_ns);
+
+	// Any thread. False if nothing was received yet or the message ID is not cached.
+	bool read(uint32_t message_id, uint8_t sysid, uint8_t compid, mavlink_message_t* message, uint64_t* received_ns,
+		  uint64_t* updates) const;
+
+	// Non-copyable
+	MessageCache(const MessageCache&) = delete;
+	const MessageCache& operator=(const MessageCache&) = delete;
+
+private:
+	// The message is stored as words so that readers racing the writer copy it without a data race
+	static constexpr size_t MESSAGE_WORDS = (sizeof(mavlink_message_t) + 7) / 8;
+
+	struct alignas(64) Slot {
+		std::atomic<uint64_t> key {};      // msgid << 16 | sysid << 8 | compid, plus one so that 0 is free
+		std::atomic<uint32_t> sequence {}; // Odd while the writer is in the middle of an update
+		std::atomic<uint32_t> length {};   // Words in use, readers copy no more
+		std::atomic<uint64_t> received_ns {};
+		std::atomic<uint64_t> updates {};
+		std::atomic<uint64_t> words[MESSAGE_WORDS] {};
+	};
+
+	static uint64_t make_key(uint32_t message_id, uint8_t sysid, uint8_t compid)
+	{
+		return (uint64_t(message_id) << 16 | uint64_t(sysid) << 8 | compid) + 1;
+	};
+
+	// First slot of the region of 'message_id', nullptr if the ID is not cached
+	Slot* region(uint32_t message_id) const;
+
+	// Slot of 'key' in 'region', or the free slot it goes into. nullptr if the region is full.
+	Slot* find(Slot* region, uint64_t key) const;
+
+	std::vector<uint32_t> _message_ids {}; // Sorted
+	std::unique_ptr<Slot[]> _slots {};
+	size_t _mask {}; // Of the slots in a region
+	bool _full_logged {};
+};
+
+} // end namespace mavlink
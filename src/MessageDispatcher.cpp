@@ -0,0 +1,201 @@
+#include <MessageDispatcher.hpp>
+
+namespace mavlink
+{
+
+MessageDispatcher::MessageDispatcher()
+	: _table(std::make_shared<const Table>())
+	, _threads(std::make_shared<ThreadSlots>())
+{}
+
+SubscriptionHandle MessageDispatcher::subscribe(uint32_t message_id, MessageCallback callback)
+{
+	std::scoped_lock<std::mutex> lock(_mutex);
+
+	auto table = std::make_shared<Table>(*_table);
+	SubscriptionHandle handle = _next_handle++;
+
+	table->entries[message_id].subscribers.push_back({ handle, std::move(callback), {} });
+	publish(std::move(table));
+
+	return handle;
+}
+
+SubscriptionHandle MessageDispatcher::subscribe(uint32_t message_id, TimedMessageCallback callback)
+{
+	std::scoped_lock<std::mutex> lock(_mutex);
+
+	auto table = std::make_shared<Table>(*_table);
+	SubscriptionHandle handle = _next_handle++;
+
+	table->entries[message_id].subscribers.push_back({ handle, {}, std::move(callback) });
+	publish(std::move(table));
+
+	return handle;
+}
+
+SubscriptionHandle MessageDispatcher::subscribe(uint32_t message_id, DecodeFunction decode, DecodedCallback callback,
+		std::shared_ptr<void> context)
+{
+	std::scoped_lock<std::mutex> lock(_mutex);
+
+	auto table = std::make_shared<Table>(*_table);
+	SubscriptionHandle handle = _next_handle++;
+
+	Entry& entry = table->entries[message_id];
+	entry.decode = decode;
+	entry.decoded_subscribers.push_back({ handle, callback, std::move(context) });
+	publish(std::move(table));
+
+	return handle;
+}
+
+bool MessageDispatcher::unsubscribe(SubscriptionHandle handle)
+{
+	std::scoped_lock<std::mutex> lock(_mutex);
+
+	auto table = std::make_shared<Table>(*_table);
+
+	auto matches = [handle](const auto& subscriber) { return subscriber.handle == handle; };
+
+	for (auto it = table->entries.begin(); it != table->entries.end(); it++) {
+		Entry& entry = it->second;
+
+		if (!std::erase_if(entry.subscribers, matches) && !std::erase_if(entry.decoded_subscribers, matches)) {
+			continue;
+		}
+
+		if (entry.subscribers.empty() && entry.decoded_subscribers.empty()) {
+			table->entries.erase(it);
+		}
+
+		publish(std::move(table));
+		return true;
+	}
+
+	return false;
+}
+
+void MessageDispatcher::publish(std::shared_ptr<Table> table)
+{
+	table->version = _version + 1;
+	_table = std::move(table);
+	_version.store(_table->version, std::memory_order_release);
+}
+
+MessageDispatcher::ThreadSlot* MessageDispatcher::thread_slot()
+{
+	const std::thread::id id = std::this_thread::get_id();
+	size_t index = std::hash<std::thread::id> {}(id) % DISPATCH_THREAD_SLOTS;
+
+	for (size_t i = 0; i < DISPATCH_THREAD_SLOTS; i++, index = (index + 1) % DISPATCH_THREAD_SLOTS) {
+		std::thread::id owner = _threads->slots[index].owner.load(std::memory_order_relaxed);
+
+		if (owner == id) {
+			return &_threads->slots[index];
+		}
+
+		// Only the thread itself claims a slot for its id, so a lost race means another thread took this one
+		if (owner == std::thread::id() && _threads->slots[index].owner.compare_exchange_strong(owner, id, std::memory_order_acquire)) {
+			release_on_exit(_threads, &_threads->slots[index]);
+			return &_threads->slots[index];
+		}
+	}
+
+	return nullptr;
+}
+
+void MessageDispatcher::release_on_exit(const std::shared_ptr<ThreadSlots>& slots, ThreadSlot* slot)
+{
+	struct ClaimedSlots {
+		std::vector<std::pair<std::weak_ptr<ThreadSlots>, ThreadSlot*>> slots {};
+
+		~ClaimedSlots()
+		{
+			for (auto& [weak, slot] : slots) {
+				// Nothing to give back to a dispatcher that is gone
+				if (auto alive = weak.lock()) {
+					slot->table.reset();
+					slot->owner.store(std::thread::id(), std::memory_order_release);
+				}
+			}
+		};
+	};
+
+	thread_local ClaimedSlots claimed;
+
+	std::erase_if(claimed.slots, [](const auto& claim) { return claim.first.expired(); });
+	claimed.slots.push_back({ slots, slot });
+}
+
+const MessageDispatcher::Table& MessageDispatcher::snapshot(ThreadSlot& slot)
+{
+	// A callback that dispatches again keeps using the table the outer dispatch is iterating over
+	if (!slot.table || (slot.depth == 0 && slot.table->version != _version.load(std::memory_order_acquire))) {
+		std::scoped_lock<std::mutex> lock(_mutex);
+		slot.table = _table;
+	}
+
+	return *slot.table;
+}
+
+void MessageDispatcher::dispatch(const mavlink_message_t& message, uint64_t received_ns)
+{
+	const uint64_t start_ns = _latency ? latency_clock_ns() : 0;
+
+	if (_latency && received_ns) {
+		_latency->receive.record(start_ns - received_ns);
+	}
+
+	ThreadSlot* slot = thread_slot();
+	std::shared_ptr<const Table> locked_table;
+
+	if (!slot) {
+		std::scoped_lock<std::mutex> lock(_mutex);
+		locked_table = _table;
+	}
+
+	const Table& table = slot ? snapshot(*slot) : *locked_table;
+	auto it = table.entries.find(message.msgid);
+
+	if (it == table.entries.end()) {
+		return;
+	}
+
+	const Entry& entry = it->second;
+
+	if (slot) {
+		slot->depth++;
+	}
+
+	for (const Subscriber& subscriber : entry.subscribers) {
+		if (subscriber.callback) {
+			subscriber.callback(message);
+
+		} else {
+			subscriber.timed_callback(message, received_ns);
+		}
+	}
+
+	if (!entry.decoded_subscribers.empty()) {
+		// Decoded structs are packed and never larger than the maximum payload
+		alignas(8) uint8_t decoded[MAVLINK_MAX_PAYLOAD_LEN];
+		entry.decode(message, decoded);
+
+		for (const DecodedSubscriber& subscriber : entry.decoded_subscribers) {
+			subscriber.callback(subscriber.context.get(), decoded, received_ns);
+		}
+	}
+
+	if (slot) {
+		slot->depth--;
+	}
+
+	if (_latency) {
+		if (LatencyHistogram* histogram = _latency->callbacks(message.msgid)) {
+			histogram->record(latency_clock_ns() - start_ns);
+		}
+	}
+}
+
+} // end namespace mavlink
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <LatencyHistogram.hpp>
+#include <Mavlink.hpp>
+
+namespace mavlink
+{
+
+static constexpr size_t DISPATCH_THREAD_SLOTS = 64; // Threads keeping their own table reference, more lock on each dispatch
+
+// Message ID --> subscriber callbacks.
+// The table is copy-on-write: subscribe/unsubscribe build a new immutable table and bump the version. Each dispatching
+// thread keeps its own reference to the table it last used and only takes the mutex to pick up a new one after a change,
+// so the receive path does not lock in steady state and callbacks never run with the mutex held. The references live
+// in slots of the dispatcher, claimed by a thread on its first dispatch and handed back with the reference dropped when
+// the thread exits.
+class MessageDispatcher
+{
+public:
+	MessageDispatcher();
+
+	SubscriptionHandle subscribe(uint32_t message_id, MessageCallback callback);
+	SubscriptionHandle subscribe(uint32_t message_id, TimedMessageCallback callback);
+
+	// Typed subscription. All typed subscribers of a message share a single decode per received message.
+	SubscriptionHandle subscribe(uint32_t message_id, DecodeFunction decode, DecodedCallback callback, std::shared_ptr<void> context);
+
+	// A dispatch that already started on another thread may still call the callback once after this returns
+	bool unsubscribe(SubscriptionHandle handle);
+
+	// Raw subscribers are called first, then typed subscribers, each in subscription order.
+	// 'received_ns' is the latency_clock_ns() time the message was received, 0 if unknown.
+	void dispatch(const mavlink_message_t& message, uint64_t received_ns = 0);
+
+	// Times the callbacks from now on. Set before messages arrive.
+	void set_latency(LatencyRecorder* latency) { _latency = latency; };
+
+private:
+	// One of the two callbacks is set
+	struct Subscriber {
+		SubscriptionHandle handle;
+		MessageCallback callback;
+		TimedMessageCallback timed_callback;
+	};
+
+	struct DecodedSubscriber {
+		SubscriptionHandle handle;
+		DecodedCallback callback;
+		std::shared_ptr<void> context;
+	};
+
+	struct Entry {
+		std::vector<Subscriber> subscribers {};
+		DecodeFunction decode {};
+		std::vector<DecodedSubscriber> decoded_subscribers {};
+	};
+
+	struct Table {
+		uint64_t version {};
+		std::unordered_map<uint32_t, Entry> entries {};
+	};
+
+	struct alignas(64) ThreadSlot {
+		std::atomic<std::thread::id> owner {};
+		std::shared_ptr<const Table> table {}; // Only used by the owning thread
+		unsigned depth {};                     // Nesting level of dispatch() on the owning thread
+	};
+
+	struct ThreadSlots {
+		ThreadSlot slots[DISPATCH_THREAD_SLOTS] {};
+	};
+
+	// Must be called with _mutex held
+	void publish(std::shared_ptr<Table> table);
+
+	// Slot of the calling thread, claimed on its first dispatch. nullptr if all are taken.
+	ThreadSlot* thread_slot();
+
+	// Hands 'slot' back once the calling thread exits
+	static void release_on_exit(const std::shared_ptr<ThreadSlots>& slots, ThreadSlot* slot);
+
+	const Table& snapshot(ThreadSlot& slot);
+
+	// Serializes writers and guards _table. Never held while callbacks run.
+	std::mutex _mutex {};
+	std::shared_ptr<const Table> _table {};
+	std::atomic<uint64_t> _version {};
+
+	SubscriptionHandle _next_handle {1};
+
+	LatencyRecorder* _latency {};
+
+	// Shared with the threads holding a slot, so that one exiting while the dispatcher goes away finds them still there
+	std::shared_ptr<ThreadSlots> _threads {};
+};
+
+} // end namespace mavlink
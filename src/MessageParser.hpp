@@ -1,39 +1,309 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
 #include <mavlink.h>
 
+#include <Checksum.hpp>
+
+// Frame parser owned by each connection.
+// Instead of running every byte through the mavlink_parse_char state machine it looks for the next start marker,
+// checks the length and CRC over the whole frame in one pass and copies the payload as a single block.
+// A frame that is cut off at the end of the input is kept and completed by the next call to set_input().
 class MessageParser
 {
 public:
-	MessageParser(char* datagram, ssize_t length)
-		: _datagram(datagram)
-		, _length(length)
-	{}
-
-	// Parses a single mavlink message from the data buffer.
-	// Note that one datagram can contain multiple mavlink messages.
-	// It is OK if a message is fragmented because mavlink_parse_char places bytes into an internal buffer.
+	// Running totals, the 16 bit counters in mavlink_status_t wrap too quickly on busy links
+	struct Counters {
+		uint64_t frames {};
+		uint64_t crc_errors {};
+		uint64_t bytes_dropped {}; // Bytes skipped while searching for a start marker
+	};
+
+	// Sets the data to parse next. Note that one datagram can contain multiple mavlink messages.
+	void set_input(const char* data, size_t length)
+	{
+		_input = reinterpret_cast<const uint8_t*>(data);
+		_length = length;
+		_input_start = _input;
+		_input_start_position = _stream_length;
+		_stream_length += length;
+	}
+
+	// Parses a single mavlink message from the input, returns false once no complete message is left.
 	bool parse(mavlink_message_t* message)
 	{
-		for (unsigned i = 0; i < _length; ++i) {
+		if (_partial_consumed) {
+			drop_partial_frame();
+		}
+
+		for (;;) {
+			if (_partial_len) {
+				if (!complete_partial()) {
+					if (_partial_len) {
+						// Input exhausted, the rest of the frame is in the next chunk
+						return false;
+					}
+
+					// Nothing usable was left in the partial frame
+					continue;
+				}
+
+				if (decode(_partial, _partial_frame_len, message)) {
+					_frame_position = _partial_position;
+					_frame = _partial;
+					_frame_len = _partial_frame_len;
+
+					// Stays readable through frame() until the next call
+					_partial_consumed = true;
+					return true;
+				}
+
+				resync_partial();
+				continue;
+			}
+
+			const uint8_t* start = find_start(_input, _length);
+			const size_t skipped = start - _input;
+			_counters.bytes_dropped += skipped;
+			_input = start;
+			_length -= skipped;
+
+			if (_length == 0) {
+				return false;
+			}
+
+			const size_t frame_len = frame_length(_input, _length);
+
+			if (frame_len == 0) {
+				// Invalid header, skip the start marker
+				_input++;
+				_length--;
+				_counters.bytes_dropped++;
+				continue;
+			}
 
-			// TODO: convenience function for reporting parser statistics
-			mavlink_status_t status;
+			if (frame_len > _length) {
+				// Keep the beginning of the frame for the next call
+				memcpy(_partial, _input, _length);
+				_partial_len = _length;
+				_partial_position = position(_input);
+				_input += _length;
+				_length = 0;
+				return false;
+			}
 
-			if (mavlink_parse_char(0, _datagram[i], message, &status)) {
-				// Move the pointer to the data forward by the amount parsed.
-				_datagram += (i + 1);
-				// And decrease the length, so we don't overshoot in the next round.
-				_length -= (i + 1);
-				// We have parsed one message, let's return so it can be handled.
+			if (decode(_input, frame_len, message)) {
+				_frame_position = position(_input);
+				_frame = _input;
+				_frame_len = frame_len;
+				_input += frame_len;
+				_length -= frame_len;
 				return true;
 			}
-		}
 
-		// No more messages.
-		return false;
+			_input++;
+			_length--;
+		}
 	}
+
+	const mavlink_status_t& status() const { return _status; }
+	const Counters& counters() const { return _counters; }
+
+	// Offset of the first byte of the frame returned by the last parse(), counting every byte passed to set_input().
+	// Lets a caller that timestamps its reads tell when a frame started to arrive.
+	uint64_t frame_position() const { return _frame_position; }
+
+	// Wire bytes of the frame returned by the last parse(), valid until the next call to parse() or set_input()
+	const uint8_t* frame() const { return _frame; }
+	size_t frame_size() const { return _frame_len; }
+
 private:
-	char* _datagram {};
-	ssize_t _length {};
-};
\ No newline at end of file
+	static constexpr size_t MAVLINK1_HEADER_LEN = MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1;
+
+	uint64_t position(const uint8_t* input) const { return _input_start_position + (input - _input_start); }
+
+	static bool is_start(uint8_t c) { return c == MAVLINK_STX || c == MAVLINK_STX_MAVLINK1; }
+
+	static const uint8_t* find_start(const uint8_t* data, size_t length)
+	{
+		return mavlink::find_start_marker(data, length);
+	}
+
+	static size_t header_length(uint8_t magic)
+	{
+		return magic == MAVLINK_STX ? MAVLINK_NUM_HEADER_BYTES : MAVLINK1_HEADER_LEN;
+	}
+
+	// Returns the total frame length once the header is available, SIZE_MAX while it is incomplete and 0 if the header is invalid
+	static size_t frame_length(const uint8_t* frame, size_t available)
+	{
+		if (available < header_length(frame[0])) {
+			return SIZE_MAX;
+		}
+
+		if (frame[0] == MAVLINK_STX_MAVLINK1) {
+			return MAVLINK1_HEADER_LEN + frame[1] + MAVLINK_NUM_CHECKSUM_BYTES;
+		}
+
+		const uint8_t incompat_flags = frame[2];
+
+		if (incompat_flags & ~MAVLINK_IFLAG_SIGNED) {
+			return 0;
+		}
+
+		const size_t signature_len = (incompat_flags & MAVLINK_IFLAG_SIGNED) ? MAVLINK_SIGNATURE_BLOCK_LEN : 0;
+		return MAVLINK_NUM_NON_PAYLOAD_BYTES + frame[1] + signature_len;
+	}
+
+	// Validates the CRC of a complete frame and fills 'message'
+	bool decode(const uint8_t* frame, size_t frame_len, mavlink_message_t* message)
+	{
+		const bool mavlink1 = frame[0] == MAVLINK_STX_MAVLINK1;
+		const size_t header_len = header_length(frame[0]);
+		const uint8_t payload_len = frame[1];
+		const uint32_t msgid = mavlink1 ? frame[5] : frame[7] | (frame[8] << 8) | (uint32_t(frame[9]) << 16);
+
+		const mavlink_msg_entry_t* entry = mavlink_get_msg_entry(msgid);
+
+		uint16_t checksum = mavlink::crc16(&frame[1], header_len - 1 + payload_len);
+		checksum = mavlink::crc16_accumulate(entry ? entry->crc_extra : 0, checksum);
+
+		const uint8_t* ck = &frame[header_len + payload_len];
+
+		if (ck[0] != (checksum & 0xFF) || ck[1] != (checksum >> 8)) {
+			_counters.crc_errors++;
+			_status.parse_error++;
+			_status.packet_rx_drop_count++;
+			return false;
+		}
+
+		message->checksum = checksum;
+		message->magic = frame[0];
+		message->len = payload_len;
+		message->msgid = msgid;
+
+		if (mavlink1) {
+			message->incompat_flags = 0;
+			message->compat_flags = 0;
+			message->seq = frame[2];
+			message->sysid = frame[3];
+			message->compid = frame[4];
+
+		} else {
+			message->incompat_flags = frame[2];
+			message->compat_flags = frame[3];
+			message->seq = frame[4];
+			message->sysid = frame[5];
+			message->compid = frame[6];
+		}
+
+		char* payload = _MAV_PAYLOAD_NON_CONST(message);
+		memcpy(payload, &frame[header_len], payload_len);
+
+		// Zero the bytes truncated by the sender, decoders rely on that
+		if (entry && payload_len < entry->max_msg_len) {
+			memset(&payload[payload_len], 0, entry->max_msg_len - payload_len);
+		}
+
+		message->ck[0] = ck[0];
+		message->ck[1] = ck[1];
+
+		if (message->incompat_flags & MAVLINK_IFLAG_SIGNED) {
+			memcpy(message->signature, &ck[MAVLINK_NUM_CHECKSUM_BYTES], MAVLINK_SIGNATURE_BLOCK_LEN);
+		}
+
+		_counters.frames++;
+		_status.packet_rx_success_count++;
+		_status.current_rx_seq = message->seq;
+		_status.msg_received = MAVLINK_FRAMING_OK;
+
+		return true;
+	}
+
+	// Appends input to the partial frame until it is complete. Returns false if the input runs out first.
+	bool complete_partial()
+	{
+		for (;;) {
+			const size_t frame_len = frame_length(_partial, _partial_len);
+
+			if (frame_len == 0) {
+				resync_partial();
+
+				if (_partial_len == 0) {
+					return false;
+				}
+
+				continue;
+			}
+
+			const size_t wanted = frame_len == SIZE_MAX ? header_length(_partial[0]) : frame_len;
+
+			if (_partial_len < wanted) {
+				const size_t take = std::min(wanted - _partial_len, _length);
+
+				memcpy(&_partial[_partial_len], _input, take);
+				_partial_len += take;
+				_input += take;
+				_length -= take;
+
+				if (_partial_len < wanted) {
+					return false;
+				}
+			}
+
+			if (frame_len != SIZE_MAX) {
+				_partial_frame_len = frame_len;
+				return true;
+			}
+		}
+	}
+
+	// Drops the partial frame returned by the last parse() and keeps what followed it
+	void drop_partial_frame()
+	{
+		_partial_consumed = false;
+		_partial_position += _partial_frame_len;
+		_partial_len -= _partial_frame_len;
+		memmove(_partial, &_partial[_partial_frame_len], _partial_len);
+
+		if (_partial_len && !is_start(_partial[0])) {
+			resync_partial();
+		}
+	}
+
+	// Drops the first byte of the partial frame and moves on to the next start marker in it, if any
+	void resync_partial()
+	{
+		const uint8_t* start = find_start(&_partial[1], _partial_len - 1);
+		const size_t remaining = &_partial[_partial_len] - start;
+		_counters.bytes_dropped += _partial_len - remaining;
+		_partial_position += _partial_len - remaining;
+		memmove(_partial, start, remaining);
+		_partial_len = remaining;
+	}
+
+	const uint8_t* _input {};
+	size_t _length {};
+
+	// Stream offsets, see frame_position()
+	const uint8_t* _input_start {};
+	uint64_t _input_start_position {};
+	uint64_t _stream_length {};
+	uint64_t _partial_position {};
+	uint64_t _frame_position {};
+
+	uint8_t _partial[MAVLINK_MAX_PACKET_LEN] {};
+	size_t _partial_len {};
+	size_t _partial_frame_len {};
+	bool _partial_consumed {};
+
+	// Last parsed frame, in the input or in _partial
+	const uint8_t* _frame {};
+	size_t _frame_len {};
+
+	mavlink_status_t _status {};
+	Counters _counters {};
+};
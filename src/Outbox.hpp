@@ -0,0 +1,320 @@
+#pragma once
+
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <FrameQueue.hpp>
+#include <LatencyHistogram.hpp>
+#include <Mavlink.hpp>
+#include <TlogRecorder.hpp>
+
+namespace mavlink
+{
+
+static constexpr size_t DEFAULT_OUTBOX_CLASS_SIZE_BYTES = 4096;
+
+// Outgoing frames of a connection, one FrameQueue per OutboxClass so a burst of telemetry cannot crowd out acks and
+// heartbeats. The consumer side mirrors FrameQueue, peek() hands out the frames of higher classes first.
+// Classes that drop the newest frame stay lock-free. With the other policies producers free space and replace frames on
+// the consumer side, a busy flag keeps them away from frames between peek() and release(). If the consumer is busy sending
+// the class they fall back to dropping the newest frame, respectively to queueing without replacing.
+class Outbox
+{
+public:
+	using Frame = FrameQueue::Frame;
+
+	Outbox(const ConfigurationSettings& settings, size_t default_size_bytes)
+	{
+		for (size_t i = 0; i < CLASS_COUNT; i++) {
+			const OutboxClassSettings& lane_settings = settings.outbox_classes[i];
+			size_t size = lane_settings.size_bytes;
+
+			if (!size) {
+				size = OutboxClass(i) == OutboxClass::Telemetry && settings.outbox_size_bytes ? settings.outbox_size_bytes :
+				       OutboxClass(i) == OutboxClass::Telemetry ? default_size_bytes : DEFAULT_OUTBOX_CLASS_SIZE_BYTES;
+			}
+
+			_lanes[i].queue = std::make_unique<FrameQueue>(size, &_signal);
+			_lanes[i].policy = lane_settings.policy;
+		}
+	};
+
+	// Non-copyable
+	Outbox(const Outbox&) = delete;
+	const Outbox& operator=(const Outbox&) = delete;
+
+	// Reserves 'length' bytes in 'outbox_class' and calls 'write(uint8_t*)' to fill them in place. Safe to call from any thread.
+	// Returns false if the frame was dropped.
+	template<class F>
+	bool push(OutboxClass outbox_class, uint32_t message_id, uint16_t frame_length, F&& write_frame)
+	{
+		Lane& lane = _lanes[size_t(outbox_class)];
+
+		// With latency timing the queue time follows the frame
+		const uint16_t length = _latency ? frame_length + sizeof(uint64_t) : frame_length;
+
+		auto write = [&](uint8_t* buffer) {
+			write_frame(buffer);
+
+			if (_latency) {
+				const uint64_t now = latency_clock_ns();
+				memcpy(buffer + frame_length, &now, sizeof(now));
+			}
+		};
+
+		if (lane.policy == OutboxPolicy::DropNewest) {
+			if (!lane.queue->push(length, write)) {
+				lane.dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			lane.queued.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+
+		const bool locked = !lane.busy.exchange(true, std::memory_order_acquire);
+		const bool latest_value = lane.policy == OutboxPolicy::LatestValue && locked;
+
+		if (latest_value) {
+			auto it = lane.latest.find(message_id);
+
+			if (it != lane.latest.end() && lane.queue->skip(it->second)) {
+				lane.replaced.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		uint64_t position;
+		Frame oldest;
+
+		while (!lane.queue->push(length, write, &position)) {
+			// Frees the oldest frame, the consumer is not holding on to it
+			if (!locked || !lane.queue->peek(&oldest, 1)) {
+				if (locked) {
+					lane.busy.store(false, std::memory_order_release);
+				}
+
+				lane.dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			lane.queue->release();
+			lane.dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		if (latest_value) {
+			lane.latest[message_id] = position;
+		}
+
+		if (locked) {
+			lane.busy.store(false, std::memory_order_release);
+		}
+
+		lane.queued.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	};
+
+	// Consumer only. Fills 'frames' with up to 'max' published frames, higher classes first. Valid until release().
+	size_t peek(Frame* frames, size_t max)
+	{
+		size_t count = 0;
+		_peeked_frames = frames;
+
+		for (Lane& lane : _lanes) {
+			lock(lane);
+			lane.peeked = lane.queue->peek(frames + count, max - count);
+			count += lane.peeked;
+
+			if (!lane.peeked) {
+				unlock(lane);
+			}
+		}
+
+		if (_latency) {
+			for (size_t i = 0; i < count; i++) {
+				frames[i].length -= sizeof(uint64_t);
+			}
+		}
+
+		_peeked_count = count;
+		return count;
+	};
+
+	// Consumer only. Frees everything returned by the last peek().
+	void release()
+	{
+		count_sent(_peeked_count);
+
+		for (Lane& lane : _lanes) {
+			if (lane.peeked) {
+				lane.queue->release();
+				unlock(lane);
+			}
+		}
+	};
+
+	// Consumer only. Frees the first 'count' frames returned by the last peek(), the rest stays queued.
+	void release(size_t count)
+	{
+		count_sent(count);
+
+		for (Lane& lane : _lanes) {
+			if (lane.peeked) {
+				const size_t released = std::min(count, lane.peeked);
+				lane.queue->release(released);
+				count -= released;
+				unlock(lane);
+			}
+		}
+	};
+
+	// Consumer only. Drops everything that is queued, including what was peeked.
+	void clear()
+	{
+		for (Lane& lane : _lanes) {
+			if (!lane.peeked) {
+				lock(lane);
+			}
+
+			lane.queue->clear();
+			lane.latest.clear();
+			unlock(lane);
+		}
+	};
+
+	// Consumer only, see FrameQueue
+	bool wait(int timeout_ms = -1)
+	{
+		_signal.begin_wait();
+
+		if (empty()) {
+			_signal.wait(timeout_ms);
+		}
+
+		_signal.end_wait();
+		return !empty();
+	};
+
+	void wake()
+	{
+		_signal.notify();
+	};
+
+	bool arm()
+	{
+		_signal.begin_wait();
+		return empty();
+	};
+
+	void disarm()
+	{
+		_signal.end_wait();
+		_signal.reset();
+	};
+
+	bool empty()
+	{
+		for (Lane& lane : _lanes) {
+			if (!lane.queue->empty()) {
+				return false;
+			}
+		}
+
+		return true;
+	};
+
+	int fd() const { return _signal.fd(); };
+
+	// Times frames from push() until they are released. Set before the first push().
+	void set_latency(LatencyHistogram* latency) { _latency = latency; };
+
+	// Records frames as they are released, so that dropped and replaced ones never show up. Set before the first peek().
+	void set_recorder(TlogRecorder* recorder) { _recorder = recorder; };
+
+	// Released after peek(), that is handed to the kernel
+	uint64_t frames_sent() const { return _frames_sent.load(std::memory_order_relaxed); };
+	uint64_t bytes_sent() const { return _bytes_sent.load(std::memory_order_relaxed); };
+
+	std::vector<OutboxCounters> counters() const
+	{
+		std::vector<OutboxCounters> counters;
+
+		for (const Lane& lane : _lanes) {
+			counters.push_back({ lane.queued, lane.dropped, lane.replaced });
+		}
+
+		return counters;
+	};
+
+private:
+	static constexpr size_t CLASS_COUNT = size_t(OutboxClass::Count);
+
+	struct Lane {
+		std::unique_ptr<FrameQueue> queue {};
+		OutboxPolicy policy {};
+
+		// Set by the consumer from peek() to release(), and by producers freeing or replacing frames
+		std::atomic<bool> busy {};
+		std::unordered_map<uint32_t, uint64_t> latest {}; // Message ID --> position of its last frame, LatestValue only
+		size_t peeked {};
+
+		std::atomic<uint64_t> queued {};
+		std::atomic<uint64_t> dropped {};
+		std::atomic<uint64_t> replaced {};
+	};
+
+	// Consumer only, the first 'count' frames of the last peek() are gone
+	void count_sent(size_t count)
+	{
+		uint64_t bytes = 0;
+		const uint64_t now = _latency ? latency_clock_ns() : 0;
+
+		for (size_t i = 0; i < count && i < _peeked_count; i++) {
+			bytes += _peeked_frames[i].length;
+
+			if (_recorder) {
+				_recorder->record(_peeked_frames[i].data, _peeked_frames[i].length);
+			}
+
+			if (_latency) {
+				uint64_t queued;
+				memcpy(&queued, _peeked_frames[i].data + _peeked_frames[i].length, sizeof(queued));
+				_latency->record(now - queued);
+			}
+		}
+
+		_frames_sent.store(_frames_sent.load(std::memory_order_relaxed) + std::min(count, _peeked_count), std::memory_order_relaxed);
+		_bytes_sent.store(_bytes_sent.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+		_peeked_count = 0;
+	};
+
+	// Producers only hold the flag for a few instructions, the consumer spins
+	void lock(Lane& lane)
+	{
+		while (lane.policy != OutboxPolicy::DropNewest && lane.busy.exchange(true, std::memory_order_acquire)) {
+			std::this_thread::yield();
+		}
+	};
+
+	void unlock(Lane& lane)
+	{
+		lane.peeked = 0;
+
+		if (lane.policy != OutboxPolicy::DropNewest) {
+			lane.busy.store(false, std::memory_order_release);
+		}
+	};
+
+	ConsumerSignal _signal {};
+	Lane _lanes[CLASS_COUNT] {};
+
+	const Frame* _peeked_frames {};
+	size_t _peeked_count {};
+	LatencyHistogram* _latency {};
+	TlogRecorder* _recorder {};
+	std::atomic<uint64_t> _frames_sent {};
+	std::atomic<uint64_t> _bytes_sent {};
+};
+
+} // end namespace mavlink
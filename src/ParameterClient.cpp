@@ -0,0 +1,189 @@
+#include <ParameterClient.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <helpers.hpp>
+
+namespace mavlink
+{
+
+ParameterClient::ParameterClient(SendFunction send)
+	: _send(std::move(send))
+{}
+
+size_t ParameterClient::next_missing(size_t index) const
+{
+	while (index < _total) {
+		const uint64_t missing = ~_received[index / 64] >> (index % 64);
+
+		if (missing) {
+			return std::min(_total, index + __builtin_ctzll(missing));
+		}
+
+		index = (index / 64 + 1) * 64;
+	}
+
+	return _total;
+}
+
+bool ParameterClient::send_request_list()
+{
+	mavlink_param_request_list_t request = {
+		.target_system = _target_system,
+		.target_component = _target_component
+	};
+
+	return _send(MAVLINK_MSG_ID_PARAM_REQUEST_LIST, &request, MAVLINK_MSG_ID_PARAM_REQUEST_LIST_LEN,
+		     MAVLINK_MSG_ID_PARAM_REQUEST_LIST_CRC);
+}
+
+bool ParameterClient::send_request_read(uint16_t index)
+{
+	mavlink_param_request_read_t request = {
+		.param_index = int16_t(index),
+		.target_system = _target_system,
+		.target_component = _target_component
+	};
+
+	return _send(MAVLINK_MSG_ID_PARAM_REQUEST_READ, &request, MAVLINK_MSG_ID_PARAM_REQUEST_READ_LEN,
+		     MAVLINK_MSG_ID_PARAM_REQUEST_READ_CRC);
+}
+
+ParameterFetchResult ParameterClient::fetch(uint8_t target_system, uint8_t target_component, uint32_t timeout_ms)
+{
+	std::scoped_lock<std::mutex> fetch_lock(_fetch_mutex);
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	_target_system = target_system;
+	_target_component = target_component;
+	_result = {};
+	_total = 0;
+	_received.clear();
+	_list_ended = false;
+	_requesting = false;
+	_start_us = micros();
+	_last_value_us = _start_us;
+	_active = true;
+
+	if (!send_request_list()) {
+		LOG(RED_TEXT "Failed to send PARAM_REQUEST_LIST" NORMAL_TEXT);
+		_active = false;
+		return {};
+	}
+
+	// The list stream, until the first value is overdue or the stream ended or paused
+	for (;;) {
+		const uint64_t gap_us = (_total ? PARAM_LIST_GAP_MS : timeout_ms) * 1000;
+		const uint64_t quiet_us = micros() - _last_value_us;
+
+		if (complete() || _list_ended || quiet_us >= gap_us) {
+			break;
+		}
+
+		_condition.wait_for(lock, std::chrono::microseconds(gap_us - quiet_us));
+	}
+
+	// Missing indices, requested in a window that every answer moves along
+	_requesting = true;
+	std::vector<uint16_t> in_flight;
+	size_t next = 0;
+	uint64_t round_us = _last_value_us;
+
+	while (_total && !complete()) {
+		std::erase_if(in_flight, [this](uint16_t index) { return received(index); });
+
+		bool outbox_full = false;
+
+		while (in_flight.size() < PARAM_READ_WINDOW && (next = next_missing(next)) < _total) {
+			if (!send_request_read(uint16_t(next))) {
+				outbox_full = true;
+				break;
+			}
+
+			in_flight.push_back(uint16_t(next++));
+			_result.requested++;
+		}
+
+		const uint64_t now = micros();
+
+		if (now - _last_value_us >= uint64_t(timeout_ms) * 1000) {
+			break;
+		}
+
+		// Requests or answers got lost, start over with whatever is still missing
+		if (now - std::max(_last_value_us, round_us) >= PARAM_READ_TIMEOUT_MS * 1000) {
+			in_flight.clear();
+			next = 0;
+			round_us = now;
+			continue;
+		}
+
+		_condition.wait_for(lock, outbox_full ? std::chrono::milliseconds(1) : std::chrono::milliseconds(PARAM_READ_TIMEOUT_MS));
+	}
+
+	_active = false;
+	_result.complete = complete();
+	_result.elapsed_us = (_result.complete ? _last_value_us : micros()) - _start_us;
+
+	if (!_result.complete) {
+		LOG(RED_TEXT "Fetched %u of %zu parameters" NORMAL_TEXT, _result.received, _total);
+	}
+
+	return std::move(_result);
+}
+
+void ParameterClient::handle_value(const mavlink_message_t& message)
+{
+	if (!_active) {
+		return;
+	}
+
+	mavlink_param_value_t value;
+	mavlink_msg_param_value_decode(&message, &value);
+
+	std::scoped_lock<std::mutex> lock(_mutex);
+
+	bool from_target = message.sysid == _target_system && (!_target_component || message.compid == _target_component);
+
+	if (!_active || !from_target || !value.param_count) {
+		return;
+	}
+
+	// The first value sizes the table
+	const bool first = !_total;
+
+	if (first) {
+		_total = value.param_count;
+		_received.assign((_total + 63) / 64, 0);
+		_result.parameters.resize(_total);
+	}
+
+	// Answers to a PARAM_SET or a read by name may carry no index
+	if (value.param_index >= _total) {
+		return;
+	}
+
+	if (received(value.param_index)) {
+		return;
+	}
+
+	_received[value.param_index / 64] |= uint64_t(1) << (value.param_index % 64);
+	_result.received++;
+	_last_value_us = micros();
+
+	ParameterEntry& entry = _result.parameters[value.param_index];
+	memcpy(entry.name, value.param_id, sizeof(entry.name));
+	entry.float_value = value.param_value;
+	entry.type = value.param_type;
+
+	// While the list streams only its start and end are of interest
+	const bool list_ended = value.param_index == _total - 1;
+	_list_ended |= list_ended;
+
+	if (_requesting || first || list_ended || complete()) {
+		_condition.notify_one();
+	}
+}
+
+} // end namespace mavlink
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <Mavlink.hpp>
+
+namespace mavlink
+{
+
+static constexpr uint64_t PARAM_LIST_GAP_MS = 50;      // Silence that ends the list stream
+static constexpr uint64_t PARAM_READ_TIMEOUT_MS = 100; // Silence after which the missing parameters are requested again
+static constexpr size_t PARAM_READ_WINDOW = 32;        // PARAM_REQUEST_READs in flight at once
+
+// Fetches the parameters of a remote component into a table indexed by param_index.
+// PARAM_REQUEST_LIST starts the stream and a bitmap records which indices arrived. Once the last index arrived or the
+// stream went quiet, the missing indices are requested with PARAM_REQUEST_READ, a window of them in flight at once, and
+// every answer makes room for the next request.
+class ParameterClient
+{
+public:
+	// Encodes the payload into the outbox, returns false if it is full
+	using SendFunction = std::function<bool(uint32_t message_id, const void* payload, uint8_t max_length, uint8_t crc_extra)>;
+
+	ParameterClient(SendFunction send);
+
+	// One fetch at a time, others wait
+	ParameterFetchResult fetch(uint8_t target_system, uint8_t target_component, uint32_t timeout_ms);
+
+	// Called from the receiving thread
+	void handle_value(const mavlink_message_t& message);
+
+private:
+	bool received(size_t index) const { return _received[index / 64] & (uint64_t(1) << (index % 64)); }
+	bool complete() const { return _total && _result.received == _total; }
+
+	// First index from 'index' on that has not arrived, _total if there is none
+	size_t next_missing(size_t index) const;
+
+	bool send_request_list();
+	bool send_request_read(uint16_t index);
+
+	SendFunction _send {};
+
+	std::mutex _fetch_mutex {};
+	std::mutex _mutex {};
+	std::condition_variable _condition {};
+
+	std::atomic<bool> _active {};
+	uint8_t _target_system {};
+	uint8_t _target_component {};
+
+	ParameterFetchResult _result {};
+	size_t _total {};                   // total_count of the first value, 0 until one arrived
+	std::vector<uint64_t> _received {}; // Bitmap by index
+	bool _list_ended {};                // The last index arrived
+	bool _requesting {};                // Missing indices are being requested
+	uint64_t _start_us {};
+	uint64_t _last_value_us {};
+};
+
+} // end namespace mavlink
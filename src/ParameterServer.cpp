@@ -0,0 +1,140 @@
+#include <ParameterServer.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <helpers.hpp>
+
+namespace mavlink
+{
+
+ParameterServer::ParameterServer(ListFunction list, SetFunction set, SendFunction send, uint16_t values_per_second)
+	: _list(std::move(list))
+	, _set(std::move(set))
+	, _send(std::move(send))
+	, _values_per_second(values_per_second)
+{}
+
+void ParameterServer::refresh()
+{
+	_parameters = _list();
+	_index.clear();
+	_requested.clear();
+
+	// Indices and count follow the list, whatever the application filled in
+	for (size_t i = 0; i < _parameters.size(); i++) {
+		_parameters[i].index = uint16_t(i);
+		_parameters[i].total_count = uint16_t(_parameters.size());
+		_index[_parameters[i].name] = uint16_t(i);
+	}
+}
+
+void ParameterServer::handle_request_list()
+{
+	std::scoped_lock<std::mutex> lock(_mutex);
+	refresh();
+	_next = 0;
+
+	LOG(GREEN_TEXT "Sending %zu parameters to GCS" NORMAL_TEXT, _parameters.size());
+}
+
+void ParameterServer::handle_request_read(const mavlink_param_request_read_t& msg)
+{
+	std::scoped_lock<std::mutex> lock(_mutex);
+
+	if (_parameters.empty()) {
+		refresh();
+		_next = _parameters.size();
+	}
+
+	size_t index = size_t(msg.param_index);
+
+	// An index of -1 asks by name
+	if (msg.param_index < 0) {
+		auto it = _index.find(std::string(msg.param_id, strnlen(msg.param_id, sizeof(msg.param_id))));
+
+		if (it == _index.end()) {
+			return;
+		}
+
+		index = it->second;
+	}
+
+	if (index >= _parameters.size()) {
+		return;
+	}
+
+	if (!_send(_parameters[index])) {
+		_requested.push_back(uint16_t(index));
+	}
+}
+
+void ParameterServer::handle_set(const mavlink_param_set_t& msg)
+{
+	Parameter param = {
+		.name = std::string(msg.param_id, strnlen(msg.param_id, sizeof(msg.param_id))),
+		.float_value = msg.param_value,
+		.type = msg.param_type,
+	};
+
+	// Param set callback -- it will modify 'param' to set the index on success
+	if (!_set(&param)) {
+		return;
+	}
+
+	std::scoped_lock<std::mutex> lock(_mutex);
+	auto it = _index.find(param.name);
+
+	if (it == _index.end()) {
+		_send(param);
+		return;
+	}
+
+	Parameter& cached = _parameters[it->second];
+	cached.float_value = param.float_value;
+	cached.type = param.type;
+
+	if (!_send(cached)) {
+		_requested.push_back(it->second);
+	}
+}
+
+bool ParameterServer::run()
+{
+	std::scoped_lock<std::mutex> lock(_mutex);
+
+	if (_requested.empty() && _next >= _parameters.size()) {
+		return false;
+	}
+
+	const uint64_t now = micros();
+
+	if (_values_per_second) {
+		// Allows one interval worth of values at once
+		const double burst = std::max(1.0, double(_values_per_second) * PARAM_STREAM_INTERVAL_MS / 1000);
+		_tokens = std::min(burst, _tokens + double(now - _tokens_updated_us) * _values_per_second / 1e6);
+	}
+
+	_tokens_updated_us = now;
+
+	while (!_requested.empty()) {
+		if (!_send(_parameters[_requested.front()])) {
+			return true;
+		}
+
+		_requested.pop_front();
+	}
+
+	while (_next < _parameters.size() && (!_values_per_second || _tokens >= 1.0)) {
+		if (!_send(_parameters[_next])) {
+			return true;
+		}
+
+		_next++;
+		_tokens -= 1.0;
+	}
+
+	return _next < _parameters.size();
+}
+
+} // end namespace mavlink
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Mavlink.hpp>
+
+namespace mavlink
+{
+
+static constexpr uint64_t PARAM_STREAM_INTERVAL_MS = 10; // How often the stream tops up the outbox
+
+// Serves the parameters of the application from a cache.
+// PARAM_REQUEST_LIST refreshes the cache from the application and streams it. The stream only hands the outbox what it
+// takes, so it goes out at the pace of the link, optionally capped at a rate. PARAM_REQUEST_READ answers single
+// parameters by index or by name through a hash index, ahead of the list.
+class ParameterServer
+{
+public:
+	using ListFunction = std::function<std::vector<Parameter>(void)>;
+	using SetFunction = std::function<bool(Parameter*)>;
+	using SendFunction = std::function<bool(const Parameter&)>; // Returns false if the outbox is full
+
+	ParameterServer(ListFunction list, SetFunction set, SendFunction send, uint16_t values_per_second);
+
+	// Called from the receiving thread
+	void handle_request_list();
+	void handle_request_read(const mavlink_param_request_read_t& msg);
+	void handle_set(const mavlink_param_set_t& msg);
+
+	// Sends pending PARAM_VALUEs until the outbox is full. Called periodically from the scheduler thread.
+	// Returns false once nothing is pending any more.
+	bool run();
+
+private:
+	void refresh();
+
+	ListFunction _list {};
+	SetFunction _set {};
+	SendFunction _send {};
+
+	std::mutex _mutex {};
+	std::vector<Parameter> _parameters {};
+	std::unordered_map<std::string, uint16_t> _index {}; // Name --> index in _parameters
+
+	size_t _next {}; // Next parameter of the list stream, _parameters.size() if there is none
+	std::deque<uint16_t> _requested {}; // Single parameters, sent before the list stream
+
+	// Rate cap, 0 sends whatever the outbox takes
+	uint16_t _values_per_second {};
+	double _tokens {};
+	uint64_t _tokens_updated_us {};
+};
+
+} // end namespace mavlink
@@ -0,0 +1,255 @@
+#include "ReplayConnection.hpp"
+#include "Mavlink.hpp"
+
+#include <endian.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace mavlink
+{
+
+ReplayConnection::ReplayConnection(Mavlink* parent)
+	: Connection(REPLAY_CONNECTION_TIMEOUT_MS, parent->settings())
+	, _parent(parent)
+{
+	const ConfigurationSettings& settings = _parent->settings();
+
+	// Parse connection string
+	std::string conn = settings.connection_url;
+	std::string replay = "replay://";
+	conn.erase(conn.find(replay), replay.length());
+	size_t query = conn.find('?');
+
+	if (query != std::string::npos) {
+		std::string speed = "speed=";
+		size_t index = conn.find(speed, query);
+
+		if (index != std::string::npos) {
+			const char* value = conn.c_str() + index + speed.length();
+			char* end = nullptr;
+			_speed = std::max(0.0, strtod(value, &end));
+
+			if (end == value || (*end != '\0' && *end != '&')) {
+				LOG(RED_TEXT "Invalid replay speed: %s" NORMAL_TEXT, value);
+				_url_valid = false;
+			}
+		}
+
+		conn.erase(query);
+	}
+
+	_path = conn;
+	_target_sysid = settings.target_sysid;
+	_target_compid = settings.target_compid;
+}
+
+ReplayConnection::~ReplayConnection()
+{
+	stop();
+}
+
+ConnectionResult ReplayConnection::start()
+{
+	if (!_url_valid) {
+		return ConnectionResult::ConnectionUrlInvalid;
+	}
+
+	_fd = open(_path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (_fd < 0) {
+		LOG(RED_TEXT "Failed to open tlog %s: %s" NORMAL_TEXT, _path.c_str(), strerror(errno));
+		return ConnectionResult::FileError;
+	}
+
+	struct stat st;
+
+	if (fstat(_fd, &st) != 0) {
+		close(_fd);
+		_fd = -1;
+		return ConnectionResult::FileError;
+	}
+
+	_size = st.st_size;
+
+	if (_size) {
+		void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+
+		if (data == MAP_FAILED) {
+			LOG(RED_TEXT "Failed to map tlog %s: %s" NORMAL_TEXT, _path.c_str(), strerror(errno));
+			close(_fd);
+			_fd = -1;
+			return ConnectionResult::FileError;
+		}
+
+		// The advice values are not flags, each takes its own call
+		madvise(data, _size, MADV_SEQUENTIAL);
+		madvise(data, _size, MADV_WILLNEED);
+		_data = static_cast<const uint8_t*>(data);
+	}
+
+	_initialized = true;
+	_start_us = micros();
+	_thread = std::make_unique<std::thread>(&ReplayConnection::thread_main, this);
+
+	return ConnectionResult::Success;
+}
+
+void ReplayConnection::stop()
+{
+	_should_exit = true;
+
+	if (_thread) {
+		_thread->join();
+		_thread.reset();
+	}
+
+	if (_data) {
+		munmap(const_cast<uint8_t*>(_data), _size);
+		_data = nullptr;
+	}
+
+	if (_fd >= 0) {
+		close(_fd);
+		_fd = -1;
+	}
+
+	_message_outbox_queue.clear();
+}
+
+bool ReplayConnection::flush_outbox()
+{
+	// Nothing to send to, a recording does not listen
+	_message_outbox_queue.clear();
+	return true;
+}
+
+ReplayCounters ReplayConnection::counters() const
+{
+	return {
+		.frames = _frames.load(std::memory_order_relaxed),
+		.bad_records = _bad_records.load(std::memory_order_relaxed),
+		.elapsed_us = _finished ? _elapsed_us.load() : micros() - _start_us,
+		.finished = _finished
+	};
+}
+
+void ReplayConnection::thread_main()
+{
+	LOG("[ReplayConnection] Replaying %s at %s", _path.c_str(), _speed > 0 ? (std::to_string(_speed) + "x").c_str() : "full speed");
+
+	size_t offset = 0;
+	size_t records = 0;
+
+	while (!_should_exit && offset + sizeof(uint64_t) < _size) {
+		uint64_t timestamp_us;
+		memcpy(&timestamp_us, &_data[offset], sizeof(timestamp_us));
+		timestamp_us = be64toh(timestamp_us);
+
+		const uint8_t* frame = &_data[offset + sizeof(timestamp_us)];
+		const size_t available = _size - offset - sizeof(timestamp_us);
+
+		// The preallocated rest of a recording that was never finished
+		if (timestamp_us == 0 && frame[0] == 0) {
+			break;
+		}
+
+		size_t frame_length = 0;
+
+		if (frame[0] == MAVLINK_STX && available >= MAVLINK_NUM_HEADER_BYTES) {
+			const bool is_signed = frame[2] & MAVLINK_IFLAG_SIGNED;
+			frame_length = MAVLINK_NUM_NON_PAYLOAD_BYTES + frame[1] + (is_signed ? MAVLINK_SIGNATURE_BLOCK_LEN : 0);
+
+		} else if (frame[0] == MAVLINK_STX_MAVLINK1 && available >= MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1) {
+			frame_length = MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1 + frame[1] + MAVLINK_NUM_CHECKSUM_BYTES;
+		}
+
+		// Without a frame length there is no telling where the next record starts
+		if (frame_length == 0 || frame_length > available) {
+			LOG(RED_TEXT "[ReplayConnection] Invalid record at offset %zu, stopping" NORMAL_TEXT, offset);
+			_bad_records++;
+			break;
+		}
+
+		if (_speed > 0 && !wait_until_due(timestamp_us)) {
+			break;
+		}
+
+		handle_frame(frame, frame_length);
+		offset += sizeof(timestamp_us) + frame_length;
+
+		if (++records % REPLAY_OUTBOX_CLEAR_INTERVAL == 0) {
+			_message_outbox_queue.clear();
+		}
+	}
+
+	_elapsed_us = micros() - _start_us;
+	_finished = true;
+
+	LOG("[ReplayConnection] Replayed %lu frames in %.3f s", _frames.load(), double(_elapsed_us) / 1e6);
+}
+
+bool ReplayConnection::wait_until_due(uint64_t timestamp_us)
+{
+	if (!_first_timestamp_us) {
+		_first_timestamp_us = timestamp_us;
+	}
+
+	// Records out of order play right away
+	const uint64_t offset_us = timestamp_us > _first_timestamp_us ? timestamp_us - _first_timestamp_us : 0;
+	const uint64_t due_us = _start_us + uint64_t(double(offset_us) / _speed);
+
+	for (;;) {
+		if (_should_exit) {
+			return false;
+		}
+
+		const uint64_t now = micros();
+
+		if (now >= due_us) {
+			return true;
+		}
+
+		_message_outbox_queue.clear();
+		std::this_thread::sleep_for(std::chrono::microseconds(std::min(due_us - now, REPLAY_MAX_SLEEP_MS * 1000)));
+	}
+}
+
+void ReplayConnection::handle_frame(const uint8_t* frame, size_t length)
+{
+	mavlink_message_t message;
+	_parser.set_input(reinterpret_cast<const char*>(frame), length);
+
+	if (!_parser.parse(&message)) {
+		// Start over, so nothing of this record is kept for the next
+		_parser = MessageParser {};
+		_bad_records++;
+		return;
+	}
+
+	_frames.fetch_add(1, std::memory_order_relaxed);
+	count_received(message);
+	count_input(length);
+
+	if (!should_handle_message(message)) {
+		return;
+	}
+
+	if (message.msgid == MAVLINK_MSG_ID_HEARTBEAT) {
+		if (!_connected) {
+			_connected = true;
+			LOG(GREEN_TEXT "Replaying sysid %u compid %u" NORMAL_TEXT, message.sysid, message.compid);
+		}
+
+		_last_received_heartbeat_ms = millis();
+	}
+
+	_parent->handle_message(message);
+}
+
+} // end namespace mavlink
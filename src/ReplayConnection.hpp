@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "Connection.hpp"
+#include <helpers.hpp>
+
+namespace mavlink
+{
+
+static constexpr uint64_t REPLAY_CONNECTION_TIMEOUT_MS = 2000;
+static constexpr uint64_t REPLAY_MAX_SLEEP_MS = 100; // Longest wait for a record before checking for stop()
+static constexpr size_t REPLAY_OUTBOX_CLEAR_INTERVAL = 256; // Records between discarding what was queued for sending
+
+class Mavlink;
+
+// Plays a recorded tlog back through the parser and the dispatch path, for connection strings like
+// replay:///path/to/flight.tlog?speed=2
+// Speed 1 keeps the recorded timing, N plays N times as fast and 0 as fast as possible. The file is memory mapped and
+// played by one thread. The connection is up while heartbeats of the target arrive, messages sent to it are discarded.
+class ReplayConnection : public Connection
+{
+public:
+	ReplayConnection(Mavlink* parent);
+	~ReplayConnection();
+
+	ConnectionResult start() override;
+	void stop() override;
+	bool send_frame(const uint8_t* data, uint16_t length) override { return true; };
+	bool flush_outbox() override;
+
+	// EventLoop::Client, the replay always runs on its own thread
+	void handle_events(int fd, uint32_t events) override {};
+	void tick() override {};
+
+	ReplayCounters counters() const;
+
+	// Non-copyable
+	ReplayConnection(const ReplayConnection&) = delete;
+	const ReplayConnection& operator=(const ReplayConnection&) = delete;
+
+private:
+	void thread_main();
+
+	// Waits until the record with 'timestamp_us' is due. Returns false if the replay was stopped.
+	bool wait_until_due(uint64_t timestamp_us);
+
+	void handle_frame(const uint8_t* frame, size_t length);
+
+	std::string _path {};
+	double _speed {1.0};
+	bool _url_valid {true}; // start() fails for a speed that does not parse
+
+	int _fd {-1};
+	const uint8_t* _data {};
+	size_t _size {};
+
+	uint64_t _first_timestamp_us {};
+	uint64_t _start_us {};
+
+	std::atomic<uint64_t> _frames {};
+	std::atomic<uint64_t> _bad_records {};
+	std::atomic<uint64_t> _elapsed_us {};
+	std::atomic<bool> _finished {};
+
+	std::atomic_bool _should_exit {false};
+	std::unique_ptr<std::thread> _thread {};
+
+	Mavlink* _parent {};
+};
+
+} // end namespace mavlink
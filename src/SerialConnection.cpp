@@ -1,16 +1,23 @@
 #include "SerialConnection.hpp"
-#include "MessageParser.hpp"
 #include "Mavlink.hpp"
+#include "StreamScheduler.hpp"
 
 #if defined(APPLE) || defined(LINUX)
 #include <unistd.h>
 #include <fcntl.h>
 #include <termios.h>
 #include <poll.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
 
 #include <utility>
 #endif
 
+#if defined(LINUX)
+#include <linux/serial.h>
+#endif
+
 namespace mavlink
 {
 
@@ -51,7 +58,7 @@ std::string GetLastErrorStdStr()
 #endif
 
 SerialConnection::SerialConnection(Mavlink* parent)
-	: Connection(SERIAL_CONNECTION_TIMEOUT_MS)
+	: Connection(SERIAL_CONNECTION_TIMEOUT_MS, parent->settings())
 	, _parent(parent)
 {
 	ConfigurationSettings settings = _parent->settings();
@@ -60,7 +67,8 @@ SerialConnection::SerialConnection(Mavlink* parent)
 	std::string serial_flowcontrol  = "serial_flowcontrol:";
 	std::string conn                = settings.connection_url;
 
-	_emit_heartbeat = settings.emit_heartbeat;
+	_event_loop = settings.event_loop;
+	_io_uring = settings.io_uring && !_event_loop; // The event loop takes precedence
 
 	_flow_control = conn.find(serial_flowcontrol) != std::string::npos;
 
@@ -76,6 +84,19 @@ SerialConnection::SerialConnection(Mavlink* parent)
 	_serial_node = conn.substr(0, index);
 	conn.erase(0, index + 1);
 	_baudrate = std::stoi(conn);
+
+	_target_sysid = settings.target_sysid;
+	_target_compid = settings.target_compid;
+	_low_latency = settings.serial_low_latency;
+
+	// Bytes arrive at about baudrate / 10 per second
+	size_t buffer_size = SERIAL_RECEIVE_BUFFER_SIZE;
+
+	while (_low_latency && buffer_size < _baudrate / 10 * SERIAL_LOW_LATENCY_BUFFER_MS / 1000) {
+		buffer_size <<= 1;
+	}
+
+	_receive_buffer.resize(buffer_size);
 }
 
 SerialConnection::~SerialConnection()
@@ -87,12 +108,39 @@ SerialConnection::~SerialConnection()
 ConnectionResult SerialConnection::start()
 {
 	LOG("start");
+
+	// Before the port, setup_port() only makes reads blocking for io_uring
+	if (_io_uring && !setup_uring()) {
+		LOG("io_uring not supported, falling back to the receive thread");
+		_uring.reset();
+	}
+
 	ConnectionResult ret = setup_port();
 
 	if (ret != ConnectionResult::Success) {
+		_uring.reset();
 		return ret;
 	}
 
+	if (_event_loop) {
+		_event_loop->attach(this);
+		_event_loop->watch(this, _fd, EPOLLIN);
+		_event_loop->watch(this, _message_outbox_queue.fd(), EPOLLIN);
+
+		if (_scheduler) {
+			_event_loop->watch(this, _scheduler->fd(), EPOLLIN);
+			_runs_scheduler = true;
+		}
+
+		return ConnectionResult::Success;
+	}
+
+	if (_uring) {
+		_runs_scheduler = _scheduler != nullptr;
+		_recv_thread = std::make_unique<std::thread>(&SerialConnection::uring_thread_main, this);
+		return ConnectionResult::Success;
+	}
+
 	start_recv_thread();
 
 	return ConnectionResult::Success;
@@ -100,6 +148,8 @@ ConnectionResult SerialConnection::start()
 
 ConnectionResult SerialConnection::setup_port()
 {
+	_hung_up = false;
+
 #if defined(LINUX) || defined(APPLE)
 	// open() hangs on macOS or Linux devices(e.g. pocket beagle) unless you give it O_NONBLOCK
 	_fd = open(_serial_node.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
@@ -109,9 +159,9 @@ ConnectionResult SerialConnection::setup_port()
 		return ConnectionResult::ConnectionError;
 	}
 
-	// We need to clear the O_NONBLOCK again because we can block while reading
-	// as we do it in a separate thread.
-	if (fcntl(_fd, F_SETFL, 0) == -1) {
+	// The receive and send threads poll before reading and writing and keep O_NONBLOCK, so that a full tty buffer
+	// turns into a short write instead of blocking. io_uring needs blocking reads to wait for data in the kernel.
+	if (_uring && fcntl(_fd, F_SETFL, 0) == -1) {
 		LOG("fcntl failed: %s", GET_ERROR());
 		return ConnectionResult::ConnectionError;
 	}
@@ -155,8 +205,16 @@ ConnectionResult SerialConnection::setup_port()
 	tc.c_cflag &= ~(CSIZE | PARENB | CRTSCTS);
 	tc.c_cflag |= CS8;
 
-	tc.c_cc[VMIN] = 0; // We are ok with 0 bytes.
-	tc.c_cc[VTIME] = 10; // Timeout after 1 second.
+	if (_low_latency) {
+		// Blocking reads return with the first byte instead of waiting for the VTIME timer, which counts in 100 ms.
+		// Only the io_uring reads block, the threads poll first and read non-blocking.
+		tc.c_cc[VMIN] = 1;
+		tc.c_cc[VTIME] = 0;
+
+	} else {
+		tc.c_cc[VMIN] = 0; // We are ok with 0 bytes.
+		tc.c_cc[VTIME] = 10; // Timeout after 1 second.
+	}
 
 	if (_flow_control) {
 		tc.c_cflag |= CRTSCTS;
@@ -197,6 +255,28 @@ ConnectionResult SerialConnection::setup_port()
 
 #endif
 
+#if defined(LINUX)
+
+	// Asks the driver to push received bytes to the tty right away, e.g. drops the latency timer of FTDI adapters to 1 ms
+	if (_low_latency) {
+		struct serial_struct serial = {};
+		bool low_latency_set = false;
+
+		if (ioctl(_fd, TIOCGSERIAL, &serial) == 0) {
+			serial.flags |= ASYNC_LOW_LATENCY;
+			low_latency_set = ioctl(_fd, TIOCSSERIAL, &serial) == 0;
+		}
+
+		if (low_latency_set) {
+			LOG("ASYNC_LOW_LATENCY set");
+
+		} else {
+			LOG("ASYNC_LOW_LATENCY not supported: %s", GET_ERROR());
+		}
+	}
+
+#endif
+
 #if defined(WINDOWS)
 	DCB dcb;
 	SecureZeroMemory(&dcb, sizeof(DCB));
@@ -254,28 +334,49 @@ ConnectionResult SerialConnection::setup_port()
 void SerialConnection::start_recv_thread()
 {
 	_recv_thread = std::make_unique<std::thread>(&SerialConnection::receive_thread_main, this);
+	_send_thread = std::make_unique<std::thread>(&SerialConnection::send_thread_main, this);
 }
 
 void SerialConnection::stop()
 {
 	_should_exit = true;
 
+	if (_event_loop) {
+		// No callbacks run once detached
+		_event_loop->detach(this);
+		_message_outbox_queue.clear();
+	}
+
 	if (_recv_thread) {
+		_message_outbox_queue.wake(); // The io_uring thread also wakes up on the outbox
 		_recv_thread->join();
 		_recv_thread.reset();
 	}
 
+	if (_send_thread) {
+		_message_outbox_queue.wake();
+		_send_thread->join();
+		_send_thread.reset();
+		_message_outbox_queue.clear();
+	}
+
+	if (_uring) {
+		_message_outbox_queue.clear();
+		_uring.reset();
+	}
+
 #if defined(LINUX) || defined(APPLE)
-	close(_fd);
+	if (_fd >= 0) {
+		close(_fd);
+		_fd = -1;
+	}
 #elif defined(WINDOWS)
 	CloseHandle(_handle);
 #endif
 }
 
-bool SerialConnection::send_message(const mavlink_message_t& message)
+bool SerialConnection::send_frame(const uint8_t* data, uint16_t length)
 {
-	LOG("send_message");
-
 	if (_serial_node.empty()) {
 		LOG("Dev Path unknown");
 		return false;
@@ -286,22 +387,19 @@ bool SerialConnection::send_message(const mavlink_message_t& message)
 		return false;
 	}
 
-	uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
-	uint16_t buffer_len = mavlink_msg_to_send_buffer(buffer, &message);
-
 	int send_len;
 #if defined(LINUX) || defined(APPLE)
-	send_len = static_cast<int>(write(_fd, buffer, buffer_len));
+	send_len = static_cast<int>(write(_fd, data, length));
 #else
 
-	if (!WriteFile(_handle, buffer, buffer_len, LPDWORD(&send_len), NULL)) {
+	if (!WriteFile(_handle, data, length, LPDWORD(&send_len), NULL)) {
 		LOG("WriteFile failure: %s", GET_ERROR());
 		return false;
 	}
 
 #endif
 
-	if (send_len != buffer_len) {
+	if (send_len != length) {
 		LOG("write failure: %s", GET_ERROR());
 		return false;
 	}
@@ -309,32 +407,161 @@ bool SerialConnection::send_message(const mavlink_message_t& message)
 	return true;
 }
 
+bool SerialConnection::flush_outbox()
+{
+	size_t count;
+
+	while ((count = prepare_write())) {
+		const ssize_t written = writev(_fd, _write_iovecs, int(count));
+		_write_syscalls++;
+
+		if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+			LOG("write failure: %s", GET_ERROR());
+			_partial_length = 0;
+			_message_outbox_queue.release();
+			return false;
+		}
+
+		if (!release_written(written < 0 ? 0 : written)) {
+			// The tty buffer is full, the rest goes out once it is writable
+			set_send_blocked(_fd, true);
+			break;
+		}
+	}
+
+	return true;
+}
+
+size_t SerialConnection::prepare_write()
+{
+	// The rest of a frame cut off by a short write goes first
+	const size_t first = _partial_length ? 1 : 0;
+
+	if (first) {
+		_write_iovecs[0].iov_base = _partial_frame;
+		_write_iovecs[0].iov_len = _partial_length;
+	}
+
+	_write_frame_count = _message_outbox_queue.peek(_write_frames, SERIAL_MAX_FLUSH_FRAMES - first);
+
+	for (size_t i = 0; i < _write_frame_count; i++) {
+		_write_iovecs[first + i].iov_base = const_cast<uint8_t*>(_write_frames[i].data);
+		_write_iovecs[first + i].iov_len = _write_frames[i].length;
+	}
+
+	return first + _write_frame_count;
+}
+
+bool SerialConnection::release_written(size_t written)
+{
+	if (_partial_length) {
+		const size_t done = std::min(written, _partial_length);
+		memmove(_partial_frame, _partial_frame + done, _partial_length - done);
+		_partial_length -= done;
+		written -= done;
+	}
+
+	size_t done = 0;
+
+	while (done < _write_frame_count && written >= _write_frames[done].length) {
+		written -= _write_frames[done].length;
+		done++;
+	}
+
+	if (done < _write_frame_count && written) {
+		_partial_length = _write_frames[done].length - written;
+		memcpy(_partial_frame, _write_frames[done].data + written, _partial_length);
+		done++;
+	}
+
+	_message_outbox_queue.release(done);
+
+	return done == _write_frame_count && !_partial_length;
+}
+
+void SerialConnection::handle_events(int fd, uint32_t events)
+{
+	if (fd == _message_outbox_queue.fd()) {
+		drain_outbox();
+		return;
+	}
+
+	if (_scheduler && fd == _scheduler->fd()) {
+		_scheduler->run();
+		return;
+	}
+
+	if (events & EPOLLOUT) {
+		set_send_blocked(_fd, false);
+		drain_outbox();
+	}
+
+	if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+		for (size_t i = 0; i < SERIAL_MAX_READS_PER_EVENT && read_available(); i++) {}
+	}
+
+	// The level triggered watch would report the hangup again right away
+	if (events & EPOLLHUP) {
+		hang_up();
+	}
+}
+
+void SerialConnection::hang_up()
+{
+	if (_hung_up.exchange(true)) {
+		return;
+	}
+
+	LOG(RED_TEXT "Serial device %s hung up" NORMAL_TEXT, _serial_node.c_str());
+	_connected = false;
+
+	if (_event_loop) {
+		_event_loop->unwatch(this, _fd);
+	}
+}
+
+void SerialConnection::tick()
+{
+	if (_connected && connection_timed_out()) {
+		LOG(RED_TEXT "Connection timed out" NORMAL_TEXT);
+		_connected = false;
+	}
+}
+
 void SerialConnection::receive_thread_main()
 {
 	LOG("receive_thread_main");
 
-	while (!_should_exit) {
+	while (!_should_exit && !_hung_up) {
 		receive();
+		tick();
+	}
+}
 
-		if (_connected && connection_timed_out()) {
-			LOG(RED_TEXT "Connection timed out" NORMAL_TEXT);
-			_connected = false;
-		}
+void SerialConnection::send_thread_main()
+{
+	LOG("send_thread_main");
 
-		std::optional<mavlink_message_t> message = _message_outbox_queue.pop_front(/* blocking */ false);
+	struct pollfd fds[2] = {
+		{ .fd = _message_outbox_queue.fd(), .events = POLLIN, .revents = 0 },
+		{ .fd = _fd, .events = POLLOUT, .revents = 0 },
+	};
 
-		if (message) {
-			if (!send_message(message.value())) {
-				LOG(RED_TEXT "Send message failed!" NORMAL_TEXT);
-			}
+	while (!_should_exit) {
+		_message_outbox_queue.disarm();
+
+		// Frames stay queued until the connection is up, the receive thread wakes us up once it is
+		if (_connected && !_send_blocked && !flush_outbox()) {
+			LOG(RED_TEXT "Send message failed!" NORMAL_TEXT);
 		}
 
-		// Check if it's time to senda heartbeat. Only send heartbeats if we're still connected to an autopilot
-		if (_connected && _emit_heartbeat) {
-			if (millis() > _last_sent_heartbeat_ms + Connection::HEARTBEAT_INTERVAL_MS) {
-				LOG("Sending heartbeat");
-				_last_sent_heartbeat_ms = millis();
-				_parent->send_heartbeat();
+		// Producers signal the outbox from here on. Frames pushed since the flush go out right away, unless the tty is
+		// full, then the tty is watched for writability as well.
+		if (_message_outbox_queue.arm() || _send_blocked || !_connected) {
+			fds[1].revents = 0;
+
+			if (poll(fds, _send_blocked ? 2 : 1, SERIAL_SEND_POLL_TIMEOUT_MS) > 0 && fds[1].revents) {
+				set_send_blocked(_fd, false);
 			}
 		}
 	}
@@ -342,62 +569,292 @@ void SerialConnection::receive_thread_main()
 
 void SerialConnection::receive()
 {
-	// Enough for MTU 1500 bytes.
-	char buffer[2048];
-
 #if defined(LINUX) || defined(APPLE)
 	struct pollfd fds[1];
 	fds[0].fd = _fd;
 	fds[0].events = POLLIN;
-#endif
 
-	int recv_len;
-#if defined(LINUX) || defined(APPLE)
 	int pollrc = poll(fds, 1, 100);
 
-	if (pollrc == 0 || !(fds[0].revents & POLLIN)) {
-		LOG("poll no data");
+	if (pollrc == -1) {
+		LOG("read poll failure: %s", GET_ERROR());
 		return;
+	}
 
-	} else if (pollrc == -1) {
-		LOG("read poll failure: %s", GET_ERROR());
+	if (pollrc == 0 || !(fds[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+		return;
+	}
+
+	// Reads what is left after a hangup, then poll() would keep returning right away
+	if (!read_available() && (fds[0].revents & POLLHUP)) {
+		hang_up();
 	}
 
-	// We enter here if (fds[0].revents & POLLIN) == true
-	recv_len = static_cast<int>(read(_fd, buffer, sizeof(buffer)));
+#else
+	read_available();
+#endif
+}
+
+bool SerialConnection::read_available()
+{
+	char* buffer = _receive_buffer.data();
+	const size_t buffer_size = _receive_buffer.size();
+
+	int recv_len;
+#if defined(LINUX) || defined(APPLE)
+	recv_len = static_cast<int>(read(_fd, buffer, buffer_size));
 
-	if (recv_len < -1) {
+	// The fd is non-blocking, a read without data fails with EAGAIN. End of file means the tty was hung up.
+	if (recv_len == 0 || (recv_len < 0 && errno == EIO)) {
+		hang_up();
+		return false;
+	}
+
+	if (recv_len < 0 && errno != EAGAIN) {
 		LOG("read failure: %s", GET_ERROR());
 	}
 
 #else
 
-	if (!ReadFile(_handle, buffer, sizeof(buffer), LPDWORD(&recv_len), NULL)) {
+	if (!ReadFile(_handle, buffer, buffer_size, LPDWORD(&recv_len), NULL)) {
 		LOG("ReadFile failure: %s", GET_ERROR());
-		return;
+		return false;
 	}
 
 #endif
 
-	if (recv_len > static_cast<int>(sizeof(buffer)) || recv_len == 0) {
-		return;
+	if (recv_len > static_cast<int>(buffer_size) || recv_len <= 0) {
+		return false;
+	}
+
+	handle_bytes(buffer, recv_len);
+	return true;
+}
+
+void SerialConnection::handle_bytes(const char* data, size_t length)
+{
+	if (_low_latency) {
+		_received_bytes += length;
+		_read_times[_read_count++ % SERIAL_READ_TIMES] = { _received_bytes, micros() };
 	}
 
 	mavlink_message_t message;
-	auto parser = MessageParser(buffer, recv_len);
+	const uint64_t read_ns = received_ns();
+	_parser.set_input(data, length);
+
+	while (_parser.parse(&message)) {
+		record_received();
+		count_received(message);
 
-	while (parser.parse(&message)) {
 		if (message.msgid == MAVLINK_MSG_ID_HEARTBEAT && message.sysid == _target_sysid && message.compid == _target_compid) {
 			if (connection_timed_out() && !_connected) {
 				_connected = true;
 				LOG(GREEN_TEXT "Connected to autopilot on: %s:%d (with sysid: %d)" NORMAL_TEXT, _serial_node.c_str(), _baudrate, message.sysid);
+
+				// Flush what was queued while disconnected and start watching the outbox
+				if (_event_loop) {
+					drain_outbox();
+
+				} else if (_uring) {
+					uring_flush();
+
+				} else {
+					_message_outbox_queue.wake();
+				}
 			}
 
 			_last_received_heartbeat_ms = millis();
 		}
 
+		if (_low_latency) {
+			record_receive_timing();
+		}
+
 		// Call the message handler callback
-		_parent->handle_message(message);
+		_parent->handle_message(message, read_ns);
+	}
+
+	count_input(length);
+}
+
+void SerialConnection::record_receive_timing()
+{
+	// The frame started in the oldest read that ended after its first byte. Frames spread over more than
+	// SERIAL_READ_TIMES reads are timed from the oldest read remembered.
+	const uint64_t position = _parser.frame_position();
+	uint64_t first_byte_us = _read_times[(_read_count - 1) % SERIAL_READ_TIMES].time_us;
+
+	for (uint64_t i = _read_count; i > 0 && i + SERIAL_READ_TIMES > _read_count; i--) {
+		const ReadTime& read = _read_times[(i - 1) % SERIAL_READ_TIMES];
+
+		if (read.end_position <= position) {
+			break;
+		}
+
+		first_byte_us = read.time_us;
+	}
+
+	const uint64_t elapsed_us = micros() - first_byte_us;
+	_timed_frames.fetch_add(1, std::memory_order_relaxed);
+	_timed_total_us.fetch_add(elapsed_us, std::memory_order_relaxed);
+
+	if (elapsed_us > _timed_max_us.load(std::memory_order_relaxed)) {
+		_timed_max_us.store(elapsed_us, std::memory_order_relaxed);
+	}
+}
+
+bool SerialConnection::setup_uring()
+{
+	_uring = std::make_unique<IoUring>();
+
+	_uring_write_buffer.resize(SERIAL_MAX_FLUSH_FRAMES * MAVLINK_MAX_PACKET_LEN);
+	_uring_write_length = 0;
+
+	// Room for the read, the outbox poll and the writev
+	return _uring->init(4, SERIAL_URING_BUFFER_COUNT, SERIAL_RECEIVE_BUFFER_SIZE);
+}
+
+void SerialConnection::uring_thread_main()
+{
+	LOG("uring_thread_main");
+
+	_uring->read(_fd, UringReceive);
+	_uring_reading = true;
+	_uring->poll_multishot(_message_outbox_queue.fd(), UringOutbox);
+
+	if (_scheduler) {
+		_uring->poll_multishot(_scheduler->fd(), UringScheduler);
+	}
+
+	uint64_t next_tick_ms = millis() + EventLoop::TICK_INTERVAL_MS;
+
+	while (!_should_exit) {
+		// Submits the reposted read and the next writev and waits for completions in the same syscall
+		const uint64_t now = millis();
+		_uring->submit_and_wait(next_tick_ms > now ? int(next_tick_ms - now) : 0);
+		_uring->for_each_completion([this](const io_uring_cqe & cqe) { handle_completion(cqe); });
+
+		if (millis() >= next_tick_ms) {
+			tick();
+			next_tick_ms = millis() + EventLoop::TICK_INTERVAL_MS;
+
+			if (!_uring_reading && !_hung_up) {
+				_uring->read(_fd, UringReceive);
+				_uring_reading = true;
+			}
+		}
+	}
+
+	// Lets the writev in flight finish before the ring is closed
+	for (int i = 0; _uring_writing && i < 10; i++) {
+		_uring->submit_and_wait(EventLoop::TICK_INTERVAL_MS);
+		_uring->for_each_completion([this](const io_uring_cqe & cqe) { handle_completion(cqe); });
+	}
+}
+
+void SerialConnection::uring_flush()
+{
+	if (_uring_writing || _should_exit) {
+		return;
+	}
+
+	_message_outbox_queue.disarm();
+
+	// Frames stay queued until the connection is up, this is called again once it is
+	if (!_connected) {
+		return;
+	}
+
+	do {
+		if (!_uring_write_length) {
+			const size_t count = _message_outbox_queue.peek(_write_frames, SERIAL_MAX_FLUSH_FRAMES);
+
+			for (size_t i = 0; i < count; i++) {
+				memcpy(&_uring_write_buffer[_uring_write_length], _write_frames[i].data, _write_frames[i].length);
+				_uring_write_length += _write_frames[i].length;
+			}
+
+			_message_outbox_queue.release();
+			_uring_write_offset = 0;
+		}
+
+		if (_uring_write_length) {
+			_uring_write_iovec.iov_base = &_uring_write_buffer[_uring_write_offset];
+			_uring_write_iovec.iov_len = _uring_write_length;
+			_uring->writev(_fd, &_uring_write_iovec, 1, UringWrite);
+			_uring_writing = true;
+			return;
+		}
+
+	} while (!_message_outbox_queue.arm());
+}
+
+void SerialConnection::handle_completion(const io_uring_cqe& cqe)
+{
+	switch (cqe.user_data) {
+	case UringReceive: {
+			uint16_t id;
+
+			if (IoUring::buffer_id(cqe, &id)) {
+				if (cqe.res > 0) {
+					handle_bytes(reinterpret_cast<const char*>(_uring->buffer(id)), cqe.res);
+				}
+
+				_uring->recycle_buffer(id);
+			}
+
+			// Blocking reads also return 0 when VTIME runs out, so only EIO tells a hangup apart
+			if (cqe.res == -EIO) {
+				hang_up();
+
+			} else if (cqe.res < 0 && cqe.res != -ENOBUFS) {
+				LOG("read failure: %s", strerror(-cqe.res));
+			}
+
+			// After errors and hangups the next tick retries, instead of spinning on a read that fails right away
+			_uring_reading = (cqe.res > 0 || cqe.res == -ENOBUFS) && !_should_exit;
+
+			if (_uring_reading) {
+				_uring->read(_fd, UringReceive);
+			}
+
+			break;
+		}
+
+	case UringOutbox:
+		uring_flush();
+
+		if (!(cqe.flags & IORING_CQE_F_MORE) && !_should_exit) {
+			_uring->poll_multishot(_message_outbox_queue.fd(), UringOutbox);
+		}
+
+		break;
+
+	case UringScheduler:
+		_scheduler->run();
+
+		if (!(cqe.flags & IORING_CQE_F_MORE) && !_should_exit) {
+			_uring->poll_multishot(_scheduler->fd(), UringScheduler);
+		}
+
+		break;
+
+	case UringWrite: {
+			_uring_writing = false;
+
+			if (cqe.res < 0) {
+				LOG("write failure: %s", strerror(-cqe.res));
+				_uring_write_length = 0;
+				uring_flush();
+				break;
+			}
+
+			// A short write continues where it stopped
+			_uring_write_offset += size_t(cqe.res);
+			_uring_write_length -= size_t(cqe.res);
+			uring_flush();
+			break;
+		}
 	}
 }
 
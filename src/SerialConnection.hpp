@@ -4,6 +4,7 @@
 #include <memory>
 #include <atomic>
 #include <thread>
+#include <vector>
 
 #include <Connection.hpp>
 #include <helpers.hpp>
@@ -18,6 +19,13 @@ namespace mavlink
 {
 
 static constexpr uint64_t SERIAL_CONNECTION_TIMEOUT_MS = 2000;
+static constexpr size_t SERIAL_MAX_READS_PER_EVENT = 16; // Bounded so one busy link cannot starve the others on an event loop thread
+static constexpr size_t SERIAL_MAX_FLUSH_FRAMES = 256; // Frames written per writev() call
+static constexpr int SERIAL_SEND_POLL_TIMEOUT_MS = 100;
+static constexpr size_t SERIAL_RECEIVE_BUFFER_SIZE = 2048; // Enough for MTU 1500 bytes.
+static constexpr size_t SERIAL_URING_BUFFER_COUNT = 16;
+static constexpr uint64_t SERIAL_LOW_LATENCY_BUFFER_MS = 10; // The receive buffer holds this much data at the baud rate in low latency mode
+static constexpr size_t SERIAL_READ_TIMES = 16; // Reads remembered to find the one a frame started in
 
 class Mavlink;
 
@@ -31,7 +39,24 @@ public:
 	ConnectionResult start() override;
 	void stop() override;
 
-	bool send_message(const mavlink_message_t& message) override;
+	bool send_frame(const uint8_t* data, uint16_t length) override;
+	bool flush_outbox() override;
+
+	// Number of write/writev calls
+	uint64_t write_syscalls() const { return _write_syscalls; };
+
+	// Time from the read that returned the first byte of a frame until the frame is dispatched. Low latency mode only.
+	struct ReceiveTiming {
+		uint64_t frames {};
+		uint64_t total_us {};
+		uint64_t max_us {};
+	};
+
+	ReceiveTiming receive_timing() const { return { _timed_frames, _timed_total_us, _timed_max_us }; };
+
+	// EventLoop::Client
+	void handle_events(int fd, uint32_t events) override;
+	void tick() override;
 
 	// Non-copyable
 	SerialConnection(const SerialConnection&) = delete;
@@ -41,8 +66,32 @@ private:
 	ConnectionResult setup_port();
 	void start_recv_thread();
 	void receive_thread_main();
+	void send_thread_main();
 	void receive();
 
+	// Peeks at the outbox and points the iovecs of the next writev at the queued frames. Returns the number of iovecs.
+	size_t prepare_write();
+
+	// Releases the frames of the last prepare_write() that made it out and keeps the rest of a frame cut off by a short write.
+	// Returns false if the write was short.
+	bool release_written(size_t written);
+
+	// Reads once and parses what it got. Returns false if there was nothing to read.
+	bool read_available();
+
+	// The device went away, e.g. an unplugged USB adapter. Stops reading it and takes the link down until stop() and
+	// start() open it again.
+	void hang_up();
+	void handle_bytes(const char* data, size_t length);
+	void record_receive_timing();
+
+	// io_uring mode -- one thread keeps a read posted and writes the outbox with one writev per batch
+	enum UringOperation : uint64_t { UringReceive, UringOutbox, UringWrite, UringScheduler };
+	bool setup_uring();
+	void uring_thread_main();
+	void uring_flush();
+	void handle_completion(const io_uring_cqe& cqe);
+
 #if defined(LINUX)
 	static int define_from_baudrate(int baudrate);
 #endif
@@ -58,8 +107,51 @@ private:
 	HANDLE _handle;
 #endif
 
+	// Queued frames of the next writev, only used by the sending thread
+	Outbox::Frame _write_frames[SERIAL_MAX_FLUSH_FRAMES] {};
+	struct iovec _write_iovecs[SERIAL_MAX_FLUSH_FRAMES] {};
+	size_t _write_frame_count {};
+
+	// Rest of a frame cut off by a short write, it goes out before anything else. Copied out of the outbox, where a
+	// higher class could be queued in front of it.
+	uint8_t _partial_frame[MAVLINK_MAX_PACKET_LEN] {};
+	size_t _partial_length {};
+
+	bool _io_uring {};
+	bool _uring_reading {};
+	bool _uring_writing {}; // A writev is in flight, the next batch is submitted once it completed
+
+	// io_uring writes a copy of the batch. The outbox is released before the writev is submitted, a writev waiting on the
+	// tty would otherwise keep producers from dropping or replacing queued frames.
+	std::vector<uint8_t> _uring_write_buffer {};
+	size_t _uring_write_offset {};
+	size_t _uring_write_length {}; // Not written yet, a short write continues from the offset
+	struct iovec _uring_write_iovec {};
+
+	bool _low_latency {};
+
+	// Persistent receive buffer, sized for the baud rate in low latency mode
+	std::vector<char> _receive_buffer {};
+
+	// Ring of the most recent reads, by the stream offset they ended at, see MessageParser::frame_position()
+	struct ReadTime {
+		uint64_t end_position;
+		uint64_t time_us;
+	};
+
+	ReadTime _read_times[SERIAL_READ_TIMES] {};
+	uint64_t _read_count {};
+	uint64_t _received_bytes {};
+
+	std::atomic<uint64_t> _timed_frames {};
+	std::atomic<uint64_t> _timed_total_us {};
+	std::atomic<uint64_t> _timed_max_us {};
+
 	std::unique_ptr<std::thread> _recv_thread{};
+	std::unique_ptr<std::thread> _send_thread{};
+	std::atomic<uint64_t> _write_syscalls {};
 	std::atomic_bool _should_exit{false};
+	std::atomic_bool _hung_up {false};
 
 	Mavlink* _parent {};
 };
@@ -0,0 +1,337 @@
+#include <StreamScheduler.hpp>
+#include <FrameEncoder.hpp>
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <helpers.hpp>
+
+namespace mavlink
+{
+
+// Target of a message with target fields, 0 otherwise
+static void message_target(const mavlink_message_t& message, uint8_t* target_system, uint8_t* target_component)
+{
+	const mavlink_msg_entry_t* entry = mavlink_get_msg_entry(message.msgid);
+	const uint8_t* payload = reinterpret_cast<const uint8_t*>(_MAV_PAYLOAD(&message));
+
+	*target_system = entry && (entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_SYSTEM) ? payload[entry->target_system_ofs] : 0;
+	*target_component = entry && (entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_COMPONENT) ? payload[entry->target_component_ofs] : 0;
+}
+
+// Keeps the slots of a stream that is on time, one that fell behind by more than a slot starts over
+static uint64_t next_slot(uint64_t slot_us, uint64_t interval_us, uint64_t now_us)
+{
+	return slot_us + interval_us > now_us ? slot_us + interval_us : now_us + interval_us;
+}
+
+StreamScheduler::StreamScheduler(uint32_t budget_bytes_per_second, SendFunction send)
+	: _send(std::move(send))
+	, _budget_bytes_per_second(budget_bytes_per_second)
+	, _budget_tokens(double(MAVLINK_MAX_PACKET_LEN))
+	, _budget_updated_us(micros())
+	, _timer_fd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+{}
+
+StreamScheduler::~StreamScheduler()
+{
+	stop();
+
+	if (_timer_fd >= 0) {
+		close(_timer_fd);
+	}
+}
+
+void StreamScheduler::start(bool own_thread)
+{
+	std::scoped_lock<std::mutex> lock(_mutex);
+	_started = true;
+	_should_exit = false;
+	_own_thread = own_thread;
+
+	if (_own_thread) {
+		start_thread();
+
+	} else {
+		wake_at(micros());
+	}
+}
+
+void StreamScheduler::stop()
+{
+	{
+		std::scoped_lock<std::mutex> lock(_mutex);
+		_started = false;
+		_should_exit = true;
+		_timer_us = UINT64_MAX;
+	}
+
+	_condition.notify_one();
+
+	if (_thread) {
+		_thread->join();
+		_thread.reset();
+	}
+}
+
+void StreamScheduler::start_thread()
+{
+	if (_started && _own_thread && !_thread && (!_streams.empty() || !_tasks.empty())) {
+		_thread = std::make_unique<std::thread>(&StreamScheduler::thread_main, this);
+	}
+}
+
+void StreamScheduler::wake_at(uint64_t at_us)
+{
+	if (_own_thread) {
+		_condition.notify_one();
+		return;
+	}
+
+	if (!_started || at_us >= _timer_us) {
+		return;
+	}
+
+	// A zero expiry would disarm the timer
+	const uint64_t now = micros();
+	const uint64_t delay_us = at_us > now ? at_us - now : 1;
+
+	struct itimerspec spec = {};
+	spec.it_value.tv_sec = time_t(delay_us / 1000000);
+	spec.it_value.tv_nsec = long(delay_us % 1000000) * 1000;
+	timerfd_settime(_timer_fd, 0, &spec, nullptr);
+	_timer_us = at_us;
+}
+
+void StreamScheduler::run()
+{
+	uint64_t expirations;
+	[[maybe_unused]] ssize_t ret = read(_timer_fd, &expirations, sizeof(expirations));
+
+	std::scoped_lock<std::mutex> lock(_mutex);
+
+	if (!_started) {
+		return;
+	}
+
+	_timer_us = UINT64_MAX;
+	const uint64_t wake_us = run_due(micros());
+
+	if (wake_us != UINT64_MAX) {
+		wake_at(wake_us);
+	}
+}
+
+void StreamScheduler::set_rate(uint32_t message_id, uint8_t target_system, uint8_t target_component, float rate_hz)
+{
+	std::scoped_lock<std::mutex> lock(_mutex);
+	const uint64_t stream_key = key(message_id, target_system, target_component);
+
+	if (rate_hz <= 0.f) {
+		_streams.erase(stream_key);
+		_has_streams = !_streams.empty();
+		return;
+	}
+
+	auto [it, inserted] = _streams.try_emplace(stream_key);
+	Stream& stream = it->second;
+	stream.message_id = message_id;
+	stream.target_system = target_system;
+	stream.target_component = target_component;
+	stream.rate_hz = rate_hz;
+	stream.interval_us = std::max<uint64_t>(uint64_t(1e6 / rate_hz), 1);
+
+	if (inserted) {
+		// Golden ratio phases keep the first slots of streams with the same rate apart
+		const double phase = std::fmod(double(_streams.size()) * 0.618034, 1.0);
+		stream.next_us = micros() + uint64_t(phase * double(stream.interval_us));
+	}
+
+	_has_streams = true;
+	start_thread();
+	wake_at(stream.next_us);
+}
+
+bool StreamScheduler::publish(const mavlink_message_t& message, OutboxClass outbox_class)
+{
+	if (!_has_streams.load(std::memory_order_relaxed)) {
+		return false;
+	}
+
+	uint8_t target_system;
+	uint8_t target_component;
+	message_target(message, &target_system, &target_component);
+
+	std::scoped_lock<std::mutex> lock(_mutex);
+	auto it = _streams.find(key(message.msgid, target_system, target_component));
+
+	if (it == _streams.end() && (target_system || target_component)) {
+		it = _streams.find(key(message.msgid, 0, 0));
+	}
+
+	if (it == _streams.end()) {
+		return false;
+	}
+
+	Stream& stream = it->second;
+
+	if (stream.pending) {
+		stream.replaced++;
+
+	} else {
+		// The thread does not wait for idle streams
+		wake_at(stream.next_us);
+	}
+
+	stream.sample = message;
+	stream.outbox_class = outbox_class;
+	stream.pending = true;
+	return true;
+}
+
+size_t StreamScheduler::add_task(uint64_t interval_ms, std::function<bool()> task)
+{
+	std::scoped_lock<std::mutex> lock(_mutex);
+	_tasks.push_back({ .interval_us = interval_ms * 1000, .next_us = micros() + interval_ms * 1000, .run = std::move(task) });
+	start_thread();
+	wake_at(_tasks.back().next_us);
+	return _tasks.size() - 1;
+}
+
+void StreamScheduler::wake_task(size_t id)
+{
+	std::scoped_lock<std::mutex> lock(_mutex);
+
+	if (id >= _tasks.size()) {
+		return;
+	}
+
+	Task& task = _tasks[id];
+
+	if (task.idle) {
+		task.idle = false;
+		task.next_us = micros();
+		wake_at(task.next_us);
+	}
+}
+
+std::vector<StreamCounters> StreamScheduler::counters() const
+{
+	std::scoped_lock<std::mutex> lock(_mutex);
+	std::vector<StreamCounters> counters;
+
+	for (auto& [stream_key, stream] : _streams) {
+		counters.push_back({
+			.message_id = stream.message_id,
+			.target_system = stream.target_system,
+			.target_component = stream.target_component,
+			.rate_hz = stream.rate_hz,
+			.sent = stream.sent,
+			.replaced = stream.replaced,
+		});
+	}
+
+	return counters;
+}
+
+void StreamScheduler::thread_main()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	while (!_should_exit) {
+		const uint64_t wake_us = run_due(micros());
+		const uint64_t now = micros();
+
+		if (wake_us == UINT64_MAX) {
+			_condition.wait(lock);
+
+		} else if (wake_us > now) {
+			_condition.wait_for(lock, std::chrono::microseconds(wake_us - now));
+		}
+	}
+}
+
+uint64_t StreamScheduler::run_due(uint64_t now_us)
+{
+	uint64_t wake_us = UINT64_MAX;
+
+	for (Task& task : _tasks) {
+		if (task.idle) {
+			continue;
+		}
+
+		if (now_us >= task.next_us) {
+			task.idle = !task.run();
+			task.next_us = next_slot(task.next_us, task.interval_us, now_us);
+		}
+
+		if (!task.idle) {
+			wake_us = std::min(wake_us, task.next_us);
+		}
+	}
+
+	_due.clear();
+
+	for (auto& [stream_key, stream] : _streams) {
+		if (!stream.pending) {
+			continue;
+		}
+
+		if (stream.next_us <= now_us) {
+			_due.push_back(&stream);
+
+		} else {
+			wake_us = std::min(wake_us, stream.next_us);
+		}
+	}
+
+	// Most overdue first
+	std::sort(_due.begin(), _due.end(), [](const Stream * a, const Stream * b) { return a->next_us < b->next_us; });
+
+	for (Stream* stream : _due) {
+		const uint16_t length = frame_length(stream->sample);
+
+		if (!spend_budget(now_us, length)) {
+			// The rest waits until the budget refilled enough for this one
+			const double missing = double(length) - _budget_tokens;
+			wake_us = std::min(wake_us, now_us + uint64_t(missing * 1e6 / double(_budget_bytes_per_second)) + 1);
+			break;
+		}
+
+		if (!_send(stream->sample, stream->outbox_class)) {
+			stream->next_us = now_us + stream->interval_us;
+			wake_us = std::min(wake_us, stream->next_us);
+			continue;
+		}
+
+		stream->pending = false;
+		stream->sent++;
+
+		stream->next_us = next_slot(stream->next_us, stream->interval_us, now_us);
+	}
+
+	return wake_us;
+}
+
+bool StreamScheduler::spend_budget(uint64_t now_us, size_t bytes)
+{
+	if (!_budget_bytes_per_second) {
+		return true;
+	}
+
+	const double burst = std::max(double(_budget_bytes_per_second) * STREAM_BUDGET_BURST_MS / 1000, double(MAVLINK_MAX_PACKET_LEN));
+	_budget_tokens = std::min(burst, _budget_tokens + double(now_us - _budget_updated_us) * double(_budget_bytes_per_second) / 1e6);
+	_budget_updated_us = now_us;
+
+	if (_budget_tokens < double(bytes)) {
+		return false;
+	}
+
+	_budget_tokens -= double(bytes);
+	return true;
+}
+
+} // end namespace mavlink
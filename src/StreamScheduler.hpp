@@ -0,0 +1,121 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <Mavlink.hpp>
+
+namespace mavlink
+{
+
+static constexpr uint64_t STREAM_BUDGET_BURST_MS = 50; // Budget that can build up while the streams are idle
+
+// Sends the newest sample of each rate-limited stream at its rate from a timer thread.
+// A stream is a message ID, optionally for a single target. A new sample replaces the one not sent yet. A sample that
+// arrives after its slot passed goes out right away, the next one waits for the following slot. Streams start at
+// staggered phases, and with a link budget the most overdue stream goes first once the budget allows.
+// The thread only runs while there are streams or periodic tasks. Event loop and io_uring connections run the scheduler
+// on their own thread instead, they watch fd() and call run().
+class StreamScheduler
+{
+public:
+	// 'send' returns false if the sample could not be sent, it is retried at the next slot
+	using SendFunction = std::function<bool(const mavlink_message_t&, OutboxClass)>;
+
+	StreamScheduler(uint32_t budget_bytes_per_second, SendFunction send);
+	~StreamScheduler();
+
+	// Without 'own_thread' the caller watches fd() and calls run()
+	void start(bool own_thread);
+	void stop();
+
+	// Timer, readable once something is due
+	int fd() const { return _timer_fd; };
+
+	// Sends what is due and sets the timer for the next time
+	void run();
+
+	// A rate of 0 removes the stream. Safe to call from any thread.
+	void set_rate(uint32_t message_id, uint8_t target_system, uint8_t target_component, float rate_hz);
+
+	// Keeps 'message' as the next sample of its stream. Returns false if it has no stream. Safe to call from any thread.
+	bool publish(const mavlink_message_t& message, OutboxClass outbox_class);
+
+	// Calls 'task' every 'interval_ms' on the scheduler thread for as long as it returns true. After it returned false it
+	// waits for wake_task(). Returns the ID for wake_task().
+	size_t add_task(uint64_t interval_ms, std::function<bool()> task);
+
+	// Runs an idle task again at its interval, ignores IDs add_task() did not return. Safe to call from any thread, except from a task.
+	void wake_task(size_t id);
+
+	std::vector<StreamCounters> counters() const;
+
+private:
+	struct Stream {
+		uint32_t message_id {};
+		uint8_t target_system {};
+		uint8_t target_component {};
+		float rate_hz {};
+		uint64_t interval_us {};
+		uint64_t next_us {};
+		bool pending {};
+		mavlink_message_t sample {};
+		OutboxClass outbox_class {};
+		uint64_t sent {};
+		uint64_t replaced {};
+	};
+
+	struct Task {
+		uint64_t interval_us {};
+		uint64_t next_us {};
+		std::function<bool()> run {};
+		bool idle {};
+	};
+
+	static uint64_t key(uint32_t message_id, uint8_t target_system, uint8_t target_component)
+	{
+		return (uint64_t(message_id) << 16) | (uint64_t(target_system) << 8) | target_component;
+	};
+
+	void thread_main();
+
+	// Sends what is due. Returns the time the thread has to wake up again. Called with the mutex held.
+	uint64_t run_due(uint64_t now_us);
+
+	bool spend_budget(uint64_t now_us, size_t bytes);
+
+	// Starts the thread if there is something to do
+	void start_thread();
+
+	// Has the thread or the timer look at the streams and tasks again by 'at_us'. Called with the mutex held.
+	void wake_at(uint64_t at_us);
+
+	SendFunction _send {};
+
+	mutable std::mutex _mutex {};
+	std::condition_variable _condition {};
+	std::unordered_map<uint64_t, Stream> _streams {};
+	std::vector<Task> _tasks {};
+	std::vector<Stream*> _due {};
+	std::atomic<bool> _has_streams {};
+
+	// Token bucket in bytes, unlimited if the budget is 0
+	uint64_t _budget_bytes_per_second {};
+	double _budget_tokens {};
+	uint64_t _budget_updated_us {};
+
+	bool _started {};
+	bool _should_exit {};
+	bool _own_thread {true};
+	std::unique_ptr<std::thread> _thread {};
+
+	int _timer_fd {-1};
+	uint64_t _timer_us {UINT64_MAX}; // Expiry the timer is set to
+};
+
+} // end namespace mavlink
@@ -0,0 +1,247 @@
+#include <TlogRecorder.hpp>
+
+#include <endian.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <chrono>
+#include <cstring>
+
+#include <helpers.hpp>
+
+namespace mavlink
+{
+
+TlogRecorder::TlogRecorder(std::string path, uint64_t rotate_bytes)
+	: _path(std::move(path))
+	, _rotate_bytes(rotate_bytes)
+	, _queue(TLOG_QUEUE_SIZE_BYTES)
+{}
+
+TlogRecorder::~TlogRecorder()
+{
+	stop();
+}
+
+bool TlogRecorder::start()
+{
+	if (_thread) {
+		return true;
+	}
+
+	if (!open_file()) {
+		return false;
+	}
+
+	_should_exit = false;
+	_thread = std::make_unique<std::thread>(&TlogRecorder::thread_main, this);
+	return true;
+}
+
+void TlogRecorder::stop()
+{
+	if (!_thread) {
+		return;
+	}
+
+	// The thread writes out what is queued before it exits
+	_should_exit = true;
+	_queue.wake();
+	_thread->join();
+	_thread.reset();
+
+	close_file();
+}
+
+void TlogRecorder::record(const uint8_t* frame, size_t length)
+{
+	// Queued as the record goes into the file, the writer copies it in one piece
+	const uint64_t timestamp_us = htobe64(std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::system_clock::now().time_since_epoch()).count());
+
+	const bool queued = _queue.push(uint16_t(sizeof(timestamp_us) + length), [&](uint8_t* buffer) {
+		memcpy(buffer, &timestamp_us, sizeof(timestamp_us));
+		memcpy(buffer + sizeof(timestamp_us), frame, length);
+	});
+
+	if (!queued) {
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+TlogCounters TlogRecorder::counters() const
+{
+	return {
+		.recorded = _recorded.load(std::memory_order_relaxed),
+		.dropped = _dropped.load(std::memory_order_relaxed),
+		.bytes = _bytes.load(std::memory_order_relaxed),
+		.files = _files.load(std::memory_order_relaxed)
+	};
+}
+
+void TlogRecorder::thread_main()
+{
+	FrameQueue::Frame frames[TLOG_WRITE_BATCH];
+
+	for (;;) {
+		const bool exiting = _should_exit;
+		const size_t count = _queue.peek(frames, TLOG_WRITE_BATCH);
+
+		for (size_t i = 0; i < count; i++) {
+			const size_t record_length = frames[i].length;
+
+			// Records never span two files
+			if (_rotate_bytes && _file_bytes && _file_bytes + record_length > _rotate_bytes) {
+				close_file();
+				_file_index++;
+
+				if (!open_file()) {
+					_dropped.fetch_add(count - i, std::memory_order_relaxed);
+					break;
+				}
+			}
+
+			if (_fd < 0 || !write(frames[i].data, record_length)) {
+				_dropped.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+
+			_recorded.fetch_add(1, std::memory_order_relaxed);
+			_bytes.fetch_add(record_length, std::memory_order_relaxed);
+		}
+
+		if (count) {
+			_queue.release();
+			continue;
+		}
+
+		// Only leave once the queue was seen empty after the exit request
+		if (exiting) {
+			break;
+		}
+
+		_queue.wait();
+	}
+}
+
+std::string TlogRecorder::file_path(uint32_t index) const
+{
+	std::string path = _path;
+
+	if (index) {
+		// flight.tlog, flight.1.tlog, flight.2.tlog ...
+		const size_t slash = path.rfind('/');
+		const size_t dot = path.rfind('.');
+		const bool has_extension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+		path.insert(has_extension ? dot : path.size(), "." + std::to_string(index));
+	}
+
+	return path;
+}
+
+bool TlogRecorder::open_file()
+{
+	// Files of an earlier start() or run are never overwritten, the recording goes on in the next free number
+	for (;; _file_index++) {
+		const std::string path = file_path(_file_index);
+		_fd = open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+
+		if (_fd >= 0) {
+			break;
+		}
+
+		if (errno != EEXIST) {
+			LOG(RED_TEXT "Failed to open tlog %s: %s" NORMAL_TEXT, path.c_str(), strerror(errno));
+			return false;
+		}
+	}
+
+	_file_bytes = 0;
+	_files.fetch_add(1, std::memory_order_relaxed);
+
+	if (!map_chunk()) {
+		close(_fd);
+		_fd = -1;
+		return false;
+	}
+
+	return true;
+}
+
+void TlogRecorder::close_file()
+{
+	if (_fd < 0) {
+		return;
+	}
+
+	if (_chunk) {
+		msync(_chunk, TLOG_CHUNK_BYTES, MS_SYNC);
+		munmap(_chunk, TLOG_CHUNK_BYTES);
+		_chunk = nullptr;
+	}
+
+	// Cut off the preallocated rest, then make sure the chunks unmapped earlier are on disk as well
+	if (ftruncate(_fd, _file_bytes) != 0 || fsync(_fd) != 0) {
+		LOG(RED_TEXT "Failed to finish tlog: %s" NORMAL_TEXT, strerror(errno));
+	}
+
+	close(_fd);
+	_fd = -1;
+	_file_bytes = 0;
+}
+
+bool TlogRecorder::map_chunk()
+{
+	if (_chunk) {
+		munmap(_chunk, TLOG_CHUNK_BYTES);
+		_chunk = nullptr;
+	}
+
+	_chunk_offset = _file_bytes - _file_bytes % TLOG_CHUNK_BYTES;
+
+	// Allocating the blocks up front keeps page faults from running into a full disk
+	const int result = posix_fallocate(_fd, _chunk_offset, TLOG_CHUNK_BYTES);
+
+	if (result != 0) {
+		LOG(RED_TEXT "Failed to grow tlog: %s" NORMAL_TEXT, strerror(result));
+		return false;
+	}
+
+	void* chunk = mmap(nullptr, TLOG_CHUNK_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, _chunk_offset);
+
+	if (chunk == MAP_FAILED) {
+		LOG(RED_TEXT "Failed to map tlog: %s" NORMAL_TEXT, strerror(errno));
+		return false;
+	}
+
+	madvise(chunk, TLOG_CHUNK_BYTES, MADV_SEQUENTIAL);
+	_chunk = static_cast<uint8_t*>(chunk);
+	return true;
+}
+
+bool TlogRecorder::write(const uint8_t* data, size_t length)
+{
+	const uint64_t start = _file_bytes;
+
+	while (length) {
+		if (!_chunk || _file_bytes == _chunk_offset + TLOG_CHUNK_BYTES) {
+			if (!map_chunk()) {
+				// Takes back the part that made it in, a torn record would garble every record after it
+				_file_bytes = start;
+				return false;
+			}
+		}
+
+		const size_t offset = _file_bytes - _chunk_offset;
+		const size_t take = std::min(length, TLOG_CHUNK_BYTES - offset);
+		memcpy(_chunk + offset, data, take);
+		_file_bytes += take;
+		data += take;
+		length -= take;
+	}
+
+	return true;
+}
+
+} // end namespace mavlink
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <FrameQueue.hpp>
+#include <Mavlink.hpp>
+
+namespace mavlink
+{
+
+static constexpr size_t TLOG_QUEUE_SIZE_BYTES = 1 << 20; // Frames in flight to the writer thread
+static constexpr size_t TLOG_CHUNK_BYTES = 16 << 20;     // The file grows and is mapped in chunks of this size
+static constexpr size_t TLOG_WRITE_BATCH = 64;           // Frames taken from the queue at once
+
+// Records frames in the tlog format, a big endian microsecond UNIX timestamp followed by the wire bytes of the frame.
+// Connection threads copy the frame into a lock-free queue and never touch the file. A writer thread copies the frames
+// into a shared mapping of the file, which is preallocated and mapped one chunk at a time. Files are rotated once
+// they reach the rotation size, the first one keeps the configured path and the following ones get a number before the
+// extension. Existing files are skipped, so a restart or a second run continues in the next number instead of overwriting
+// a recording. stop() records everything queued, syncs the file and truncates it to its content.
+class TlogRecorder
+{
+public:
+	// A rotation size of 0 never rotates
+	TlogRecorder(std::string path, uint64_t rotate_bytes);
+	~TlogRecorder();
+
+	// Opens the first file and starts the writer thread
+	bool start();
+	void stop();
+
+	// Never blocks, drops the frame if the writer fell behind. Safe to call from any thread.
+	void record(const uint8_t* frame, size_t length);
+
+	TlogCounters counters() const;
+
+private:
+	void thread_main();
+
+	// Path of the file with 'index', the first one has none
+	std::string file_path(uint32_t index) const;
+
+	// Opens the first file from _file_index on that does not exist yet
+	bool open_file();
+	void close_file();
+
+	// Maps the chunk holding _file_bytes, growing the file if needed
+	bool map_chunk();
+
+	// Writes all of 'data' or nothing
+	bool write(const uint8_t* data, size_t length);
+
+	std::string _path {};
+	uint64_t _rotate_bytes {};
+
+	FrameQueue _queue;
+
+	// Writer thread only
+	int _fd {-1};
+	uint32_t _file_index {};
+	uint64_t _file_bytes {};   // Written to the current file
+	uint8_t* _chunk {};        // Mapping of the chunk at _chunk_offset
+	uint64_t _chunk_offset {};
+
+	std::atomic<uint64_t> _recorded {};
+	std::atomic<uint64_t> _dropped {};
+	std::atomic<uint64_t> _bytes {};
+	std::atomic<uint32_t> _files {};
+
+	std::atomic<bool> _should_exit {};
+	std::unique_ptr<std::thread> _thread {};
+};
+
+} // end namespace mavlink
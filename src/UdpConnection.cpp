@@ -1,25 +1,35 @@
 #include "UdpConnection.hpp"
-#include "MessageParser.hpp"
 #include "Mavlink.hpp"
+#include "StreamScheduler.hpp"
 
+#include <fcntl.h>
 #include <unistd.h>
+#include <sys/epoll.h>
 
 #include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
 
 namespace mavlink
 {
 
 UdpConnection::UdpConnection(Mavlink* parent)
-	: Connection(UDP_CONNECTION_TIMEOUT_MS)
+	: Connection(UDP_CONNECTION_TIMEOUT_MS, parent->settings())
 	, _parent(parent)
 {
 	const ConfigurationSettings& settings = _parent->settings();
 
 	// Parse connection string
 	std::string conn = settings.connection_url;
-	std::string udp = "udp:";
+	const bool udpout = conn.find("udpout:") != std::string::npos;
+	std::string udp = udpout ? "udpout:" : "udp:";
 	conn.erase(conn.find(udp), udp.length());
+
+	if (conn.starts_with("//")) {
+		conn.erase(0, 2);
+	}
+
 	size_t index = conn.find(':');
 	std::string ip = conn.substr(0, index);
 	conn.erase(0, index + 1);
@@ -27,21 +37,82 @@ UdpConnection::UdpConnection(Mavlink* parent)
 
 	// TODO: error handling for malformed connection string
 
-	_our_ip = ip;
-	_our_port = port;
-	_emit_heartbeat = settings.emit_heartbeat;
+	if (udpout) {
+		// Sends to the given address from an ephemeral port, heartbeats go out before the remote answers
+		_our_ip = "0.0.0.0";
+		_our_port = 0;
+		_remote_ip = ip;
+		_remote_port = port;
+		_remote_addr.sin_family = AF_INET;
+		_remote_addr.sin_port = htons(port);
+		_remote_known = inet_pton(AF_INET, ip.c_str(), &_remote_addr.sin_addr) == 1;
+
+		if (!_remote_known) {
+			LOG(RED_TEXT "Invalid udpout address: %s" NORMAL_TEXT, ip.c_str());
+			_url_valid = false;
+		}
+
+	} else {
+		_our_ip = ip;
+		_our_port = port;
+	}
+
 	_target_sysid = settings.target_sysid;
 	_target_compid = settings.target_compid;
+	_receive_batch_size = std::min<size_t>(settings.udp_receive_batch_size, UDP_MAX_RECEIVE_BATCH_SIZE);
+	_send_batch_size = std::min<size_t>(settings.udp_send_batch_size, UDP_MAX_SEND_BATCH_SIZE);
+	_event_loop = settings.event_loop;
+
+	// The event loop takes precedence
+	_io_uring = settings.io_uring && !_event_loop;
 }
 
 ConnectionResult UdpConnection::start()
 {
+	if (!_url_valid) {
+		return ConnectionResult::ConnectionUrlInvalid;
+	}
+
+	// Before the port, setup_port() sizes the send batch for io_uring
+	if (_io_uring && !setup_uring()) {
+		LOG("[UdpConnection] io_uring not supported, falling back to the receive and send threads");
+		_uring.reset();
+	}
+
 	auto result = setup_port();
 
 	if (result != ConnectionResult::Success) {
+		_uring.reset();
 		return result;
 	}
 
+	if (_event_loop) {
+		// The loop only reads once the socket is readable, and must never block in a send
+		fcntl(_socket_fd, F_SETFL, fcntl(_socket_fd, F_GETFL) | O_NONBLOCK);
+
+		_event_loop->attach(this);
+		_event_loop->watch(this, _socket_fd, EPOLLIN);
+		_event_loop->watch(this, _message_outbox_queue.fd(), EPOLLIN);
+
+		if (_scheduler) {
+			_event_loop->watch(this, _scheduler->fd(), EPOLLIN);
+			_runs_scheduler = true;
+		}
+
+		// A udpout:// remote is sent to before it answers, the loop thread starts flushing on this wakeup
+		if (_remote_known) {
+			_message_outbox_queue.wake();
+		}
+
+		return ConnectionResult::Success;
+	}
+
+	if (_uring) {
+		_runs_scheduler = _scheduler != nullptr;
+		_recv_thread = std::make_unique<std::thread>(&UdpConnection::uring_thread_main, this);
+		return ConnectionResult::Success;
+	}
+
 	_recv_thread = std::make_unique<std::thread>(&UdpConnection::receive_thread_main, this);
 	_send_thread = std::make_unique<std::thread>(&UdpConnection::send_thread_main, this);
 
@@ -52,14 +123,36 @@ void UdpConnection::stop()
 {
 	_should_exit = true;
 
+	if (_event_loop && _socket_fd >= 0) {
+		// No callbacks run once detached
+		_event_loop->detach(this);
+		close(_socket_fd);
+		_socket_fd = -1;
+		_message_outbox_queue.clear();
+	}
+
 	// Close socket and wait for receiving thread
-	shutdown(_socket_fd, SHUT_RDWR);
-	close(_socket_fd);
-	_recv_thread->join();
+	if (_recv_thread) {
+		shutdown(_socket_fd, SHUT_RDWR);
+		close(_socket_fd);
+		_message_outbox_queue.wake(); // The io_uring thread also wakes up on the outbox
+		_recv_thread->join();
+		_recv_thread.reset();
+	}
 
-	// Clear outbox and wake up sending thread
-	_message_outbox_queue.clear();
-	_send_thread->join();
+	if (_uring) {
+		_message_outbox_queue.clear();
+		_uring.reset();
+	}
+
+	// Wake up sending thread and clear outbox
+	if (_send_thread) {
+		_connected_notifier.notify();
+		_message_outbox_queue.wake();
+		_send_thread->join();
+		_send_thread.reset();
+		_message_outbox_queue.clear();
+	}
 }
 
 ConnectionResult UdpConnection::setup_port()
@@ -85,47 +178,324 @@ ConnectionResult UdpConnection::setup_port()
 		return ConnectionResult::BindError;
 	}
 
+	// The kernel stamps each datagram as it arrives, read_time() takes over if it does not
+	if (_timestamps) {
+		const int enable = 1;
+
+		if (setsockopt(_socket_fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) != 0) {
+			LOG("SO_TIMESTAMPNS not supported: %s", strerror(errno));
+		}
+	}
+
+	if (_receive_batch_size > 1) {
+		_batch_buffers.resize(_receive_batch_size * UDP_RECEIVE_BUFFER_SIZE);
+		_batch_iovecs.resize(_receive_batch_size);
+		_batch_addrs.resize(_receive_batch_size);
+		_batch_msgs.resize(_receive_batch_size);
+
+		for (size_t i = 0; i < _receive_batch_size; i++) {
+			_batch_iovecs[i].iov_base = &_batch_buffers[i * UDP_RECEIVE_BUFFER_SIZE];
+			_batch_iovecs[i].iov_len = UDP_RECEIVE_BUFFER_SIZE;
+			_batch_msgs[i].msg_hdr.msg_iov = &_batch_iovecs[i];
+			_batch_msgs[i].msg_hdr.msg_iovlen = 1;
+			_batch_msgs[i].msg_hdr.msg_name = &_batch_addrs[i];
+		}
+
+		if (_timestamps) {
+			_batch_controls.resize(_receive_batch_size * UDP_CONTROL_BUFFER_SIZE);
+
+			for (size_t i = 0; i < _receive_batch_size; i++) {
+				_batch_msgs[i].msg_hdr.msg_control = &_batch_controls[i * UDP_CONTROL_BUFFER_SIZE];
+			}
+		}
+	}
+
+	_send_frames.resize(std::max<size_t>(_send_batch_size, 1));
+
+	if (_send_batch_size > 1) {
+		_send_iovecs.resize(_send_batch_size);
+		_send_msgs.resize(_send_batch_size);
+
+		for (size_t i = 0; i < _send_batch_size; i++) {
+			_send_msgs[i].msg_hdr.msg_iov = &_send_iovecs[i];
+			_send_msgs[i].msg_hdr.msg_iovlen = 1;
+			_send_msgs[i].msg_hdr.msg_name = &_remote_addr;
+			_send_msgs[i].msg_hdr.msg_namelen = sizeof(_remote_addr);
+		}
+	}
+
 	_initialized = true;
 
 	return ConnectionResult::Success;
 }
 
-bool UdpConnection::send_message(const mavlink_message_t& message)
+bool UdpConnection::send_frame(const uint8_t* data, uint16_t length)
 {
-	// LOG("[UdpConnection] sending message %u", message.msgid);
-	struct sockaddr_in dest_addr {};
-	dest_addr.sin_family = AF_INET;
+	const auto send_len = sendto(_socket_fd, data, length, 0, reinterpret_cast<const sockaddr*>(&_remote_addr), sizeof(_remote_addr));
+
+	return send_len == length;
+}
 
-	inet_pton(AF_INET, _remote_ip.c_str(), &dest_addr.sin_addr.s_addr);
-	dest_addr.sin_port = htons(_remote_port);
+bool UdpConnection::flush_outbox()
+{
+	bool success = true;
+	bool blocked = false;
+	size_t count = _message_outbox_queue.peek(_send_frames.data(), _send_frames.size());
+	size_t sent = 0;
+
+	if (_send_batch_size > 1) {
+		// Point the iovecs straight at the queued frames
+		for (size_t i = 0; i < count; i++) {
+			_send_iovecs[i].iov_base = const_cast<uint8_t*>(_send_frames[i].data);
+			_send_iovecs[i].iov_len = _send_frames[i].length;
+		}
 
-	uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
-	uint16_t buffer_len = mavlink_msg_to_send_buffer(buffer, &message);
+		while (sent < count) {
+			const int result = sendmmsg(_socket_fd, &_send_msgs[sent], count - sent, 0);
 
-	const auto send_len = sendto(_socket_fd, reinterpret_cast<char*>(buffer), buffer_len,
-				     0, reinterpret_cast<const sockaddr*>(&dest_addr), sizeof(dest_addr));
+			if (result <= 0) {
+				blocked = errno == EAGAIN || errno == EWOULDBLOCK;
+				success = blocked;
+				break;
+			}
 
-	return send_len == buffer_len;
+			sent += result;
+		}
+
+	} else {
+		for (; sent < count; sent++) {
+			if (!send_frame(_send_frames[sent].data, _send_frames[sent].length)) {
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					blocked = true;
+					break;
+				}
+
+				success = false;
+			}
+		}
+	}
+
+	if (blocked) {
+		// Only happens on the non-blocking socket of the event loop, the rest goes out once the socket is writable
+		_message_outbox_queue.release(sent);
+		set_send_blocked(_socket_fd, true);
+		return success;
+	}
+
+	_message_outbox_queue.release();
+
+	return success;
 }
 
-void UdpConnection::send_thread_main()
+void UdpConnection::handle_events(int fd, uint32_t events)
 {
-	LOG("[UdpConnection] Starting sending thread");
+	if (fd == _message_outbox_queue.fd()) {
+		drain_outbox();
+		return;
+	}
+
+	if (_scheduler && fd == _scheduler->fd()) {
+		_scheduler->run();
+		return;
+	}
+
+	if (events & EPOLLOUT) {
+		set_send_blocked(_socket_fd, false);
+		drain_outbox();
+	}
+
+	if (events & (EPOLLIN | EPOLLERR)) {
+		for (size_t i = 0; i < UDP_MAX_READS_PER_EVENT; i++) {
+			if (!(_receive_batch_size > 1 ? receive_batch() : receive())) {
+				break;
+			}
+		}
+	}
+}
+
+void UdpConnection::tick()
+{
+	if (_connected && connection_timed_out()) {
+		LOG(RED_TEXT "Connection timed out" NORMAL_TEXT);
+		_connected = false;
+	}
+}
+
+bool UdpConnection::setup_uring()
+{
+	if (!IoUring::recvmsg_multishot_supported()) {
+		return false;
+	}
+
+	_uring = std::make_unique<IoUring>();
+
+	// Room for the receive, the outbox poll and a full batch of sends. The sends go through the msghdrs prepared for
+	// sendmmsg().
+	const size_t send_batch_size = std::max(_send_batch_size, UDP_URING_SEND_BATCH_SIZE);
+	const size_t control_size = _timestamps ? UDP_CONTROL_BUFFER_SIZE : 0;
+	const size_t buffer_size = sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_in) + control_size + UDP_RECEIVE_BUFFER_SIZE;
+
+	if (!_uring->init(send_batch_size + 2, UDP_URING_BUFFER_COUNT, buffer_size)) {
+		return false;
+	}
+
+	_send_batch_size = send_batch_size;
+	_uring_receive_msg.msg_namelen = sizeof(sockaddr_in);
+	_uring_receive_msg.msg_controllen = control_size;
+	return true;
+}
+
+void UdpConnection::uring_thread_main()
+{
+	LOG("[UdpConnection] Starting io_uring thread");
+
+	_uring->recvmsg_multishot(_socket_fd, &_uring_receive_msg, UringReceive);
+	_uring->poll_multishot(_message_outbox_queue.fd(), UringOutbox);
+
+	if (_scheduler) {
+		_uring->poll_multishot(_scheduler->fd(), UringScheduler);
+	}
+
+	// A udpout:// remote is sent to before it answers
+	if (_remote_known) {
+		uring_flush();
+	}
+
+	uint64_t next_tick_ms = millis() + EventLoop::TICK_INTERVAL_MS;
 
 	while (!_should_exit) {
-		if (_initialized && _connected) {
+		// Submits the sends queued by the last round of completions and waits for the next ones in the same syscall
+		const uint64_t now = millis();
+		_uring->submit_and_wait(next_tick_ms > now ? int(next_tick_ms - now) : 0);
+		_uring->for_each_completion([this](const io_uring_cqe & cqe) { handle_completion(cqe); });
+
+		if (millis() >= next_tick_ms) {
+			tick();
+			next_tick_ms = millis() + EventLoop::TICK_INTERVAL_MS;
+		}
+	}
 
-			std::optional<mavlink_message_t> message = _message_outbox_queue.pop_front(/* blocking */ true);
+	// The sends in flight point into the outbox, which is cleared once this thread is gone
+	for (int i = 0; _uring_sends && i < 10; i++) {
+		_uring->submit_and_wait(EventLoop::TICK_INTERVAL_MS);
+		_uring->for_each_completion([this](const io_uring_cqe & cqe) { handle_completion(cqe); });
+	}
+
+	LOG("[UdpConnection] Exiting io_uring thread");
+}
+
+void UdpConnection::uring_flush()
+{
+	// One batch is in flight at a time, the next one is submitted once it completed. The batch holds the outbox until
+	// then, UDP sends do not wait on the peer and normally complete within the io_uring_enter() that submitted them.
+	if (_uring_sends || _should_exit) {
+		return;
+	}
+
+	_message_outbox_queue.disarm();
+
+	// Frames stay queued until the connection is up, this is called again once it is
+	if (!(_connected || _remote_known)) {
+		return;
+	}
+
+	do {
+		const size_t count = _message_outbox_queue.peek(_send_frames.data(), _send_frames.size());
+
+		if (count) {
+			for (size_t i = 0; i < count; i++) {
+				_send_iovecs[i].iov_base = const_cast<uint8_t*>(_send_frames[i].data);
+				_send_iovecs[i].iov_len = _send_frames[i].length;
+				_uring->sendmsg(_socket_fd, &_send_msgs[i].msg_hdr, UringSend);
+			}
+
+			_uring_sends = count;
+			return;
+		}
+
+	} while (!_message_outbox_queue.arm());
+}
+
+void UdpConnection::handle_completion(const io_uring_cqe& cqe)
+{
+	switch (cqe.user_data) {
+	case UringReceive: {
+			struct sockaddr_in src_addr = {};
+			struct msghdr control = {};
+			size_t length = 0;
+			const ReadTime read = read_time();
+			const uint8_t* datagram = _uring->recvmsg_payload(cqe, _uring_receive_msg, &src_addr, &length, &control);
+
+			if (datagram) {
+				handle_datagram(reinterpret_cast<const char*>(datagram), length, src_addr, datagram_received_ns(&control, read));
+			}
+
+			uint16_t id;
+
+			if (IoUring::buffer_id(cqe, &id)) {
+				_uring->recycle_buffer(id);
+			}
+
+			// The kernel ends a multishot receive when it runs out of buffers or on socket errors, repost it unless
+			// the kernel does not support it at all
+			if (!(cqe.flags & IORING_CQE_F_MORE) && !_should_exit) {
+				if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP) {
+					LOG(RED_TEXT "[UdpConnection] io_uring multishot receive failed: %s" NORMAL_TEXT, strerror(-cqe.res));
 
-			if (message) {
-				if (!send_message(message.value())) {
-					LOG(RED_TEXT "Send message failed!" NORMAL_TEXT);
+				} else {
+					_uring->recvmsg_multishot(_socket_fd, &_uring_receive_msg, UringReceive);
 				}
 			}
 
+			break;
+		}
+
+	case UringOutbox:
+		uring_flush();
+
+		if (!(cqe.flags & IORING_CQE_F_MORE) && !_should_exit) {
+			_uring->poll_multishot(_message_outbox_queue.fd(), UringOutbox);
+		}
+
+		break;
+
+	case UringScheduler:
+		_scheduler->run();
+
+		if (!(cqe.flags & IORING_CQE_F_MORE) && !_should_exit) {
+			_uring->poll_multishot(_scheduler->fd(), UringScheduler);
+		}
+
+		break;
+
+	case UringSend:
+		if (cqe.res < 0) {
+			LOG(RED_TEXT "Send message failed!" NORMAL_TEXT);
+		}
+
+		if (--_uring_sends == 0) {
+			_message_outbox_queue.release();
+			uring_flush();
+		}
+
+		break;
+	}
+}
+
+void UdpConnection::send_thread_main()
+{
+	LOG("[UdpConnection] Starting sending thread");
+
+	while (!_should_exit) {
+		if (_initialized && (_connected || _remote_known)) {
+
+			if (_message_outbox_queue.wait() && !flush_outbox()) {
+				LOG(RED_TEXT "Send message failed!" NORMAL_TEXT);
+			}
+
 		} else {
-			LOG("[UdpConnection] waiting for connection");
-			std::this_thread::sleep_for(std::chrono::seconds(1));
+			// Woken by the first heartbeat, the timeout only covers a port that is still being set up
+			_connected_notifier.wait(UDP_CONNECT_WAIT_TIMEOUT_MS);
 		}
 	}
 
@@ -142,76 +512,165 @@ void UdpConnection::receive_thread_main()
 			setup_port();
 
 		} else {
-			receive(); // Note: this blocks when not receiving any data
+			// Note: this blocks when not receiving any data
+			if (_receive_batch_size > 1) {
+				receive_batch();
 
-			if (_connected && connection_timed_out()) {
-				LOG(RED_TEXT "Connection timed out" NORMAL_TEXT);
-				_connected = false;
+			} else {
+				receive();
 			}
 
-			// Check if it's time to send a heartbeat. Only send heartbeats if we're still connected to an autopilot
-			if (_connected && _emit_heartbeat) {
-				auto now = millis();
-
-				if (now > _last_sent_heartbeat_ms + Connection::HEARTBEAT_INTERVAL_MS) {
-					_parent->send_heartbeat();
-					_last_sent_heartbeat_ms = now;
-				}
-			}
+			tick();
 		}
 	}
 
 	LOG("[UdpConnection] Exiting receive thread");
 }
 
-void UdpConnection::receive()
+bool UdpConnection::receive()
 {
 	struct sockaddr_in src_addr = {};
-	socklen_t src_addr_len = sizeof(src_addr);
+	struct iovec iov = { _receive_buffer, sizeof(_receive_buffer) };
+	struct msghdr msg = {};
+	msg.msg_name = &src_addr;
+	msg.msg_namelen = sizeof(src_addr);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if (_timestamps) {
+		msg.msg_control = _receive_control;
+		msg.msg_controllen = sizeof(_receive_control);
+	}
 
 	// NOTE: This function blocks -- thus during destruction we call shutdown/close on the socket before joining the thread
 	// TODO: this isn't actually returning if there's no data coming in
-	// We need to find a way to signal to the thread to unblock from recvfrom
-	const ssize_t recv_len = recvfrom(
-					 _socket_fd,
-					 _receive_buffer,
-					 sizeof(_receive_buffer),
-					 0,
-					 reinterpret_cast<struct sockaddr*>(&src_addr),
-					 &src_addr_len);
+	// We need to find a way to signal to the thread to unblock from recvmsg
+	const ssize_t recv_len = recvmsg(_socket_fd, &msg, 0);
 
 	if (recv_len == 0) {
 		// This can happen when shutdown is called on the socket, therefore we check _should_exit again.
-		return;
+		return false;
 	}
 
 	if (recv_len < 0) {
 		// This happens on destruction when close(_socket_fd) is called, therefore be quiet.
-		return;
+		// On the event loop's non-blocking socket it means there is nothing left to read.
+		return false;
+	}
+
+	_receive_syscalls++;
+
+	handle_datagram(_receive_buffer, recv_len, src_addr, datagram_received_ns(&msg, read_time()));
+	return true;
+}
+
+bool UdpConnection::receive_batch()
+{
+	for (size_t i = 0; i < _receive_batch_size; i++) {
+		_batch_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+		_batch_msgs[i].msg_hdr.msg_controllen = _timestamps ? UDP_CONTROL_BUFFER_SIZE : 0;
+		_batch_msgs[i].msg_len = 0;
+	}
+
+	// MSG_WAITFORONE blocks until the first datagram arrives and then takes whatever else is already queued on the socket
+	const int count = recvmmsg(_socket_fd, _batch_msgs.data(), _receive_batch_size, MSG_WAITFORONE, nullptr);
+
+	if (count <= 0) {
+		// Same as in receive(), shutdown/close during destruction ends up here.
+		return false;
+	}
+
+	_receive_syscalls++;
+
+	const ReadTime read = read_time();
+
+	for (int i = 0; i < count; i++) {
+		handle_datagram(static_cast<char*>(_batch_iovecs[i].iov_base), _batch_msgs[i].msg_len, _batch_addrs[i],
+				datagram_received_ns(&_batch_msgs[i].msg_hdr, read));
+	}
+
+	return true;
+}
+
+UdpConnection::ReadTime UdpConnection::read_time() const
+{
+	if (!_timestamps) {
+		return {};
+	}
+
+	struct timespec realtime;
+	clock_gettime(CLOCK_REALTIME, &realtime);
+
+	return { latency_clock_ns(), uint64_t(realtime.tv_sec) * 1000000000 + uint64_t(realtime.tv_nsec) };
+}
+
+uint64_t UdpConnection::datagram_received_ns(msghdr* msg, const ReadTime& read)
+{
+	if (!read.steady_ns) {
+		return 0;
+	}
+
+	for (cmsghdr* cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+			struct timespec stamp;
+			memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+			const uint64_t kernel_ns = uint64_t(stamp.tv_sec) * 1000000000 + uint64_t(stamp.tv_nsec);
+
+			// The datagram arrived before the read, unless the wall clock was stepped in between
+			const uint64_t age_ns = read.realtime_ns > kernel_ns ? read.realtime_ns - kernel_ns : 0;
+			return read.steady_ns - std::min(age_ns, read.steady_ns - 1);
+		}
 	}
 
+	return read.steady_ns;
+}
+
+void UdpConnection::handle_datagram(const char* datagram, ssize_t length, const sockaddr_in& src_addr, uint64_t timestamp_ns)
+{
 	mavlink_message_t message;
-	auto parser = MessageParser(_receive_buffer, recv_len);
+	_parser.set_input(datagram, length);
+
+	while (_parser.parse(&message)) {
+		record_received();
+		count_received(message);
 
-	while (parser.parse(&message)) {
 		if (should_handle_message(message)) {
 
 			if (message.msgid == MAVLINK_MSG_ID_HEARTBEAT) {
 				handle_heartbeat(message, src_addr);
 			}
 
-			_parent->handle_message(message);
+			_parent->handle_message(message, timestamp_ns);
 		}
 	}
+
+	count_input(length);
 }
 
 void UdpConnection::handle_heartbeat(const mavlink_message_t& message, const sockaddr_in& socket_addr)
 {
 	if (connection_timed_out() && !_connected) {
-		_remote_ip = inet_ntoa(socket_addr.sin_addr);
-		_remote_port = ntohs(socket_addr.sin_port);
-		_connected = true;
+		// A udpout:// remote keeps the configured address
+		if (!_remote_known) {
+			_remote_addr = socket_addr;
+			_remote_ip = inet_ntoa(socket_addr.sin_addr);
+			_remote_port = ntohs(socket_addr.sin_port);
+		}
+
+		// After the address, the sending thread acquires it through this flag
+		_connected.store(true, std::memory_order_release);
 		LOG(GREEN_TEXT "Connected to %s:%d -- sysid %u compid %u" NORMAL_TEXT, _remote_ip.c_str(), _remote_port, message.sysid, message.compid);
+
+		// Flush what was queued while disconnected and start watching the outbox
+		if (_event_loop) {
+			drain_outbox();
+
+		} else if (_uring) {
+			uring_flush();
+
+		} else {
+			_connected_notifier.notify();
+		}
 	}
 
 	_last_received_heartbeat_ms = millis();
@@ -9,17 +9,29 @@
 
 #include <time.h>
 #include <arpa/inet.h>
+#include <sys/socket.h>
 
 #include "Connection.hpp"
+#include <EventNotifier.hpp>
 #include <helpers.hpp>
 
 namespace mavlink
 {
 
 static constexpr uint64_t UDP_CONNECTION_TIMEOUT_MS = 2000;
+static constexpr size_t UDP_RECEIVE_BUFFER_SIZE = 2048; // Enough for MTU 1500 bytes.
+static constexpr size_t UDP_MAX_RECEIVE_BATCH_SIZE = 1024;
+static constexpr size_t UDP_MAX_SEND_BATCH_SIZE = 1024;
+static constexpr size_t UDP_MAX_READS_PER_EVENT = 16; // Bounded so one busy link cannot starve the others on an event loop thread
+static constexpr size_t UDP_URING_BUFFER_COUNT = 256; // Provided receive buffers, datagrams arriving while all are in use wait in the socket
+static constexpr size_t UDP_URING_SEND_BATCH_SIZE = 64; // Used if udp_send_batch_size is smaller
+static constexpr int UDP_CONNECT_WAIT_TIMEOUT_MS = 100; // Sending thread, between checks while the port is not set up
+static constexpr size_t UDP_CONTROL_BUFFER_SIZE = CMSG_SPACE(sizeof(struct timespec)); // The SCM_TIMESTAMPNS of a datagram
 
 class Mavlink;
 
+// udp://ip:port binds to the address and sends to whoever sent the first heartbeat.
+// udpout://ip:port sends to the address from an ephemeral port right away, so two instances can talk to each other.
 class UdpConnection : public Connection
 {
 public:
@@ -27,7 +39,15 @@ public:
 
 	ConnectionResult start() override;
 	void stop() override;
-	bool send_message(const mavlink_message_t& message) override;
+	bool send_frame(const uint8_t* data, uint16_t length) override;
+	bool flush_outbox() override;
+
+	// EventLoop::Client
+	void handle_events(int fd, uint32_t events) override;
+	void tick() override;
+
+	// Number of recvfrom/recvmmsg calls that returned data
+	uint64_t receive_syscalls() const { return _receive_syscalls; };
 
 	// Non-copyable
 	UdpConnection(const UdpConnection&) = delete;
@@ -39,24 +59,70 @@ private:
 	void receive_thread_main();
 	void send_thread_main();
 
-	void receive();
+	// Both return false if nothing was received
+	bool receive();
+	bool receive_batch();
+	void handle_datagram(const char* datagram, ssize_t length, const sockaddr_in& src_addr, uint64_t timestamp_ns);
+
+	// Taken once per read. The kernel stamps datagrams with CLOCK_REALTIME, the offset to the steady clock moves them over.
+	struct ReadTime {
+		uint64_t steady_ns;
+		uint64_t realtime_ns;
+	};
+
+	// Zero unless receive times are taken
+	ReadTime read_time() const;
+
+	// Kernel receive time of a datagram on the steady clock, the time of the read if 'msg' has none
+	static uint64_t datagram_received_ns(msghdr* msg, const ReadTime& read);
 
 	void handle_heartbeat(const mavlink_message_t& message, const sockaddr_in& socket_addr);
 
+	// io_uring mode -- one thread keeps a multishot receive posted and submits the outbox in batches
+	enum UringOperation : uint64_t { UringReceive, UringOutbox, UringSend, UringScheduler };
+	bool setup_uring();
+	void uring_thread_main();
+	void uring_flush();
+	void handle_completion(const io_uring_cqe& cqe);
+
 	// Our IP and port
 	std::string _our_ip {};
 	int _our_port {};
 
-	// Autopilot IP and port
+	// Autopilot IP and port, resolved once in handle_heartbeat() unless given as udpout://. Written before _connected is set.
 	std::string _remote_ip {};
 	int _remote_port {};
+	struct sockaddr_in _remote_addr {};
+	bool _url_valid {true}; // start() fails for a udpout:// address that does not parse
 
 	// Connection
 	int _socket_fd {-1};
 	std::unique_ptr<std::thread> _recv_thread {};
 	std::unique_ptr<std::thread> _send_thread {};
 	std::atomic_bool _should_exit {false};
-	char _receive_buffer[2048] {}; // Enough for MTU 1500 bytes.
+	EventNotifier _connected_notifier {}; // Wakes the sending thread on connect and in stop()
+	char _receive_buffer[UDP_RECEIVE_BUFFER_SIZE] {};
+	alignas(cmsghdr) char _receive_control[UDP_CONTROL_BUFFER_SIZE] {};
+
+	// Batched receive -- one buffer, iovec and source address per datagram, preallocated in setup_port()
+	size_t _receive_batch_size {};
+	std::vector<char> _batch_buffers {};
+	std::vector<struct iovec> _batch_iovecs {};
+	std::vector<struct sockaddr_in> _batch_addrs {};
+	std::vector<char> _batch_controls {}; // Only with receive timestamps
+	std::vector<struct mmsghdr> _batch_msgs {};
+
+	std::atomic<uint64_t> _receive_syscalls {};
+
+	// Batched send -- queued frames are flushed straight from the outbox with one sendmmsg() call
+	size_t _send_batch_size {};
+	std::vector<Outbox::Frame> _send_frames {};
+	std::vector<struct iovec> _send_iovecs {};
+	std::vector<struct mmsghdr> _send_msgs {};
+
+	bool _io_uring {};
+	struct msghdr _uring_receive_msg {};
+	size_t _uring_sends {}; // Sends of the current batch still in flight, the batch is released once all completed
 
 	// Mavlink internal data
 	char* _datagram {};